@@ -0,0 +1,156 @@
+// Offline mesh compiler: runs the renderer's whole mesh pipeline (weld, cache/overdraw
+// optimization, LODs, meshlets, quantization) ahead of time and writes the mesh cache next
+// to each source, so the renderer starts by mapping the finished asset.
+//
+//   MeshCompiler [--float-vertices] [--lod-ratios a,b,c] [--low-memory] [--compress] [--hierarchy] [--force] [-j N] <file|dir>...
+//
+// Directories are searched recursively for .obj and .ply files. Sources whose cache is up
+// to date are skipped unless --force is given. Several files are compiled in parallel, one
+// per core; a single file gets all cores for parsing instead. --compress writes the cache
+// through MeshCodec, the form to ship when disk size and read time matter. --hierarchy
+// writes the cluster hierarchy the renderer streams with --out-of-core instead of the cache.
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <filesystem>
+#include <cstring>
+#include <cstdlib>
+#include "MeshPipeline.h"
+
+static void PrintUsage()
+{
+    std::cout << "usage: MeshCompiler [--float-vertices] [--lod-ratios a,b,c] [--low-memory] [--compress] [--hierarchy] [--force] [-j N] <file|dir>..." << std::endl;
+}
+
+// Expands directories into the sources they contain, in a stable order.
+static void CollectSources(const char* path, std::vector<std::string>& sources)
+{
+    std::error_code error;
+    if (!std::filesystem::is_directory(path, error)) {
+        sources.push_back(path);
+        return;
+    }
+    std::vector<std::string> found;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(path, error)) {
+        if (entry.is_regular_file(error) && MeshPipeline::IsSource(entry.path().string().c_str())) {
+            found.push_back(entry.path().string());
+        }
+    }
+    std::sort(found.begin(), found.end());
+    sources.insert(sources.end(), found.begin(), found.end());
+}
+
+// True if the cache exists and matches the source, the settings and the encoding.
+static bool UpToDate(const std::string& source, const MeshPipeline::Options& options)
+{
+    MeshAsset::SourceStamp stamp;
+    if (!MeshAsset::StampSource(source.c_str(), stamp)) {
+        return false;
+    }
+    stamp.settings = MeshPipeline::SettingsHash(options);
+    MappedFile cache;
+    if (options.hierarchy) {
+        const ClusterHierarchy::Header* header = ClusterHierarchy::Open(ClusterHierarchy::Path(source.c_str()).c_str(), cache);
+        return header != nullptr && memcmp(&header->source, &stamp, sizeof(stamp)) == 0;
+    }
+    const MeshAsset::Header* header = MeshAsset::Open(MeshAsset::CachePath(source.c_str(), options.format).c_str(), stamp, options.format, cache);
+    return header != nullptr && MeshAsset::IsCompressed(header) == options.compress;
+}
+
+int main(int argc, char* argv[])
+{
+    MeshPipeline::Options options;
+    unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+    bool force = false;
+    std::vector<std::string> sources;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--float-vertices") == 0) {
+            options.format = VertexFormat::Float;
+        }
+        else if (strcmp(argv[i], "--lod-ratios") == 0 && i + 1 < argc) {
+            options.lodRatios.clear();
+            for (char* token = strtok(argv[++i], ","); token != NULL; token = strtok(NULL, ",")) {
+                options.lodRatios.push_back(static_cast<float>(atof(token)));
+            }
+        }
+        else if (strcmp(argv[i], "--low-memory") == 0) {
+            options.twoPass = true;
+        }
+        else if (strcmp(argv[i], "--compress") == 0) {
+            options.compress = true;
+        }
+        else if (strcmp(argv[i], "--hierarchy") == 0) {
+            options.hierarchy = true;
+        }
+        else if (strcmp(argv[i], "--force") == 0) {
+            force = true;
+        }
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            jobs = std::max(1, atoi(argv[++i]));
+        }
+        else if (argv[i][0] == '-') {
+            PrintUsage();
+            return -1;
+        }
+        else {
+            CollectSources(argv[i], sources);
+        }
+    }
+    if (sources.empty()) {
+        PrintUsage();
+        return -1;
+    }
+
+    jobs = std::min<unsigned>(jobs, static_cast<unsigned>(sources.size()));
+    if (jobs > 1) {
+        // files run side by side: one thread each, and only the summary lines are printed
+        options.threads = 1;
+        options.report = false;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> compiled(0), skipped(0), failed(0);
+    std::mutex printMutex;
+    auto worker = [&]() {
+        for (size_t i = next++; i < sources.size(); i = next++) {
+            const std::string& source = sources[i];
+            auto fileStart = std::chrono::steady_clock::now();
+            const char* status;
+            if (!force && UpToDate(source, options)) {
+                status = "up to date";
+                skipped++;
+            } else if (options.hierarchy ? MeshPipeline::CompileHierarchy(source.c_str(), options)
+                                         : MeshPipeline::Compile(source.c_str(), options)) {
+                status = "compiled";
+                compiled++;
+            } else {
+                status = "FAILED";
+                failed++;
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - fileStart).count();
+            std::lock_guard<std::mutex> lock(printMutex);
+            std::cout << "[" << i + 1 << "/" << sources.size() << "] " << source << ": " << status
+                      << " (" << seconds << " s)" << std::endl;
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned j = 1; j < jobs; j++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& t : workers) {
+        t.join();
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << compiled << " compiled, " << skipped << " up to date, " << failed << " failed in "
+              << seconds << " s with " << jobs << " job" << (jobs == 1 ? "" : "s") << std::endl;
+    return failed == 0 ? 0 : -1;
+}
@@ -0,0 +1,200 @@
+#pragma once
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include "ObjParser.h"
+#include "MeshPipeline.h"
+#include "MeshCodec.h"
+
+// Headless benchmarks run from the command line (see main). They print one line per
+// measurement so results can be diffed between builds to catch regressions.
+namespace Benchmark
+{
+inline double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// High-water mark of the process's resident set, in bytes.
+inline size_t PeakResidentBytes()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss);
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+}
+
+// Writes a wavy grid mesh with v/vn/f records until the file is roughly the requested size.
+inline bool GenerateOBJ(const char* path, size_t megabytes)
+{
+    const size_t bytesPerVertex = 150; // v + vn + two "f a//a b//b c//c" lines
+    size_t side = static_cast<size_t>(std::sqrt(static_cast<double>(megabytes << 20) / bytesPerVertex)) + 2;
+    FILE* out = fopen(path, "wb");
+    if (out == NULL) {
+        std::cout << "Failed to create " << path << std::endl;
+        return false;
+    }
+    std::vector<char> buffer(1 << 20);
+    setvbuf(out, buffer.data(), _IOFBF, buffer.size());
+    for (size_t z = 0; z < side; z++) {
+        for (size_t x = 0; x < side; x++) {
+            float fx = static_cast<float>(x) / side * 10.0f, fz = static_cast<float>(z) / side * 10.0f;
+            float y = 0.25f * std::sin(fx * 3.0f) * std::cos(fz * 2.0f);
+            fprintf(out, "v %.6f %.6f %.6f\n", fx - 5.0f, y, fz - 5.0f);
+        }
+    }
+    for (size_t z = 0; z < side; z++) {
+        for (size_t x = 0; x < side; x++) {
+            float fx = static_cast<float>(x) / side * 10.0f, fz = static_cast<float>(z) / side * 10.0f;
+            glm::vec3 n = glm::normalize(glm::vec3(-0.75f * std::cos(fx * 3.0f) * std::cos(fz * 2.0f), 1.0f,
+                                                   0.5f * std::sin(fx * 3.0f) * std::sin(fz * 2.0f)));
+            fprintf(out, "vn %.6f %.6f %.6f\n", n.x, n.y, n.z);
+        }
+    }
+    for (size_t z = 0; z + 1 < side; z++) {
+        for (size_t x = 0; x + 1 < side; x++) {
+            size_t a = z * side + x + 1, b = a + 1, c = a + side, d = c + 1;
+            fprintf(out, "f %zu//%zu %zu//%zu %zu//%zu\n", a, a, c, c, b, b);
+            fprintf(out, "f %zu//%zu %zu//%zu %zu//%zu\n", b, b, c, c, d, d);
+        }
+    }
+    return fclose(out) == 0;
+}
+
+inline bool TimeObjParse(const char* path, unsigned threads, double megabytes)
+{
+    ObjParser::Result result;
+    auto start = std::chrono::steady_clock::now();
+    if (!ObjParser::Parse(path, result, threads)) {
+        return false;
+    }
+    double seconds = SecondsSince(start);
+    double triangles = static_cast<double>(result.positionIndices.size() / 3);
+    printf("obj-parse threads=%u size=%.1fMB time=%.3fs throughput=%.1fMB/s triangles=%.0f rate=%.2fMtri/s\n",
+           threads, megabytes, seconds, megabytes / seconds, triangles, triangles / seconds / 1e6);
+    return true;
+}
+
+// Parser throughput on a generated OBJ. The file is kept between runs and only
+// regenerated when its size is more than 10% off the requested one.
+inline bool ObjParse(const char* path, size_t megabytes)
+{
+    struct stat st;
+    double target = static_cast<double>(megabytes << 20);
+    if (stat(path, &st) != 0 || std::fabs(st.st_size - target) > target * 0.1) {
+        std::cout << "Generating " << megabytes << " MB OBJ at " << path << std::endl;
+        if (!GenerateOBJ(path, megabytes) || stat(path, &st) != 0) {
+            return false;
+        }
+    }
+    double sizeMB = static_cast<double>(st.st_size) / (1 << 20);
+    unsigned threads = ObjParser::DefaultThreadCount(static_cast<size_t>(st.st_size));
+    if (!TimeObjParse(path, threads, sizeMB)) {
+        return false;
+    }
+    return threads == 1 || TimeObjParse(path, 1, sizeMB);
+}
+
+// Calls decode repeatedly for at least minSeconds and returns the mean time per call.
+template <typename Decode>
+inline double TimeDecode(Decode decode, double minSeconds = 0.5)
+{
+    auto start = std::chrono::steady_clock::now();
+    size_t runs = 0;
+    double seconds = 0.0;
+    do {
+        if (!decode()) {
+            return -1.0;
+        }
+        runs++;
+        seconds = SecondsSince(start);
+    } while (seconds < minSeconds);
+    return seconds / runs;
+}
+
+// Triangles may come back rotated, so compare them up to rotation.
+inline bool SameTriangles(const uint32_t* expected, const std::vector<uint32_t>& decoded)
+{
+    for (size_t t = 0; t < decoded.size(); t += 3) {
+        bool same = false;
+        for (size_t r = 0; r < 3 && !same; r++) {
+            same = decoded[t] == expected[t + r] && decoded[t + 1] == expected[t + (r + 1) % 3] && decoded[t + 2] == expected[t + (r + 2) % 3];
+        }
+        if (!same) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// MeshCodec compression ratio and decode throughput on a mesh run through the full
+// pipeline (the stream order the cache actually stores). Throughput is decoded bytes per
+// second. Without an existing source a 16 MB grid OBJ is generated at path.
+inline bool Codec(const char* path)
+{
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        std::cout << "Generating 16 MB OBJ at " << path << std::endl;
+        if (!GenerateOBJ(path, 16)) {
+            return false;
+        }
+    }
+    MeshPipeline::Options options;
+    options.report = false;
+    Mesh mesh;
+    if (!MeshPipeline::Load(path, mesh, options)) {
+        return false;
+    }
+    MeshPipeline::Process(mesh, options);
+    printf("codec mesh=%s vertices=%u triangles=%u\n", path, mesh.VertexCount(), mesh.IndexCount() / 3);
+
+    for (VertexFormat format : { VertexFormat::Compact, VertexFormat::Float }) {
+        VertexStream stream;
+        EncodeVertices(mesh, format, stream);
+        std::vector<unsigned char> encoded, decoded(stream.bytes.size());
+        auto start = std::chrono::steady_clock::now();
+        ::MeshCodec::EncodeVertices(stream.bytes.data(), stream.count, stream.stride, encoded);
+        double encodeSeconds = SecondsSince(start);
+        double seconds = TimeDecode([&]() {
+            return ::MeshCodec::DecodeVertices(encoded.data(), encoded.size(), stream.count, stream.stride, decoded.data());
+        });
+        if (seconds < 0.0 || decoded != stream.bytes) {
+            std::cout << "codec vertices " << VertexFormatName(format) << ": round trip failed" << std::endl;
+            return false;
+        }
+        printf("codec-vertices format=%s raw=%zuKB encoded=%zuKB ratio=%.2f bytes/vertex=%.2f encode=%.1fms decode=%.2fms throughput=%.2fGB/s\n",
+               VertexFormatName(format), stream.bytes.size() / 1024, encoded.size() / 1024,
+               static_cast<double>(stream.bytes.size()) / encoded.size(), static_cast<double>(encoded.size()) / stream.count,
+               encodeSeconds * 1000.0, seconds * 1000.0, stream.bytes.size() / seconds / 1e9);
+    }
+
+    size_t rawIndexBytes = mesh.indices.size() * mesh.IndexSize();
+    std::vector<unsigned char> encoded;
+    auto start = std::chrono::steady_clock::now();
+    ::MeshCodec::EncodeIndices(mesh.indices.data(), mesh.indices.size(), encoded);
+    double encodeSeconds = SecondsSince(start);
+    std::vector<uint32_t> decoded(mesh.indices.size());
+    std::vector<unsigned char> packed(rawIndexBytes);
+    double seconds = TimeDecode([&]() {
+        return ::MeshCodec::DecodeIndices(encoded.data(), encoded.size(), decoded.size(), mesh.VertexCount(), mesh.IndexSize(), packed.data());
+    });
+    bool ok = seconds >= 0.0 && ::MeshCodec::DecodeIndices(encoded.data(), encoded.size(), decoded.size(), mesh.VertexCount(), decoded.data()) &&
+              SameTriangles(mesh.indices.data(), decoded);
+    if (!ok) {
+        std::cout << "codec indices: round trip failed" << std::endl;
+        return false;
+    }
+    printf("codec-indices size=%u raw=%zuKB encoded=%zuKB ratio=%.2f bits/triangle=%.2f encode=%.1fms decode=%.2fms throughput=%.2fGB/s\n",
+           mesh.IndexSize(), rawIndexBytes / 1024, encoded.size() / 1024, static_cast<double>(rawIndexBytes) / encoded.size(),
+           encoded.size() * 8.0 / (mesh.indices.size() / 3), encodeSeconds * 1000.0, seconds * 1000.0, rawIndexBytes / seconds / 1e9);
+    return true;
+}
+}
@@ -0,0 +1,384 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cfloat>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <iostream>
+#include "glm/glm.hpp"
+#include "Mesh.h"
+#include "VertexFormat.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshAsset.h"
+
+// Out-of-core cluster hierarchy ("scan.obj.hlod") for models too large to load whole.
+// The triangles are split spatially (median kd splits) into leaf clusters of at most
+// LEAF_TRIANGLES; every inner node holds its children's geometry simplified back down to
+// about that size, so each level of the tree is a complete, coarser version of the model.
+// Simplify() never moves border vertices, and a node's border is the border of its whole
+// subtree, so any cut through the tree meets its neighbours at identical vertices.
+// Node errors include their children's, and node spheres contain their children's, so the
+// projected error never grows towards the leaves and a cut chosen by screen-space error is
+// consistent (see ClusterStreamer).
+//
+// Each node is stored as GPU-ready compact vertices with their own quantization grid plus
+// 16- or 32-bit indices, so the runtime streams a node by copying one range of the file.
+namespace ClusterHierarchy
+{
+const uint32_t MAGIC = 0x444F4C48; // "HLOD"
+const uint32_t VERSION = 1;
+const uint32_t LEAF_TRIANGLES = 8192;
+const uint32_t NO_NODE = 0xFFFFFFFF;
+
+struct Header
+{
+    uint32_t magic;
+    uint32_t version;
+    MeshAsset::SourceStamp source;
+    uint32_t nodeCount;    // node 0 is the root
+    uint32_t leafCount;
+    uint32_t depth;
+    uint32_t vertexStride; // sizeof(CompactVertex)
+    uint64_t leafTriangles; // the full-resolution triangle count
+    uint64_t nodeOffset;   // Node[nodeCount]
+    float boundsCenter[3];
+    float boundsRadius;
+    float boundsMin[3];
+    float boundsMax[3];
+};
+
+struct Node
+{
+    float center[3];
+    float radius;   // contains the children's spheres
+    float error;    // object-space geometric error, including the children's
+    uint32_t parent;
+    uint32_t firstChild; // children are contiguous; childCount 0 for leaves
+    uint32_t childCount;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t indexSize;  // 2 or 4
+    uint32_t reserved;
+    float quantizationOffset[3];
+    float quantizationScale[3];
+    uint64_t dataOffset; // vertices, then indices at a 4-byte boundary
+    uint64_t dataBytes;
+};
+
+// Node geometry during the build: indices into the source mesh's vertices.
+struct BuildNode
+{
+    std::vector<uint32_t> indices;
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+    float error = 0.0f;
+    uint32_t parent = NO_NODE;
+    uint32_t firstChild = 0;
+    uint32_t childCount = 0;
+    uint32_t depth = 0;
+};
+
+inline std::string Path(const char* sourcePath)
+{
+    return std::string(sourcePath) + ".hlod";
+}
+
+// Copies the vertices referenced by indices into a standalone mesh; unique receives the
+// source vertex of every local one, and local the remapped indices.
+inline void ExtractLocal(const Mesh& mesh, const std::vector<uint32_t>& indices, Mesh& out, std::vector<uint32_t>& unique,
+                         std::vector<uint32_t>& local)
+{
+    unique.assign(indices.begin(), indices.end());
+    std::sort(unique.begin(), unique.end());
+    unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+    local.resize(indices.size());
+    for (size_t i = 0; i < indices.size(); i++) {
+        local[i] = static_cast<uint32_t>(std::lower_bound(unique.begin(), unique.end(), indices[i]) - unique.begin());
+    }
+    out.floatsPerVertex = mesh.floatsPerVertex;
+    out.vertices.resize(unique.size() * mesh.floatsPerVertex);
+    for (size_t v = 0; v < unique.size(); v++) {
+        memcpy(&out.vertices[v * mesh.floatsPerVertex], &mesh.vertices[static_cast<size_t>(unique[v]) * mesh.floatsPerVertex],
+               mesh.floatsPerVertex * sizeof(float));
+    }
+    out.indices.clear();
+}
+
+// Splits the triangles into leaves top-down. Children are appended next to each other, so
+// every node's children are contiguous and come after it.
+inline void Partition(const Mesh& mesh, std::vector<BuildNode>& nodes)
+{
+    uint32_t triangleCount = mesh.IndexCount() / 3;
+    std::vector<uint32_t> triangles(triangleCount);
+    std::vector<glm::vec3> centroids(triangleCount);
+    for (uint32_t t = 0; t < triangleCount; t++) {
+        triangles[t] = t;
+        centroids[t] = (MeshOptimizer::Position(mesh, mesh.indices[t * 3]) + MeshOptimizer::Position(mesh, mesh.indices[t * 3 + 1]) +
+                        MeshOptimizer::Position(mesh, mesh.indices[t * 3 + 2])) / 3.0f;
+    }
+    struct Range
+    {
+        uint32_t node, first, count;
+    };
+    nodes.assign(1, BuildNode());
+    std::vector<Range> stack = { { 0, 0, triangleCount } };
+    while (!stack.empty()) {
+        Range range = stack.back();
+        stack.pop_back();
+        if (range.count <= LEAF_TRIANGLES) {
+            std::vector<uint32_t>& indices = nodes[range.node].indices;
+            indices.reserve(static_cast<size_t>(range.count) * 3);
+            for (uint32_t i = range.first; i < range.first + range.count; i++) {
+                indices.insert(indices.end(), &mesh.indices[triangles[i] * 3], &mesh.indices[triangles[i] * 3] + 3);
+            }
+            continue;
+        }
+        glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+        for (uint32_t i = range.first; i < range.first + range.count; i++) {
+            lo = glm::min(lo, centroids[triangles[i]]);
+            hi = glm::max(hi, centroids[triangles[i]]);
+        }
+        glm::vec3 extent = hi - lo;
+        int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+        uint32_t half = range.count / 2;
+        std::nth_element(triangles.begin() + range.first, triangles.begin() + range.first + half, triangles.begin() + range.first + range.count,
+                         [&](uint32_t a, uint32_t b){ return centroids[a][axis] < centroids[b][axis]; });
+        uint32_t child = static_cast<uint32_t>(nodes.size());
+        nodes.resize(nodes.size() + 2);
+        nodes[range.node].firstChild = child;
+        nodes[range.node].childCount = 2;
+        for (uint32_t i = 0; i < 2; i++) {
+            nodes[child + i].parent = range.node;
+            nodes[child + i].depth = nodes[range.node].depth + 1;
+        }
+        stack.push_back({ child, range.first, half });
+        stack.push_back({ child + 1, range.first + half, range.count - half });
+    }
+}
+
+// Builds the whole hierarchy: partition, then each inner node simplifies the union of its
+// children, deepest level first, with the nodes of one level spread over threads.
+inline void Build(const Mesh& mesh, std::vector<BuildNode>& nodes, unsigned threads, bool report)
+{
+    Partition(mesh, nodes);
+    uint32_t depth = 0;
+    for (const BuildNode& node : nodes) {
+        depth = std::max(depth, node.depth);
+    }
+    threads = threads != 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+    for (uint32_t level = depth + 1; level-- > 0;) {
+        std::vector<uint32_t> work;
+        for (uint32_t n = 0; n < nodes.size(); n++) {
+            if (nodes[n].depth == level) {
+                work.push_back(n);
+            }
+        }
+        std::atomic<size_t> next(0);
+        auto worker = [&]() {
+            Mesh local;
+            std::vector<uint32_t> unique, localIndices, simplified, merged;
+            for (size_t w = next++; w < work.size(); w = next++) {
+                BuildNode& node = nodes[work[w]];
+                float childError = 0.0f;
+                if (node.childCount != 0) {
+                    merged.clear();
+                    for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++) {
+                        merged.insert(merged.end(), nodes[c].indices.begin(), nodes[c].indices.end());
+                        childError = std::max(childError, nodes[c].error);
+                    }
+                    ExtractLocal(mesh, merged, local, unique, localIndices);
+                    float error = MeshSimplifier::Simplify(local, localIndices.data(), localIndices.size(),
+                                                           static_cast<size_t>(LEAF_TRIANGLES) * 3, simplified);
+                    node.error = error + childError;
+                    node.indices.resize(simplified.size());
+                    for (size_t i = 0; i < simplified.size(); i++) {
+                        node.indices[i] = unique[simplified[i]];
+                    }
+                }
+                ExtractLocal(mesh, node.indices, local, unique, localIndices);
+                local.ComputeBounds(node.center, node.radius);
+                for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++) {
+                    node.radius = std::max(node.radius, glm::length(nodes[c].center - node.center) + nodes[c].radius);
+                }
+            }
+        };
+        std::vector<std::thread> workers;
+        for (unsigned t = 1; t < std::min<size_t>(threads, work.size()); t++) {
+            workers.emplace_back(worker);
+        }
+        worker();
+        for (std::thread& t : workers) {
+            t.join();
+        }
+        if (report) {
+            size_t triangles = 0;
+            float error = 0.0f;
+            for (uint32_t n : work) {
+                triangles += nodes[n].indices.size() / 3;
+                error = std::max(error, nodes[n].error);
+            }
+            std::cout << "  level " << level << ": " << work.size() << " nodes, " << triangles << " triangles, error " << error << std::endl;
+        }
+    }
+}
+
+// Writes header, node table and per-node data through a temporary file, like MeshAsset.
+inline bool Write(const char* path, const MeshAsset::SourceStamp& stamp, const Mesh& mesh, const std::vector<BuildNode>& nodes)
+{
+    Header header = {};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.source = stamp;
+    header.nodeCount = static_cast<uint32_t>(nodes.size());
+    header.vertexStride = sizeof(CompactVertex);
+    header.leafTriangles = mesh.IndexCount() / 3;
+    header.nodeOffset = MeshAsset::Align(sizeof(Header));
+    glm::vec3 center;
+    mesh.ComputeBounds(center, header.boundsRadius);
+    glm::vec3 lo = MeshOptimizer::Position(mesh, 0), hi = lo;
+    for (uint32_t v = 1; v < mesh.VertexCount(); v++) {
+        lo = glm::min(lo, MeshOptimizer::Position(mesh, v));
+        hi = glm::max(hi, MeshOptimizer::Position(mesh, v));
+    }
+    for (int i = 0; i < 3; i++) {
+        header.boundsCenter[i] = center[i];
+        header.boundsMin[i] = lo[i];
+        header.boundsMax[i] = hi[i];
+    }
+    std::vector<Node> table(nodes.size());
+    for (size_t n = 0; n < nodes.size(); n++) {
+        const BuildNode& node = nodes[n];
+        header.leafCount += node.childCount == 0 ? 1 : 0;
+        header.depth = std::max(header.depth, node.depth + 1);
+        Node& out = table[n];
+        out = {};
+        for (int i = 0; i < 3; i++) {
+            out.center[i] = node.center[i];
+        }
+        out.radius = node.radius;
+        out.error = node.error;
+        out.parent = node.parent;
+        out.firstChild = node.firstChild;
+        out.childCount = node.childCount;
+        out.indexCount = static_cast<uint32_t>(node.indices.size());
+    }
+
+    std::string tempPath = std::string(path) + ".tmp";
+    FILE* file = fopen(tempPath.c_str(), "wb");
+    if (file == NULL) {
+        std::cout << "Failed to write cluster hierarchy: " << path << std::endl;
+        return false;
+    }
+    static const unsigned char padding[MeshAsset::DATA_ALIGNMENT] = {};
+    // node data first, after room for the header and table; sizes and offsets are known
+    // once each node is encoded, so the table is written last
+    uint64_t position = MeshAsset::Align(header.nodeOffset + nodes.size() * sizeof(Node));
+    bool ok = fseek(file, static_cast<long>(position), SEEK_SET) == 0;
+    Mesh local;
+    std::vector<uint32_t> unique, indices;
+    std::vector<unsigned char> bytes;
+    for (size_t n = 0; ok && n < nodes.size(); n++) {
+        ExtractLocal(mesh, nodes[n].indices, local, unique, indices);
+        MeshOptimizer::OptimizeVertexCache(indices, local.VertexCount());
+        VertexStream vertices;
+        EncodeVertices(local, VertexFormat::Compact, vertices);
+        Node& out = table[n];
+        out.vertexCount = vertices.count;
+        out.indexSize = local.IndexSize();
+        for (int i = 0; i < 3; i++) {
+            out.quantizationOffset[i] = vertices.quantization.offset[i];
+            out.quantizationScale[i] = vertices.quantization.scale[i];
+        }
+        size_t indexBytes = indices.size() * out.indexSize;
+        bytes.resize(indexBytes);
+        PackIndices(indices.data(), indices.size(), out.indexSize, bytes.data());
+        out.dataOffset = position;
+        out.dataBytes = vertices.bytes.size() + indexBytes;
+        uint64_t pad = MeshAsset::Align(position + out.dataBytes) - position - out.dataBytes;
+        ok = fwrite(vertices.bytes.data(), 1, vertices.bytes.size(), file) == vertices.bytes.size() &&
+             fwrite(bytes.data(), 1, indexBytes, file) == indexBytes &&
+             fwrite(padding, 1, pad, file) == pad;
+        position += out.dataBytes + pad;
+    }
+    uint64_t tablePad = header.nodeOffset - sizeof(Header);
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 &&
+         fwrite(&header, sizeof(header), 1, file) == 1 &&
+         fwrite(padding, 1, tablePad, file) == tablePad &&
+         fwrite(table.data(), sizeof(Node), table.size(), file) == table.size();
+    ok = (fclose(file) == 0) && ok;
+    if (!ok || rename(tempPath.c_str(), path) != 0) {
+        std::cout << "Failed to write cluster hierarchy: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// True if every index of node refers to one of its own vertices; data is the node's data.
+inline bool IndicesInRange(const Node& node, const unsigned char* data)
+{
+    const unsigned char* indices = data + static_cast<size_t>(node.vertexCount) * sizeof(CompactVertex);
+    for (uint32_t i = 0; i < node.indexCount; i++) {
+        uint32_t index;
+        if (node.indexSize == 2) {
+            uint16_t shortIndex;
+            memcpy(&shortIndex, indices + i * 2, 2);
+            index = shortIndex;
+        } else {
+            memcpy(&index, indices + static_cast<size_t>(i) * 4, 4);
+        }
+        if (index >= node.vertexCount) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Validates the header, the node table (data ranges, parent and child links) and every
+// node's indices of a mapped hierarchy file, so neither the streamer's per-node state nor
+// base-vertex draws can reach past their node. The pages read for the indices are dropped
+// again, as the I/O threads do.
+inline const Header* Open(const char* path, MappedFile& file)
+{
+    if (!file.Open(path) || file.Size() < sizeof(Header)) {
+        return nullptr;
+    }
+    const Header* header = reinterpret_cast<const Header*>(file.Data());
+    bool valid = header->magic == MAGIC && header->version == VERSION && header->vertexStride == sizeof(CompactVertex) &&
+                 header->nodeCount != 0 && header->nodeOffset + static_cast<uint64_t>(header->nodeCount) * sizeof(Node) <= file.Size();
+    const Node* nodes = valid ? reinterpret_cast<const Node*>(file.Data() + header->nodeOffset) : nullptr;
+    for (uint32_t n = 0; valid && n < header->nodeCount; n++) {
+        const Node& node = nodes[n];
+        uint64_t indexOffset = static_cast<uint64_t>(node.vertexCount) * sizeof(CompactVertex);
+        valid = node.dataBytes <= file.Size() && node.dataOffset <= file.Size() - node.dataBytes &&
+                (node.indexSize == 2 || node.indexSize == 4) &&
+                indexOffset + static_cast<uint64_t>(node.indexCount) * node.indexSize <= node.dataBytes &&
+                (n == 0 ? node.parent == NO_NODE : node.parent < header->nodeCount) &&
+                (node.childCount == 0 || (node.firstChild > n && static_cast<uint64_t>(node.firstChild) + node.childCount <= header->nodeCount));
+        // the streamer walks both ways, so children must point back at their parent
+        for (uint32_t c = 0; valid && c < node.childCount; c++) {
+            valid = nodes[node.firstChild + c].parent == n;
+        }
+        if (valid) {
+            const unsigned char* data = file.Data() + node.dataOffset;
+            valid = IndicesInRange(node, data);
+            file.Release(data, node.dataBytes);
+        }
+    }
+    if (!valid) {
+        std::cout << path << " is not a valid cluster hierarchy" << std::endl;
+        file.Close();
+        return nullptr;
+    }
+    return header;
+}
+
+inline const Node* Nodes(const Header* header)
+{
+    return reinterpret_cast<const Node*>(reinterpret_cast<const unsigned char*>(header) + header->nodeOffset);
+}
+}
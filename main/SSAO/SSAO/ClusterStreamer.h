@@ -0,0 +1,460 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <iostream>
+#include "glm/glm.hpp"
+#include "Shader.h"
+#include "MappedFile.h"
+#include "ClusterHierarchy.h"
+#include "GeometryBuffer.h"
+#include "Meshlets.h"
+
+// Out-of-core renderer for a ClusterHierarchy file. Only the root is loaded up front; every
+// frame Select() walks the tree from the root and stops at the first node whose error
+// projects below the pixel threshold, or whose children are not all on the GPU yet, in which
+// case the node stands in for them and they are requested. I/O threads read requested nodes
+// out of the mapping (page faults happen there, not on the render thread) and Update()
+// uploads finished ones within a per-frame time budget.
+//
+// GPU memory is one GeometryBuffer of fixed size. When it is full, the least recently
+// selected nodes are evicted; a node is only evicted once all its children are gone and none
+// is being read, so every resident node's parent is resident and the cut can always fall
+// back to it.
+class ClusterStreamer{
+public:
+    static constexpr int IO_THREADS = 2;
+    static constexpr size_t MAX_REQUESTS = 64; // queued per frame, most important first
+    static constexpr uint64_t RETRY_FRAMES = 30; // before a node that did not fit is read again
+    static constexpr uint64_t FREE_LATENCY_FRAMES = 3; // frames the GPU may hold on to evicted ranges
+
+    struct Stats
+    {
+        uint32_t residentNodes = 0;
+        uint32_t drawnNodes = 0;
+        uint64_t drawnTriangles = 0;
+        uint32_t loaded = 0;    // since the last ResetStats()
+        uint32_t evicted = 0;
+        uint32_t discarded = 0; // loads that did not fit
+    };
+
+    ~ClusterStreamer(){
+        Close();
+    }
+    // Maps the file, creates the budget-sized geometry buffer and uploads the root.
+    bool Open(const char* path, size_t budgetBytes, GeometryBuffer::SetupAttributes setupAttributes){
+        header = ClusterHierarchy::Open(path, file);
+        if (header == nullptr){
+            std::cout << "Failed to open cluster hierarchy " << path << std::endl;
+            return false;
+        }
+        nodes = ClusterHierarchy::Nodes(header);
+        states.assign(header->nodeCount, State());
+        // split the budget in the proportion the file stores vertices and indices
+        uint64_t vertexBytes = 0, totalBytes = 0;
+        for (uint32_t n = 0; n < header->nodeCount; n++){
+            vertexBytes += static_cast<uint64_t>(nodes[n].vertexCount) * sizeof(CompactVertex);
+            totalBytes += nodes[n].dataBytes;
+        }
+        double vertexShare = totalBytes != 0 ? static_cast<double>(vertexBytes) / static_cast<double>(totalBytes) : 0.5;
+        // in 64 bits, then clamped to the 32-bit vertex counts and index bytes of GeometryBuffer
+        uint64_t vertexCapacity = static_cast<uint64_t>(static_cast<double>(budgetBytes) * vertexShare / sizeof(CompactVertex));
+        uint64_t indexBytes = static_cast<uint64_t>(static_cast<double>(budgetBytes) * (1.0 - vertexShare));
+        if (vertexCapacity > UINT32_MAX || indexBytes > UINT32_MAX){
+            vertexCapacity = std::min<uint64_t>(vertexCapacity, UINT32_MAX);
+            indexBytes = std::min<uint64_t>(indexBytes, UINT32_MAX);
+            std::cout << "GPU budget of " << budgetBytes / (1024 * 1024) << " MB clamped to "
+                      << (vertexCapacity * sizeof(CompactVertex) + indexBytes) / (1024 * 1024) << " MB" << std::endl;
+        }
+        geometry.Create(VertexFormat::Compact, setupAttributes, static_cast<uint32_t>(vertexCapacity), static_cast<uint32_t>(indexBytes));
+        if (!geometry.TryAllocate(nodes[0].vertexCount, IndexBytes(nodes[0]), states[0].allocation)){
+            std::cout << "GPU budget of " << budgetBytes / (1024 * 1024) << " MB is too small for the root of " << path << std::endl;
+            Close();
+            return false;
+        }
+        Upload(0, file.Data() + nodes[0].dataOffset);
+        states[0].status = Status::Resident;
+        LruPush(0);
+        stats.residentNodes = 1;
+        quit = false;
+        for (int t = 0; t < IO_THREADS; t++){
+            ioThreads.emplace_back(&ClusterStreamer::IoThread, this);
+        }
+        return true;
+    }
+    void Close(){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+        for (std::thread& thread : ioThreads){
+            thread.join();
+        }
+        ioThreads.clear();
+        queue.clear();
+        completed.clear();
+        header = nullptr;
+        nodes = nullptr;
+        file.Close();
+    }
+    bool IsOpen() const{
+        return header != nullptr;
+    }
+    glm::vec3 BoundsMin() const{
+        return glm::vec3(header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]);
+    }
+    glm::vec3 BoundsMax() const{
+        return glm::vec3(header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]);
+    }
+    uint64_t FullTriangles() const{
+        return header->leafTriangles;
+    }
+    // Chooses this frame's cut and queues the missing nodes it wants, most projected error
+    // first. model places the hierarchy in the world.
+    void Select(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection, int viewportHeight, float lodPixelError){
+        frame++;
+        selected.clear();
+        wanted.clear();
+        Meshlets::ExtractFrustum(projection * view * model, planes);
+        modelView = view * model;
+        scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        pixelsPerUnit = projection[1][1] * 0.5f * static_cast<float>(viewportHeight);
+        pixelError = lodPixelError;
+        Visit(0);
+
+        std::sort(wanted.begin(), wanted.end(), [](const Request& a, const Request& b){ return a.priority > b.priority; });
+        if (wanted.size() > MAX_REQUESTS){
+            wanted.resize(MAX_REQUESTS);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            // requests still waiting from last frame are dropped unless wanted again
+            for (const Request& request : queue){
+                states[request.node].status = Status::NotResident;
+                states[nodes[request.node].parent].requestedChildren--;
+            }
+            queue.clear();
+            for (const Request& request : wanted){
+                if (states[request.node].status == Status::NotResident && states[request.node].retryFrame <= frame){
+                    states[request.node].status = Status::Requested;
+                    states[nodes[request.node].parent].requestedChildren++;
+                    queue.push_back(request);
+                }
+            }
+            // the I/O threads take from the back
+            std::reverse(queue.begin(), queue.end());
+        }
+        wake.notify_all();
+    }
+    // Draws the cut with the bound shader, which must take the same uniforms as
+    // ssao_geometry.vs (model, positionOffset, positionScale).
+    void Draw(Shader& shader, const glm::mat4& model){
+        shader.SetMatrix4fv("model", model);
+        geometry.Bind();
+        stats.drawnNodes = static_cast<uint32_t>(selected.size());
+        stats.drawnTriangles = 0;
+        for (uint32_t n : selected){
+            const ClusterHierarchy::Node& node = nodes[n];
+            const GeometryBuffer::Allocation& allocation = states[n].allocation;
+            shader.SetVec3f("positionOffset", glm::vec3(node.quantizationOffset[0], node.quantizationOffset[1], node.quantizationOffset[2]));
+            shader.SetVec3f("positionScale", glm::vec3(node.quantizationScale[0], node.quantizationScale[1], node.quantizationScale[2]));
+            glDrawElementsBaseVertex(GL_TRIANGLES, node.indexCount, node.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+                                     (GLvoid*)geometry.IndexOffset(allocation), geometry.BaseVertex(allocation));
+            stats.drawnTriangles += node.indexCount / 3;
+        }
+        glBindVertexArray(0);
+    }
+    // Uploads loads the I/O threads have finished, for at most budgetSeconds, evicting
+    // unused nodes to make room. Call once per frame after the frame's draws.
+    void Update(double budgetSeconds){
+        auto start = std::chrono::steady_clock::now();
+        std::vector<Load> arrived;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            arrived.swap(completed);
+        }
+        std::vector<Load> later;
+        size_t i = 0;
+        for (; i < arrived.size(); i++){
+            if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > budgetSeconds){
+                break;
+            }
+            uint32_t n = arrived[i].node;
+            State& state = states[n];
+            uint32_t parent = nodes[n].parent;
+            Room room = MakeRoom(n);
+            if (room == Room::Later){
+                later.push_back(std::move(arrived[i]));
+                continue;
+            }
+            states[parent].requestedChildren--;
+            if (room == Room::Full){
+                // the budget is taken by nodes in use; reading it again every frame would
+                // only repeat the I/O
+                state.status = Status::NotResident;
+                state.retryFrame = frame + RETRY_FRAMES;
+                stats.discarded++;
+                continue;
+            }
+            Upload(n, arrived[i].data.data());
+            state.status = Status::Resident;
+            state.lastUsed = frame;
+            states[parent].residentChildren++;
+            LruPush(n);
+            stats.residentNodes++;
+            stats.loaded++;
+        }
+        if (i < arrived.size() || !later.empty()){
+            // over budget or waiting for evicted ranges: the rest is retried next frame
+            later.insert(later.end(), std::make_move_iterator(arrived.begin() + i), std::make_move_iterator(arrived.end()));
+            std::lock_guard<std::mutex> lock(mutex);
+            completed.insert(completed.end(), std::make_move_iterator(later.begin()), std::make_move_iterator(later.end()));
+        }
+        geometry.EndFrame();
+    }
+    const Stats& GetStats() const{
+        return stats;
+    }
+    void ResetStats(){
+        stats.loaded = stats.evicted = stats.discarded = 0;
+    }
+    size_t UsedBytes() const{
+        return geometry.UsedBytes();
+    }
+    size_t BudgetBytes() const{
+        return geometry.VertexCapacityBytes() + geometry.IndexCapacityBytes();
+    }
+private:
+    enum class Status : uint8_t
+    {
+        NotResident,
+        Requested, // queued or being read by an I/O thread
+        Resident
+    };
+    struct State
+    {
+        Status status = Status::NotResident;
+        uint32_t residentChildren = 0;
+        uint32_t requestedChildren = 0; // Requested: their parent must stay resident for them
+        uint64_t lastUsed = 0;
+        uint64_t retryFrame = 0; // not requested before this frame
+        // space already evicted for this node's load, waiting for the GPU since roomFrame
+        uint64_t roomVertices = 0, roomIndexBytes = 0, roomFrame = 0;
+        uint32_t lruPrev = ClusterHierarchy::NO_NODE; // resident nodes, least recently used first
+        uint32_t lruNext = ClusterHierarchy::NO_NODE;
+        GeometryBuffer::Allocation allocation;
+    };
+    struct Request
+    {
+        uint32_t node;
+        float priority; // projected error in pixels
+    };
+    struct Load
+    {
+        uint32_t node;
+        std::vector<unsigned char> data;
+    };
+
+    MappedFile file;
+    const ClusterHierarchy::Header* header = nullptr;
+    const ClusterHierarchy::Node* nodes = nullptr;
+    std::vector<State> states;
+    GeometryBuffer geometry;
+    uint32_t lruHead = ClusterHierarchy::NO_NODE, lruTail = ClusterHierarchy::NO_NODE;
+    uint64_t frame = 0;
+    Stats stats;
+
+    // Select() state
+    glm::vec4 planes[6];
+    glm::mat4 modelView = glm::mat4(1.0f);
+    float scale = 1.0f, pixelsPerUnit = 1.0f, pixelError = 1.0f;
+    std::vector<uint32_t> selected;
+    std::vector<Request> wanted;
+
+    // shared with the I/O threads, guarded by mutex
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Request> queue; // lowest priority first
+    std::vector<Load> completed;
+    bool quit = false;
+    std::vector<std::thread> ioThreads;
+
+    static size_t IndexBytes(const ClusterHierarchy::Node& node){
+        return static_cast<size_t>(node.indexCount) * node.indexSize;
+    }
+    // Error of node n in pixels, measured at the point of its sphere closest to the camera.
+    float ProjectedError(uint32_t n) const{
+        const ClusterHierarchy::Node& node = nodes[n];
+        glm::vec3 center = glm::vec3(modelView * glm::vec4(node.center[0], node.center[1], node.center[2], 1.0f));
+        float distance = glm::max(glm::length(center) - node.radius * scale, 0.1f);
+        return node.error * scale * pixelsPerUnit / distance;
+    }
+    bool InFrustum(uint32_t n) const{
+        const ClusterHierarchy::Node& node = nodes[n];
+        glm::vec3 center(node.center[0], node.center[1], node.center[2]);
+        for (int p = 0; p < 6; p++){
+            if (glm::dot(glm::vec3(planes[p]), center) + planes[p].w < -node.radius){
+                return false;
+            }
+        }
+        return true;
+    }
+    void Visit(uint32_t n){
+        if (!InFrustum(n)){
+            return;
+        }
+        Touch(n);
+        const ClusterHierarchy::Node& node = nodes[n];
+        float error = ProjectedError(n);
+        if (node.childCount == 0 || error <= pixelError){
+            selected.push_back(n);
+            return;
+        }
+        if (states[n].residentChildren == node.childCount){
+            for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++){
+                Visit(c);
+            }
+            return;
+        }
+        // refine once every child is in; until then this node covers them all, and the
+        // children already in count as used so loading their siblings cannot evict them
+        selected.push_back(n);
+        for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++){
+            if (states[c].status == Status::Resident){
+                Touch(c);
+            } else {
+                wanted.push_back({ c, error });
+            }
+        }
+    }
+    void Upload(uint32_t n, const unsigned char* data){
+        const ClusterHierarchy::Node& node = nodes[n];
+        size_t vertexBytes = static_cast<size_t>(node.vertexCount) * sizeof(CompactVertex);
+        geometry.Upload(states[n].allocation, data, vertexBytes, data + vertexBytes, IndexBytes(node));
+    }
+    enum class Room
+    {
+        Allocated,
+        Later, // evicted ranges are released once the GPU has finished with them
+        Full   // everything resident is still in use
+    };
+    // Allocates node n, evicting least recently used nodes to make room for it and, when
+    // the free space exists but is scattered, defragmenting. Space evicted for n on an
+    // earlier frame counts towards it until the GPU has released it, so a load waiting on
+    // Later does not evict again every frame.
+    Room MakeRoom(uint32_t n){
+        const ClusterHierarchy::Node& node = nodes[n];
+        State& state = states[n];
+        if (geometry.TryAllocate(node.vertexCount, IndexBytes(node), state.allocation)){
+            state.roomVertices = state.roomIndexBytes = 0;
+            return Room::Allocated;
+        }
+        if (!geometry.FreesPending() || frame > state.roomFrame + FREE_LATENCY_FRAMES){
+            // released and still no fit, or taken by other loads meanwhile
+            state.roomVertices = state.roomIndexBytes = 0;
+        }
+        uint64_t vertices = state.roomVertices, indexBytes = state.roomIndexBytes;
+        while ((vertices < node.vertexCount || indexBytes < IndexBytes(node)) && EvictOne(vertices, indexBytes)){
+        }
+        if (vertices != state.roomVertices || indexBytes != state.roomIndexBytes){
+            state.roomVertices = vertices;
+            state.roomIndexBytes = indexBytes;
+            state.roomFrame = frame;
+        }
+        if (geometry.FreesPending()){
+            return Room::Later;
+        }
+        state.roomVertices = state.roomIndexBytes = 0;
+        if (geometry.Fragmentation() > GeometryBuffer::DEFRAGMENT_THRESHOLD){
+            geometry.Defragment();
+            if (geometry.TryAllocate(node.vertexCount, IndexBytes(node), state.allocation)){
+                return Room::Allocated;
+            }
+        }
+        return Room::Full;
+    }
+    // Evicts the least recently used node that is not part of this frame's cut and has no
+    // resident or requested children, adding its size to vertices and indexBytes. The root is
+    // never evicted.
+    bool EvictOne(uint64_t& vertices, uint64_t& indexBytes){
+        for (uint32_t n = lruHead; n != ClusterHierarchy::NO_NODE; n = states[n].lruNext){
+            State& state = states[n];
+            if (state.lastUsed >= frame){
+                return false; // the rest of the list is newer still
+            }
+            if (n == 0 || state.residentChildren != 0 || state.requestedChildren != 0){
+                continue;
+            }
+            LruRemove(n);
+            geometry.Free(state.allocation);
+            state.status = Status::NotResident;
+            states[nodes[n].parent].residentChildren--;
+            vertices += nodes[n].vertexCount;
+            indexBytes += IndexBytes(nodes[n]);
+            stats.residentNodes--;
+            stats.evicted++;
+            return true;
+        }
+        return false;
+    }
+    void Touch(uint32_t n){
+        states[n].lastUsed = frame;
+        LruRemove(n);
+        LruPush(n);
+    }
+    void LruPush(uint32_t n){
+        State& state = states[n];
+        state.lruPrev = lruTail;
+        state.lruNext = ClusterHierarchy::NO_NODE;
+        if (lruTail != ClusterHierarchy::NO_NODE){
+            states[lruTail].lruNext = n;
+        } else {
+            lruHead = n;
+        }
+        lruTail = n;
+    }
+    void LruRemove(uint32_t n){
+        State& state = states[n];
+        if (state.lruPrev != ClusterHierarchy::NO_NODE){
+            states[state.lruPrev].lruNext = state.lruNext;
+        } else {
+            lruHead = state.lruNext;
+        }
+        if (state.lruNext != ClusterHierarchy::NO_NODE){
+            states[state.lruNext].lruPrev = state.lruPrev;
+        } else {
+            lruTail = state.lruPrev;
+        }
+        state.lruPrev = state.lruNext = ClusterHierarchy::NO_NODE;
+    }
+    // Copies requested nodes out of the mapping, then drops those pages again: the OS page
+    // cache still holds them, but the process does not keep the whole file resident.
+    void IoThread(){
+        for (;;){
+            Request request;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]{ return quit || !queue.empty(); });
+                if (quit){
+                    return;
+                }
+                request = queue.back();
+                queue.pop_back();
+            }
+            const ClusterHierarchy::Node& node = nodes[request.node];
+            Load load;
+            load.node = request.node;
+            load.data.assign(file.Data() + node.dataOffset, file.Data() + node.dataOffset + node.dataBytes);
+            file.Release(file.Data() + node.dataOffset, node.dataBytes);
+            std::lock_guard<std::mutex> lock(mutex);
+            completed.push_back(std::move(load));
+        }
+    }
+};
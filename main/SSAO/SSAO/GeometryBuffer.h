@@ -0,0 +1,241 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include "VertexFormat.h"
+#include "OffsetAllocator.h"
+
+// One vertex buffer, one index buffer and one VAO shared by every mesh in the scene format.
+// Meshes are sub-allocated from both buffers by OffsetAllocator (vertices in whole vertices,
+// indices in 4-byte units so 16- and 32-bit index data can share the buffer) and drawn with
+// base-vertex offsets, so switching meshes never rebinds a VAO and meshes can be batched
+// into multi-draws.
+//
+// Offsets move when the buffers grow or are defragmented, so keep the Allocation and ask
+// for BaseVertex()/IndexOffset() when drawing. Growing keeps offsets but replaces the GL
+// buffers, so start streaming uploads into an allocation only after allocating it.
+// Free() is deferred until the GPU has finished the frame that last drew the range, which
+// keeps unsynchronized uploads into recycled ranges safe.
+class GeometryBuffer{
+public:
+    typedef void(*SetupAttributes)(VertexFormat);
+
+    static constexpr uint32_t INDEX_UNIT = 4; // bytes
+    static constexpr float DEFRAGMENT_THRESHOLD = 0.5f; // see Fragmentation()
+
+    struct Allocation
+    {
+        OffsetAllocator::Allocation vertices;
+        OffsetAllocator::Allocation indices;
+    };
+
+    // The VAO is set up once with setupAttributes and again whenever the vertex buffer
+    // is replaced; other attributes on it (instance data) are left alone.
+    void Create(VertexFormat format, SetupAttributes setupAttributes, uint32_t vertexCapacity, uint32_t indexBytes){
+        this->format = format;
+        this->setupAttributes = setupAttributes;
+        stride = VertexStride(format);
+        vertexAllocator.Reset(vertexCapacity);
+        indexAllocator.Reset(static_cast<uint32_t>((static_cast<uint64_t>(indexBytes) + INDEX_UNIT - 1) / INDEX_UNIT));
+        glGenVertexArrays(1, &vao);
+        vertexBuffer = CreateBuffer(static_cast<GLsizeiptr>(vertexCapacity) * stride);
+        indexBuffer = CreateBuffer(static_cast<GLsizeiptr>(indexAllocator.Capacity()) * INDEX_UNIT);
+        AttachBuffers();
+    }
+    // Either count may be zero (non-indexed meshes). Grows the buffers when full; a range
+    // that cannot fit even then (past 2^32 units) comes back invalid.
+    Allocation Allocate(uint32_t vertexCount, size_t indexBytes){
+        Allocation allocation;
+        uint32_t indexUnits = static_cast<uint32_t>((indexBytes + INDEX_UNIT - 1) / INDEX_UNIT);
+        allocation.vertices = vertexAllocator.Allocate(vertexCount);
+        if (vertexCount != 0 && !allocation.vertices.Valid() && GrowBuffer(vertexAllocator, vertexBuffer, stride, vertexCount)){
+            allocation.vertices = vertexAllocator.Allocate(vertexCount);
+        }
+        allocation.indices = indexAllocator.Allocate(indexUnits);
+        if (indexUnits != 0 && !allocation.indices.Valid() && GrowBuffer(indexAllocator, indexBuffer, INDEX_UNIT, indexUnits)){
+            allocation.indices = indexAllocator.Allocate(indexUnits);
+        }
+        return allocation;
+    }
+    // Like Allocate, but never grows: for callers working to a fixed budget. Returns false
+    // and leaves allocation invalid if either range does not fit.
+    bool TryAllocate(uint32_t vertexCount, size_t indexBytes, Allocation& allocation){
+        uint32_t indexUnits = static_cast<uint32_t>((indexBytes + INDEX_UNIT - 1) / INDEX_UNIT);
+        allocation.vertices = vertexAllocator.Allocate(vertexCount);
+        allocation.indices = indexAllocator.Allocate(indexUnits);
+        if ((vertexCount != 0 && !allocation.vertices.Valid()) || (indexUnits != 0 && !allocation.indices.Valid())){
+            // never drawn, so released at once rather than through Free()
+            vertexAllocator.Free(allocation.vertices);
+            indexAllocator.Free(allocation.indices);
+            return false;
+        }
+        return true;
+    }
+    // Small meshes are written directly; large ones should stream (see StreamingUpload).
+    void Upload(const Allocation& allocation, const void* vertices, size_t vertexBytes, const void* indices, size_t indexBytes){
+        if (vertexBytes != 0){
+            glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, VertexOffset(allocation), static_cast<GLsizeiptr>(vertexBytes), vertices);
+        }
+        if (indexBytes != 0){
+            glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, IndexOffset(allocation), static_cast<GLsizeiptr>(indexBytes), indices);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    void Free(Allocation& allocation){
+        freedThisFrame.push_back(allocation);
+        allocation = Allocation();
+    }
+    // Call once per frame after the frame's draws: fences this frame's frees and releases
+    // the ranges of earlier frames the GPU is done with.
+    void EndFrame(){
+        if (!freedThisFrame.empty()){
+            pendingFrees.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), std::move(freedThisFrame) });
+            freedThisFrame.clear();
+        }
+        while (!pendingFrees.empty()){
+            GLenum status = glClientWaitSync(pendingFrees.front().fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED){
+                break;
+            }
+            glDeleteSync(pendingFrees.front().fence);
+            for (Allocation& allocation : pendingFrees.front().allocations){
+                vertexAllocator.Free(allocation.vertices);
+                indexAllocator.Free(allocation.indices);
+            }
+            pendingFrees.pop_front();
+        }
+    }
+    // True while freed ranges wait for the GPU before they can be allocated again.
+    bool FreesPending() const{
+        return !freedThisFrame.empty() || !pendingFrees.empty();
+    }
+    // Share of free space that is not in the largest free block, the worse of both
+    // buffers: 0 when all free space is contiguous.
+    float Fragmentation() const{
+        return std::max(Fragmentation(vertexAllocator), Fragmentation(indexAllocator));
+    }
+    // Packs both buffers so all free space is one block at the end. Copies every live
+    // range on the GPU into new buffers; must not run while an upload into either buffer
+    // is in flight. Returns the number of ranges moved.
+    size_t Defragment(){
+        return Compact(vertexAllocator, vertexBuffer, stride) + Compact(indexAllocator, indexBuffer, INDEX_UNIT);
+    }
+    void Bind() const{
+        glBindVertexArray(vao);
+    }
+    GLuint Vao() const{
+        return vao;
+    }
+    GLuint VertexBuffer() const{
+        return vertexBuffer;
+    }
+    GLuint IndexBuffer() const{
+        return indexBuffer;
+    }
+    GLint BaseVertex(const Allocation& allocation) const{
+        return allocation.vertices.Valid() ? static_cast<GLint>(vertexAllocator.Offset(allocation.vertices)) : 0;
+    }
+    GLintptr VertexOffset(const Allocation& allocation) const{
+        return static_cast<GLintptr>(BaseVertex(allocation)) * stride;
+    }
+    // Byte offset of the allocation's index data in IndexBuffer().
+    GLintptr IndexOffset(const Allocation& allocation) const{
+        return allocation.indices.Valid() ? static_cast<GLintptr>(indexAllocator.Offset(allocation.indices)) * INDEX_UNIT : 0;
+    }
+    size_t VertexCapacityBytes() const{
+        return static_cast<size_t>(vertexAllocator.Capacity()) * stride;
+    }
+    size_t IndexCapacityBytes() const{
+        return static_cast<size_t>(indexAllocator.Capacity()) * INDEX_UNIT;
+    }
+    size_t UsedBytes() const{
+        return VertexCapacityBytes() - static_cast<size_t>(vertexAllocator.GetReport().freeUnits) * stride +
+               IndexCapacityBytes() - static_cast<size_t>(indexAllocator.GetReport().freeUnits) * INDEX_UNIT;
+    }
+private:
+    struct PendingFree
+    {
+        GLsync fence;
+        std::vector<Allocation> allocations;
+    };
+    VertexFormat format = VertexFormat::Compact;
+    SetupAttributes setupAttributes = nullptr;
+    uint32_t stride = 0;
+    GLuint vao = 0;
+    GLuint vertexBuffer = 0;
+    GLuint indexBuffer = 0;
+    OffsetAllocator vertexAllocator;
+    OffsetAllocator indexAllocator;
+    std::vector<Allocation> freedThisFrame;
+    std::deque<PendingFree> pendingFrees;
+
+    static GLuint CreateBuffer(GLsizeiptr bytes){
+        GLuint buffer;
+        glGenBuffers(1, &buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, bytes, NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return buffer;
+    }
+    static float Fragmentation(const OffsetAllocator& allocator){
+        OffsetAllocator::Report report = allocator.GetReport();
+        return report.freeUnits == 0 ? 0.0f : 1.0f - static_cast<float>(report.largestFree) / static_cast<float>(report.freeUnits);
+    }
+    void AttachBuffers(){
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        setupAttributes(format);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+        glBindVertexArray(0);
+    }
+    // Replaces buffer with one at least twice as large holding the same data at the same
+    // offsets, with room for a block of needed units. Offsets are 32-bit, so the capacity
+    // stops at UINT32_MAX units; returns false if needed does not fit even then.
+    bool GrowBuffer(OffsetAllocator& allocator, GLuint& buffer, uint32_t unitBytes, uint32_t needed){
+        uint64_t capacity = allocator.Capacity();
+        if (capacity + needed > UINT32_MAX){
+            std::cout << "Geometry buffer cannot grow past " << UINT32_MAX << " units" << std::endl;
+            return false;
+        }
+        uint32_t grown = static_cast<uint32_t>(std::min<uint64_t>(std::max(capacity * 2, capacity + needed), UINT32_MAX));
+        GLuint replacement = CreateBuffer(static_cast<GLsizeiptr>(grown) * unitBytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, replacement);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, static_cast<GLsizeiptr>(capacity) * unitBytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+        buffer = replacement;
+        allocator.Grow(grown);
+        AttachBuffers();
+        return true;
+    }
+    size_t Compact(OffsetAllocator& allocator, GLuint& buffer, uint32_t unitBytes){
+        std::vector<OffsetAllocator::Move> moves = allocator.Compact();
+        if (moves.empty()){
+            return 0;
+        }
+        // ranges before the first move already sit at their packed offset
+        GLuint replacement = CreateBuffer(static_cast<GLsizeiptr>(allocator.Capacity()) * unitBytes);
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, replacement);
+        if (moves.front().to != 0){
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, static_cast<GLsizeiptr>(moves.front().to) * unitBytes);
+        }
+        for (const OffsetAllocator::Move& move : moves){
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(move.from) * unitBytes,
+                                static_cast<GLintptr>(move.to) * unitBytes, static_cast<GLsizeiptr>(move.size) * unitBytes);
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+        buffer = replacement;
+        AttachBuffers();
+        return moves.size();
+    }
+};
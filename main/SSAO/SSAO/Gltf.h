@@ -0,0 +1,373 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/quaternion.hpp"
+#include "glm/gtc/type_ptr.hpp"
+#include "Json.h"
+
+// glTF 2.0 binary (.glb) container parsing. Only what the renderer draws is extracted:
+// buffer views and accessors of triangle primitives (POSITION, NORMAL, indices) and the
+// node hierarchy that places meshes in the scene. All data must live in the GLB's BIN
+// chunk; external buffers, sparse accessors and compressed extensions are rejected.
+// KHR_mesh_quantization is supported: integer positions/normals are kept as they are and
+// dequantized by the vertex fetch (normalized flag) plus the node transform, exactly as
+// the extension specifies. Kept free of GL types; GltfModel.h does the upload.
+namespace Gltf
+{
+const uint32_t GLB_MAGIC = 0x46546C67;      // "glTF"
+const uint32_t CHUNK_JSON = 0x4E4F534A;     // "JSON"
+const uint32_t CHUNK_BIN = 0x004E4942;      // "BIN\0"
+
+// accessor component types; the values match the GL enums
+const uint32_t BYTE = 5120;
+const uint32_t UNSIGNED_BYTE = 5121;
+const uint32_t SHORT = 5122;
+const uint32_t UNSIGNED_SHORT = 5123;
+const uint32_t UNSIGNED_INT = 5125;
+const uint32_t FLOAT = 5126;
+
+const uint32_t MODE_TRIANGLES = 4;
+
+struct BufferView
+{
+    uint32_t byteOffset = 0; // into the BIN chunk
+    uint32_t byteLength = 0;
+    uint32_t byteStride = 0; // 0 = tightly packed
+    bool embedded = false;   // lies inside the BIN chunk
+};
+
+struct Accessor
+{
+    int32_t bufferView = -1;
+    uint32_t byteOffset = 0;
+    uint32_t componentType = FLOAT;
+    uint32_t components = 1;
+    uint32_t count = 0;
+    bool normalized = false;
+    bool valid = false;      // drawable layout inside an embedded view
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+};
+
+struct Primitive
+{
+    int32_t position = -1;
+    int32_t normal = -1;
+    int32_t indices = -1;
+    uint32_t mode = MODE_TRIANGLES;
+};
+
+// one placement of a mesh by a node
+struct Instance
+{
+    uint32_t mesh;
+    glm::mat4 transform;
+};
+
+struct Asset
+{
+    const unsigned char* bin = nullptr; // points into the caller's GLB data
+    size_t binSize = 0;
+    std::vector<BufferView> bufferViews;
+    std::vector<Accessor> accessors;
+    std::vector<std::vector<Primitive>> meshes;
+    std::vector<Instance> instances;
+    bool quantized = false;             // any integer POSITION/NORMAL attribute
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+};
+
+inline uint32_t ComponentSize(uint32_t componentType)
+{
+    switch (componentType) {
+        case BYTE: case UNSIGNED_BYTE: return 1;
+        case SHORT: case UNSIGNED_SHORT: return 2;
+        case UNSIGNED_INT: case FLOAT: return 4;
+        default: return 0;
+    }
+}
+
+inline uint32_t ComponentCount(const std::string& type)
+{
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4") return 4;
+    return 0;
+}
+
+// Bytes between consecutive elements of an accessor.
+inline uint32_t Stride(const Asset& asset, const Accessor& accessor)
+{
+    uint32_t stride = asset.bufferViews[accessor.bufferView].byteStride;
+    return stride != 0 ? stride : accessor.components * ComponentSize(accessor.componentType);
+}
+
+// Value a normalized integer maps to in the shader.
+inline float Dequantize(float value, uint32_t componentType)
+{
+    switch (componentType) {
+        case BYTE: return glm::max(value / 127.0f, -1.0f);
+        case UNSIGNED_BYTE: return value / 255.0f;
+        case SHORT: return glm::max(value / 32767.0f, -1.0f);
+        case UNSIGNED_SHORT: return value / 65535.0f;
+        default: return value;
+    }
+}
+
+inline glm::mat4 NodeTransform(const Json::Value& node)
+{
+    const Json::Value& matrix = node["matrix"];
+    if (matrix.Size() == 16) {
+        glm::mat4 m;
+        for (int i = 0; i < 16; i++) {
+            glm::value_ptr(m)[i] = static_cast<float>(matrix[i].Number(0.0));
+        }
+        return m;
+    }
+    const Json::Value& t = node["translation"];
+    const Json::Value& r = node["rotation"];
+    const Json::Value& s = node["scale"];
+    glm::vec3 translation(t[0].Number(0.0), t[1].Number(0.0), t[2].Number(0.0));
+    glm::quat rotation(static_cast<float>(r[3].Number(1.0)), static_cast<float>(r[0].Number(0.0)),
+                       static_cast<float>(r[1].Number(0.0)), static_cast<float>(r[2].Number(0.0)));
+    glm::vec3 scale(s[0].Number(1.0), s[1].Number(1.0), s[2].Number(1.0));
+    return glm::translate(glm::mat4(1.0f), translation) * glm::mat4_cast(rotation) * glm::scale(glm::mat4(1.0f), scale);
+}
+
+// Reads an accessor and marks it valid if the renderer could draw from it. Invalid ones are
+// only an error when a primitive references them (sparse, external or matrix data may be
+// used by parts of the file that are not drawn).
+inline bool ParseAccessor(const Json::Value& json, const Asset& asset, Accessor& out)
+{
+    out.bufferView = static_cast<int32_t>(json["bufferView"].Int(-1));
+    out.byteOffset = static_cast<uint32_t>(json["byteOffset"].Int(0));
+    out.componentType = static_cast<uint32_t>(json["componentType"].Int(0));
+    out.components = ComponentCount(json["type"].string);
+    out.count = static_cast<uint32_t>(json["count"].Int(0));
+    out.normalized = json["normalized"].Bool(false);
+    for (int i = 0; i < 3; i++) {
+        out.min[i] = static_cast<float>(json["min"][i].Number(0.0));
+        out.max[i] = static_cast<float>(json["max"][i].Number(0.0));
+    }
+    uint32_t componentSize = ComponentSize(out.componentType);
+    if (json.Has("sparse") || out.bufferView < 0 || static_cast<size_t>(out.bufferView) >= asset.bufferViews.size() ||
+        !asset.bufferViews[out.bufferView].embedded || componentSize == 0 || out.components == 0 || out.count == 0) {
+        return false;
+    }
+    // the whole accessor must lie inside its view, aligned to its component size
+    const BufferView& view = asset.bufferViews[out.bufferView];
+    uint64_t elementSize = static_cast<uint64_t>(out.components) * componentSize;
+    uint64_t stride = view.byteStride != 0 ? view.byteStride : elementSize;
+    uint64_t last = out.byteOffset + stride * (out.count - 1) + elementSize;
+    out.valid = last <= view.byteLength && out.byteOffset % componentSize == 0 && stride % componentSize == 0;
+    return out.valid;
+}
+
+// Checks that an attribute accessor uses a layout the renderer (and the extension) allows:
+// 3 components, integer normals normalized.
+inline bool ValidAttribute(const Accessor& accessor, bool normal)
+{
+    if (!accessor.valid || accessor.components != 3) {
+        return false;
+    }
+    switch (accessor.componentType) {
+        case FLOAT: return !accessor.normalized;
+        case BYTE: case SHORT: return !normal || accessor.normalized;
+        case UNSIGNED_BYTE: case UNSIGNED_SHORT: return !normal;
+        default: return false;
+    }
+}
+
+inline bool ParseJson(const Json::Value& doc, Asset& out)
+{
+    if (doc["asset"]["version"].string.compare(0, 2, "2.") != 0) {
+        std::cout << "Unsupported glTF version" << std::endl;
+        return false;
+    }
+    for (const Json::Value& extension : doc["extensionsRequired"].array) {
+        if (extension.string != "KHR_mesh_quantization") {
+            std::cout << "Unsupported glTF extension: " << extension.string << std::endl;
+            return false;
+        }
+    }
+
+    for (const Json::Value& json : doc["bufferViews"].array) {
+        BufferView view;
+        view.byteOffset = static_cast<uint32_t>(json["byteOffset"].Int(0));
+        view.byteLength = static_cast<uint32_t>(json["byteLength"].Int(0));
+        view.byteStride = static_cast<uint32_t>(json["byteStride"].Int(0));
+        // views elsewhere (external buffers) only matter if a primitive uses them
+        view.embedded = json["buffer"].Int(-1) == 0 && !doc["buffers"][0].Has("uri") &&
+                        static_cast<uint64_t>(view.byteOffset) + view.byteLength <= out.binSize;
+        out.bufferViews.push_back(view);
+    }
+    for (const Json::Value& json : doc["accessors"].array) {
+        out.accessors.emplace_back();
+        ParseAccessor(json, out, out.accessors.back());
+    }
+
+    auto accessorIndex = [&](const Json::Value& value) {
+        int64_t index = value.Int(-1);
+        return index >= 0 && static_cast<size_t>(index) < out.accessors.size() ? static_cast<int32_t>(index) : -1;
+    };
+    for (const Json::Value& json : doc["meshes"].array) {
+        out.meshes.emplace_back();
+        for (const Json::Value& p : json["primitives"].array) {
+            Primitive primitive;
+            primitive.mode = static_cast<uint32_t>(p["mode"].Int(MODE_TRIANGLES));
+            primitive.position = accessorIndex(p["attributes"]["POSITION"]);
+            primitive.normal = accessorIndex(p["attributes"]["NORMAL"]);
+            primitive.indices = accessorIndex(p["indices"]);
+            if (primitive.mode != MODE_TRIANGLES || primitive.position < 0) {
+                continue; // points, lines and attribute-less primitives are not drawn
+            }
+            const Accessor& position = out.accessors[primitive.position];
+            if (!ValidAttribute(position, false) ||
+                (primitive.normal >= 0 && (!ValidAttribute(out.accessors[primitive.normal], true) ||
+                                           out.accessors[primitive.normal].count != position.count))) {
+                std::cout << "Unsupported glTF vertex attribute (sparse, external or unsupported format)" << std::endl;
+                return false;
+            }
+            out.quantized |= position.componentType != FLOAT ||
+                             (primitive.normal >= 0 && out.accessors[primitive.normal].componentType != FLOAT);
+            if (primitive.indices >= 0) {
+                const Accessor& indices = out.accessors[primitive.indices];
+                bool indexType = indices.componentType == UNSIGNED_BYTE || indices.componentType == UNSIGNED_SHORT ||
+                                 indices.componentType == UNSIGNED_INT;
+                if (!indices.valid || !indexType || indices.components != 1 || out.bufferViews[indices.bufferView].byteStride != 0) {
+                    std::cout << "Invalid glTF index accessor" << std::endl;
+                    return false;
+                }
+            }
+            out.meshes.back().push_back(primitive);
+        }
+    }
+
+    // walk the default scene (or every root node) accumulating transforms
+    const Json::Value& nodes = doc["nodes"];
+    std::vector<uint32_t> roots;
+    const Json::Value& scene = doc["scenes"][static_cast<size_t>(doc["scene"].Int(0))];
+    if (scene.type == Json::Type::Object) {
+        for (const Json::Value& node : scene["nodes"].array) {
+            roots.push_back(static_cast<uint32_t>(node.Int(0)));
+        }
+    } else {
+        std::vector<char> isChild(nodes.Size(), 0);
+        for (const Json::Value& node : nodes.array) {
+            for (const Json::Value& child : node["children"].array) {
+                size_t c = static_cast<size_t>(child.Int(0));
+                if (c < isChild.size()) {
+                    isChild[c] = 1;
+                }
+            }
+        }
+        for (uint32_t i = 0; i < nodes.Size(); i++) {
+            if (!isChild[i]) {
+                roots.push_back(i);
+            }
+        }
+    }
+    struct Pending
+    {
+        uint32_t node;
+        glm::mat4 parent;
+        uint32_t depth;
+    };
+    std::vector<Pending> stack;
+    for (uint32_t root : roots) {
+        stack.push_back({ root, glm::mat4(1.0f), 0 });
+    }
+    while (!stack.empty()) {
+        Pending pending = stack.back();
+        stack.pop_back();
+        // depth past the node count means a cycle
+        if (pending.node >= nodes.Size() || pending.depth > nodes.Size()) {
+            std::cout << "Invalid glTF node hierarchy" << std::endl;
+            return false;
+        }
+        const Json::Value& node = nodes[static_cast<size_t>(pending.node)];
+        glm::mat4 transform = pending.parent * NodeTransform(node);
+        int64_t mesh = node["mesh"].Int(-1);
+        if (mesh >= 0 && static_cast<size_t>(mesh) < out.meshes.size()) {
+            out.instances.push_back({ static_cast<uint32_t>(mesh), transform });
+        }
+        for (const Json::Value& child : node["children"].array) {
+            stack.push_back({ static_cast<uint32_t>(child.Int(-1)), transform, pending.depth + 1 });
+        }
+    }
+
+    // scene bounds from the (required) POSITION min/max, through the instance transforms
+    bool first = true;
+    for (const Instance& instance : out.instances) {
+        for (const Primitive& primitive : out.meshes[instance.mesh]) {
+            const Accessor& position = out.accessors[primitive.position];
+            glm::vec3 lo = position.min, hi = position.max;
+            if (position.normalized) {
+                for (int k = 0; k < 3; k++) {
+                    lo[k] = Dequantize(lo[k], position.componentType);
+                    hi[k] = Dequantize(hi[k], position.componentType);
+                }
+            }
+            for (int corner = 0; corner < 8; corner++) {
+                glm::vec3 c(corner & 1 ? hi.x : lo.x, corner & 2 ? hi.y : lo.y, corner & 4 ? hi.z : lo.z);
+                glm::vec3 p = glm::vec3(instance.transform * glm::vec4(c, 1.0f));
+                out.boundsMin = first ? p : glm::min(out.boundsMin, p);
+                out.boundsMax = first ? p : glm::max(out.boundsMax, p);
+                first = false;
+            }
+        }
+    }
+    if (first) {
+        std::cout << "glTF scene has no triangle meshes" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Parses a GLB held in memory; out.bin points into data, which must outlive the asset.
+inline bool Parse(const unsigned char* data, size_t size, Asset& out)
+{
+    out = Asset();
+    uint32_t header[3];
+    if (size < sizeof(header)) {
+        std::cout << "Not a GLB file" << std::endl;
+        return false;
+    }
+    memcpy(header, data, sizeof(header));
+    if (header[0] != GLB_MAGIC || header[1] != 2 || header[2] > size) {
+        std::cout << "Not a glTF 2.0 binary file" << std::endl;
+        return false;
+    }
+    const char* json = nullptr;
+    size_t jsonSize = 0;
+    for (size_t offset = sizeof(header); offset + 8 <= header[2];) {
+        uint32_t chunk[2];
+        memcpy(chunk, data + offset, sizeof(chunk));
+        offset += sizeof(chunk);
+        if (chunk[0] > header[2] - offset) {
+            std::cout << "Truncated GLB chunk" << std::endl;
+            return false;
+        }
+        if (chunk[1] == CHUNK_JSON && json == nullptr) {
+            json = reinterpret_cast<const char*>(data + offset);
+            jsonSize = chunk[0];
+        } else if (chunk[1] == CHUNK_BIN && out.bin == nullptr) {
+            out.bin = data + offset;
+            out.binSize = chunk[0];
+        }
+        offset += (chunk[0] + 3) & ~3u;
+    }
+    Json::Value doc;
+    if (json == nullptr || !Json::Parser::Parse(json, json + jsonSize, doc)) {
+        std::cout << "Malformed glTF JSON" << std::endl;
+        return false;
+    }
+    return ParseJson(doc, out);
+}
+}
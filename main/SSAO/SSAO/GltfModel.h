@@ -0,0 +1,166 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstdint>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include <iostream>
+#include "glm/glm.hpp"
+#include "MappedFile.h"
+#include "Gltf.h"
+#include "StreamingUpload.h"
+#include "Shader.h"
+
+// GPU side of a GLB asset. Load() maps the file and parses it (no GL, so it can run on the
+// loader thread). BeginUpload() gives every buffer view used by a primitive its own GL
+// buffer and streams the bytes into it straight from the mapping: no re-interleaving or
+// conversion. VAOs then point at the views with each accessor's own type, offset and stride,
+// so quantized (KHR_mesh_quantization) attributes stay at their compact size on the GPU.
+// Attributes bind to the geometry shader's locations: POSITION 0, NORMAL 2.
+class GltfModel{
+public:
+    bool Load(const char* path){
+        if (!file.Open(path)){
+            std::cout << "Failed to open glTF file: " << path << std::endl;
+            return false;
+        }
+        file.AdviseSequential();
+        if (!Gltf::Parse(static_cast<const unsigned char*>(file.Data()), file.Size(), asset)){
+            file.Close();
+            return false;
+        }
+        size_t primitives = 0, triangles = 0;
+        for (const Gltf::Instance& instance : asset.instances){
+            for (const Gltf::Primitive& primitive : asset.meshes[instance.mesh]){
+                const Gltf::Accessor& count = asset.accessors[primitive.indices >= 0 ? primitive.indices : primitive.position];
+                triangles += count.count / 3;
+                primitives++;
+            }
+        }
+        std::cout << "Loaded " << path << ": " << asset.instances.size() << " mesh instances, " << primitives
+                  << " primitives, " << triangles << " triangles, " << asset.binSize / 1024 << " KB binary"
+                  << (asset.quantized ? " (quantized)" : "") << std::endl;
+        return true;
+    }
+    bool IsLoaded() const{
+        return file.IsOpen();
+    }
+    const Gltf::Asset& GetAsset() const{
+        return asset;
+    }
+    void BeginUpload(){
+        buffers.assign(asset.bufferViews.size(), 0);
+        uploads.clear();
+        for (const std::vector<Gltf::Primitive>& mesh : asset.meshes){
+            for (const Gltf::Primitive& primitive : mesh){
+                for (int32_t accessor : { primitive.position, primitive.normal, primitive.indices }){
+                    if (accessor >= 0){
+                        UploadView(asset.accessors[accessor].bufferView);
+                    }
+                }
+            }
+        }
+
+        draws.assign(asset.meshes.size(), std::vector<Draw>());
+        for (size_t m = 0; m < asset.meshes.size(); m++){
+            for (const Gltf::Primitive& primitive : asset.meshes[m]){
+                Draw draw;
+                glGenVertexArrays(1, &draw.vao);
+                glBindVertexArray(draw.vao);
+                SetupAttribute(0, asset.accessors[primitive.position]);
+                if (primitive.normal >= 0){
+                    SetupAttribute(2, asset.accessors[primitive.normal]);
+                }
+                draw.hasNormal = primitive.normal >= 0;
+                if (primitive.indices >= 0){
+                    const Gltf::Accessor& indices = asset.accessors[primitive.indices];
+                    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[indices.bufferView]);
+                    draw.count = static_cast<GLsizei>(indices.count);
+                    draw.indexType = indices.componentType;
+                    draw.indexOffset = indices.byteOffset;
+                } else {
+                    draw.count = static_cast<GLsizei>(asset.accessors[primitive.position].count);
+                }
+                glBindVertexArray(0);
+                draws[m].push_back(draw);
+            }
+        }
+    }
+    // Streams buffer views within the budget; once everything is on the GPU the mapping is
+    // released and the model becomes drawable.
+    bool StepUpload(double budgetSeconds){
+        auto start = std::chrono::steady_clock::now();
+        bool done = true;
+        for (StreamingUpload& upload : uploads){
+            double spent = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (!upload.Done() && (spent >= budgetSeconds || !upload.Step(budgetSeconds - spent))){
+                done = false;
+                break;
+            }
+        }
+        if (done && !ready){
+            ready = true;
+            uploads.clear();
+            asset.bin = nullptr;
+            file.Close();
+        }
+        return done;
+    }
+    bool Ready() const{
+        return ready;
+    }
+    // Draws every mesh instance; model places the whole scene.
+    void Render(Shader& shader, const glm::mat4& model) const{
+        shader.SetVec3f("positionOffset", glm::vec3(0.0f));
+        shader.SetVec3f("positionScale", glm::vec3(1.0f));
+        for (const Gltf::Instance& instance : asset.instances){
+            shader.SetMatrix4fv("model", model * instance.transform);
+            for (const Draw& draw : draws[instance.mesh]){
+                glBindVertexArray(draw.vao);
+                if (!draw.hasNormal){
+                    // constant attribute value when the primitive has no normals
+                    glVertexAttrib3f(2, 0.0f, 1.0f, 0.0f);
+                }
+                if (draw.indexType != 0){
+                    glDrawElements(GL_TRIANGLES, draw.count, draw.indexType, (GLvoid*)(uintptr_t)draw.indexOffset);
+                } else {
+                    glDrawArrays(GL_TRIANGLES, 0, draw.count);
+                }
+            }
+        }
+        glBindVertexArray(0);
+    }
+private:
+    struct Draw
+    {
+        GLuint vao = 0;
+        GLsizei count = 0;
+        GLenum indexType = 0; // 0 = non-indexed
+        uint32_t indexOffset = 0;
+        bool hasNormal = false;
+    };
+    MappedFile file;
+    Gltf::Asset asset;
+    std::vector<GLuint> buffers;
+    std::vector<StreamingUpload> uploads;
+    std::vector<std::vector<Draw>> draws;
+    bool ready = false;
+
+    void UploadView(int32_t view){
+        if (buffers[view] != 0){
+            return;
+        }
+        const Gltf::BufferView& bufferView = asset.bufferViews[view];
+        glGenBuffers(1, &buffers[view]);
+        uploads.emplace_back();
+        uploads.back().Begin(buffers[view], asset.bin + bufferView.byteOffset, bufferView.byteLength);
+    }
+    void SetupAttribute(GLuint location, const Gltf::Accessor& accessor){
+        glBindBuffer(GL_ARRAY_BUFFER, buffers[accessor.bufferView]);
+        glEnableVertexAttribArray(location);
+        // integer types without the normalized flag are converted to float as-is
+        glVertexAttribPointer(location, static_cast<GLint>(std::min(accessor.components, 3u)), accessor.componentType,
+                              accessor.normalized ? GL_TRUE : GL_FALSE, static_cast<GLsizei>(Gltf::Stride(asset, accessor)),
+                              (GLvoid*)(uintptr_t)accessor.byteOffset);
+    }
+};
@@ -0,0 +1,157 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "glm/glm.hpp"
+#include "Shader.h"
+#include "Mesh.h"
+#include "VertexFormat.h"
+#include "Meshlets.h"
+#include "HiZ.h"
+
+// GPU-driven instance culling and submission (GL 4.3). The instance matrices live in a
+// shader storage buffer; every frame a compute pass tests each instance's bounding sphere
+// against the frustum and optionally the Hi-Z pyramid, picks its LOD and appends its index
+// to that LOD's range of a compacted ID buffer, counting it in the LOD's
+// DrawElementsIndirectCommand. A single glMultiDrawElementsIndirect then draws every LOD,
+// with no per-instance work and no readback on the CPU. The draw reads the IDs as an
+// instanced vertex attribute (location 7), so each command's baseInstance picks its range.
+class GpuCulling{
+public:
+    static constexpr GLuint WORKGROUP_SIZE = 64; // local_size_x of instance_cull.cs
+    static constexpr GLuint ID_LOCATION = 7;
+
+    static bool Supported(){
+        return GLEW_VERSION_4_3 != 0;
+    }
+    void Create(){
+        cull.reset(new Shader("res/shaders/instance_cull.cs"));
+        cull->UseProgram();
+        cull->SetInt("hiZ", 0);
+        draw.reset(new Shader("res/shaders/ssao_geometry_indirect.vs", "res/shaders/ssao_geometry.fs"));
+        glGenBuffers(1, &instanceBuffer);
+        glGenBuffers(1, &idBuffer);
+        glGenBuffers(1, &commandBuffer);
+    }
+    // Points location 7 of the bound VAO at the ID buffer. Draw() enables it only for its
+    // own call, so the other paths sharing the VAO never fetch from it.
+    void SetupInstanceIdAttribute(){
+        glBindBuffer(GL_ARRAY_BUFFER, idBuffer);
+        glVertexAttribIPointer(ID_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), (GLvoid*)0);
+        glVertexAttribDivisor(ID_LOCATION, 1);
+    }
+    void SetMesh(const std::vector<MeshLod>& meshLods, glm::vec3 center, float radius){
+        lods = meshLods;
+        boundsCenter = center;
+        boundsRadius = radius;
+    }
+    // Call whenever the instances change. Each LOD gets room for every instance.
+    void UploadInstances(const std::vector<glm::mat4>& instances){
+        if (instances.size() != instanceCount){
+            instanceCount = static_cast<uint32_t>(instances.size());
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, idBuffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(instanceCount) * MAX_LODS * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, instanceCount * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+        }
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, instanceCount * sizeof(glm::mat4), instances.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    }
+    // Resets the draw commands and dispatches the culling pass. hiZ may be null. baseVertex
+    // and firstIndex place the mesh in the geometry buffer (LOD offsets are relative to them).
+    void Cull(const glm::mat4& view, const glm::mat4& projection, int viewportHeight, float lodPixelError, const HiZPyramid* hiZ,
+              GLint baseVertex, GLuint firstIndex){
+        DrawCommand commands[MAX_LODS];
+        float lodErrors[MAX_LODS] = {};
+        for (uint32_t lod = 0; lod < lods.size(); lod++){
+            commands[lod] = { lods[lod].indexCount, 0, firstIndex + lods[lod].indexOffset, baseVertex, lod * instanceCount };
+            lodErrors[lod] = lods[lod].error;
+        }
+        // orphaned like the instance VBO, so last frame's draw does not hold this up
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, lods.size() * sizeof(DrawCommand), commands, GL_STREAM_DRAW);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        if (instanceCount == 0){
+            return;
+        }
+
+        glm::vec4 planes[6];
+        Meshlets::ExtractFrustum(projection * view, planes);
+        cull->UseProgram();
+        cull->SetInt("instanceCount", static_cast<int>(instanceCount));
+        cull->SetVec4fv("planes", 6, planes);
+        cull->SetVec3f("boundsCenter", boundsCenter);
+        cull->SetFloat("boundsRadius", boundsRadius);
+        cull->SetMatrix4fv("view", view);
+        cull->SetFloat("pixelsPerUnit", projection[1][1] * 0.5f * static_cast<float>(viewportHeight));
+        cull->SetInt("lodCount", static_cast<int>(lods.size()));
+        cull->SetFloatv("lodErrors", MAX_LODS, lodErrors);
+        cull->SetFloat("lodPixelError", lodPixelError);
+        cull->SetInt("occlusion", hiZ != nullptr);
+        if (hiZ != nullptr){
+            cull->SetMatrix4fv("hiZViewProjection", hiZ->BuiltViewProjection());
+            cull->SetVec2f("hiZViewport", hiZ->BuiltViewport());
+            cull->SetInt("hiZLevels", hiZ->Levels());
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, hiZ->Texture());
+        }
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instanceBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, commandBuffer);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, idBuffer);
+        glDispatchCompute((instanceCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+        // the draw reads the commands and the IDs (as a vertex attribute) written above
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    }
+    // Draws everything Cull() kept with the VAO bound by the caller (the geometry buffer's,
+    // with SetupInstanceIdAttribute applied). Leaves the indirect shader program bound.
+    void Draw(const glm::mat4& view, const glm::mat4& projection, glm::vec3 albedo, const Quantization& quantization, GLenum indexType){
+        if (instanceCount == 0 || lods.empty()){
+            return;
+        }
+        draw->UseProgram();
+        draw->SetMatrix4fv("view", view);
+        draw->SetMatrix4fv("projection", projection);
+        draw->SetVec3f("albedo", albedo);
+        draw->SetVec3f("positionOffset", quantization.offset);
+        draw->SetVec3f("positionScale", quantization.scale);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instanceBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glEnableVertexAttribArray(ID_LOCATION);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (GLvoid*)0, static_cast<GLsizei>(lods.size()), 0);
+        glDisableVertexAttribArray(ID_LOCATION);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+    // Instances drawn by the last Draw(). Waits for the GPU, so only for reports.
+    uint32_t ReadVisibleCount(){
+        DrawCommand commands[MAX_LODS];
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, lods.size() * sizeof(DrawCommand), commands);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        uint32_t visible = 0;
+        for (size_t lod = 0; lod < lods.size(); lod++){
+            visible += commands[lod].instanceCount;
+        }
+        return visible;
+    }
+private:
+    // layout fixed by glMultiDrawElementsIndirect
+    struct DrawCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+    std::unique_ptr<Shader> cull;
+    std::unique_ptr<Shader> draw;
+    GLuint instanceBuffer = 0; // mat4 per instance
+    GLuint idBuffer = 0;       // MAX_LODS ranges of instanceCount IDs
+    GLuint commandBuffer = 0;
+    uint32_t instanceCount = 0;
+    std::vector<MeshLod> lods;
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+};
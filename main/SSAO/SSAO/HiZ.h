@@ -0,0 +1,242 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstdint>
+#include <cstring>
+#include <cfloat>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include "glm/glm.hpp"
+#include "Shader.h"
+#include "SceneBvh.h"
+
+// Hierarchical-Z occlusion culling from the geometry pass depth, tested on the CPU.
+// Build() reduces the G-buffer depth texture into a pyramid where every texel holds the
+// farthest depth beneath it (one fragment pass per level, level 0 at half resolution), then
+// starts an asynchronous readback of one small level into a pixel buffer. Poll() picks the
+// readback up once its fence has signaled, a frame or more later, so the GPU never waits.
+// IsOccluded() projects a box with the matrices of the frame the depth came from and culls
+// it only if its nearest depth lies behind the farthest depth under its whole footprint.
+//
+// The depth is at least one frame old, so the test errs towards drawing: boxes that cross
+// the near plane or reach outside the old viewport are kept, footprints are grown by a texel,
+// and Matches() rejects pyramids from a camera that has since moved or turned noticeably. An
+// object that becomes disoccluded shows up once a pyramid without its occluder arrives.
+class HiZPyramid{
+public:
+    static constexpr GLsizei READBACK_WIDTH = 256; // read back the first level at most this wide
+    static constexpr float MAX_CAMERA_MOVE = 0.25f; // world units
+    static constexpr float MIN_CAMERA_DOT = 0.996f; // about 5 degrees
+
+    void Create(GLsizei width, GLsizei height){
+        downsample.reset(new Shader("res/shaders/hiz.vs", "res/shaders/hiz_downsample.fs"));
+        downsample->UseProgram();
+        downsample->SetInt("source", 0);
+        glGenVertexArrays(1, &emptyVAO);
+
+        levelWidth.clear();
+        levelHeight.clear();
+        for (GLsizei w = (width + 1) / 2, h = (height + 1) / 2; ; w = (w + 1) / 2, h = (h + 1) / 2){
+            levelWidth.push_back(w);
+            levelHeight.push_back(h);
+            if (w == 1 && h == 1){
+                break;
+            }
+        }
+        GLint levels = static_cast<GLint>(levelWidth.size());
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        for (GLint level = 0; level < levels; level++){
+            glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, levelWidth[level], levelHeight[level], 0, GL_RED, GL_FLOAT, NULL);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        framebuffers.assign(levels, 0);
+        glGenFramebuffers(levels, framebuffers.data());
+        for (GLint level = 0; level < levels; level++){
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[level]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, level);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+        readbackLevel = 0;
+        while (readbackLevel + 1 < levels && levelWidth[readbackLevel] > READBACK_WIDTH){
+            readbackLevel++;
+        }
+        size_t bytes = static_cast<size_t>(levelWidth[readbackLevel]) * levelHeight[readbackLevel] * sizeof(float);
+        glGenBuffers(2, pixelBuffers);
+        for (GLuint buffer : pixelBuffers){
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+            glBufferData(GL_PIXEL_PACK_BUFFER, bytes, NULL, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+    // Call after the geometry pass with the matrices and viewport it was drawn with.
+    void Build(GLuint depthTexture, const glm::mat4& view, const glm::mat4& projection, int viewportWidth, int viewportHeight){
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        downsample->UseProgram();
+        glBindVertexArray(emptyVAO);
+        glActiveTexture(GL_TEXTURE0);
+        GLint levels = static_cast<GLint>(levelWidth.size());
+        for (GLint level = 0; level < levels; level++){
+            if (level == 0){
+                glBindTexture(GL_TEXTURE_2D, depthTexture);
+            } else {
+                // sample only the previous level while rendering into this one
+                glBindTexture(GL_TEXTURE_2D, texture);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[level]);
+            glViewport(0, 0, levelWidth[level], levelHeight[level]);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+        glBindVertexArray(0);
+        built.view = view;
+        built.viewProjection = projection * view;
+        built.viewport = glm::vec2(viewportWidth, viewportHeight);
+        built.serial = issued + 1;
+
+        // async readback into whichever pixel buffer is free; skipped while both are in flight
+        for (int slot = 0; slot < 2; slot++){
+            if (pending[slot].fence != 0){
+                continue;
+            }
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[readbackLevel]);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[slot]);
+            glReadPixels(0, 0, levelWidth[readbackLevel], levelHeight[readbackLevel], GL_RED, GL_FLOAT, (GLvoid*)0);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            pending[slot].fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            pending[slot].view = view;
+            pending[slot].viewProjection = projection * view;
+            pending[slot].viewport = glm::vec2(viewportWidth, viewportHeight);
+            pending[slot].serial = ++issued;
+            break;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    }
+    // Drops the pyramid and every readback still in flight. Call on frames that skip
+    // Build(), so nothing is culled against depth from before the gap.
+    void Invalidate(){
+        depth.clear();
+        built.serial = 0;
+        current.serial = issued + 1;
+    }
+    // Adopts the newest finished readback, if any. Never blocks.
+    void Poll(){
+        for (int slot = 0; slot < 2; slot++){
+            Frame& frame = pending[slot];
+            if (frame.fence == 0){
+                continue;
+            }
+            GLenum status = glClientWaitSync(frame.fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED){
+                continue;
+            }
+            glDeleteSync(frame.fence);
+            frame.fence = 0;
+            if (frame.serial < current.serial){
+                continue;
+            }
+            size_t count = static_cast<size_t>(levelWidth[readbackLevel]) * levelHeight[readbackLevel];
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pixelBuffers[slot]);
+            const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, count * sizeof(float), GL_MAP_READ_BIT);
+            if (data != NULL){
+                depth.resize(count);
+                memcpy(depth.data(), data, count * sizeof(float));
+                current = frame;
+                current.fence = 0;
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+    }
+    // True if a readback is available and was taken from roughly the current viewpoint.
+    bool Matches(const glm::mat4& view) const{
+        return !depth.empty() && CameraClose(current.view, view);
+    }
+    // The same for Texture() itself, which always holds the latest Build(). Used by tests
+    // that sample the pyramid on the GPU with BuiltViewProjection() instead of reading back.
+    bool BuiltMatches(const glm::mat4& view) const{
+        return built.serial != 0 && CameraClose(built.view, view);
+    }
+    const glm::mat4& BuiltViewProjection() const{
+        return built.viewProjection;
+    }
+    glm::vec2 BuiltViewport() const{
+        return built.viewport;
+    }
+    GLint Levels() const{
+        return static_cast<GLint>(levelWidth.size());
+    }
+    bool IsOccluded(const Aabb& box) const{
+        glm::vec2 lo(FLT_MAX), hi(-FLT_MAX);
+        float nearest = FLT_MAX;
+        for (int corner = 0; corner < 8; corner++){
+            glm::vec3 p((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y, (corner & 4) ? box.max.z : box.min.z);
+            glm::vec4 clip = current.viewProjection * glm::vec4(p, 1.0f);
+            if (clip.w <= 1e-5f){
+                return false; // crosses the near plane
+            }
+            glm::vec3 ndc = glm::vec3(clip) / clip.w;
+            lo = glm::min(lo, glm::vec2(ndc));
+            hi = glm::max(hi, glm::vec2(ndc));
+            nearest = std::min(nearest, ndc.z * 0.5f + 0.5f);
+        }
+        if (lo.x < -1.0f || lo.y < -1.0f || hi.x > 1.0f || hi.y > 1.0f){
+            return false; // partly outside the old view: nothing known there
+        }
+        // viewport pixels -> readback texels (level 0 is half resolution), grown by one texel
+        float texelsPerPixel = 1.0f / static_cast<float>(2 << readbackLevel);
+        glm::vec2 scale = 0.5f * current.viewport * texelsPerPixel;
+        int width = levelWidth[readbackLevel], height = levelHeight[readbackLevel];
+        int x0 = std::max(static_cast<int>(std::floor((lo.x + 1.0f) * scale.x)) - 1, 0);
+        int y0 = std::max(static_cast<int>(std::floor((lo.y + 1.0f) * scale.y)) - 1, 0);
+        int x1 = std::min(static_cast<int>(std::floor((hi.x + 1.0f) * scale.x)) + 1, width - 1);
+        int y1 = std::min(static_cast<int>(std::floor((hi.y + 1.0f) * scale.y)) + 1, height - 1);
+        for (int y = y0; y <= y1; y++){
+            for (int x = x0; x <= x1; x++){
+                if (depth[static_cast<size_t>(y) * width + x] >= nearest){
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+    GLuint Texture() const{
+        return texture;
+    }
+private:
+    struct Frame
+    {
+        GLsync fence = 0;
+        glm::mat4 view = glm::mat4(1.0f);
+        glm::mat4 viewProjection = glm::mat4(1.0f);
+        glm::vec2 viewport = glm::vec2(0.0f);
+        uint64_t serial = 0;
+    };
+    static bool CameraClose(const glm::mat4& oldView, const glm::mat4& newView){
+        glm::mat4 oldCamera = glm::inverse(oldView), newCamera = glm::inverse(newView);
+        return glm::length(glm::vec3(newCamera[3] - oldCamera[3])) <= MAX_CAMERA_MOVE &&
+               glm::dot(glm::vec3(newCamera[2]), glm::vec3(oldCamera[2])) >= MIN_CAMERA_DOT;
+    }
+    std::unique_ptr<Shader> downsample;
+    GLuint emptyVAO = 0;
+    GLuint texture = 0;
+    std::vector<GLuint> framebuffers;
+    std::vector<GLsizei> levelWidth, levelHeight;
+    GLint readbackLevel = 0;
+    GLuint pixelBuffers[2] = { 0, 0 };
+    Frame pending[2];
+    Frame current;
+    Frame built; // matrices of the latest Build(), no fence
+    uint64_t issued = 0;
+    std::vector<float> depth; // readback level of the current frame
+};
@@ -0,0 +1,278 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <utility>
+
+// Minimal JSON DOM, enough for glTF. Objects keep their members in document order and are
+// searched linearly, which is fine for the small objects glTF uses. Lookups of missing keys
+// or indices return a shared null value, so chains like doc["asset"]["version"] are safe.
+namespace Json
+{
+enum class Type
+{
+    Null, Bool, Number, String, Array, Object
+};
+
+struct Value
+{
+    Type type = Type::Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<Value> array;
+    std::vector<std::pair<std::string, Value>> object;
+
+    const Value& operator[](const char* key) const
+    {
+        for (const auto& member : object) {
+            if (member.first == key) {
+                return member.second;
+            }
+        }
+        return Null();
+    }
+    const Value& operator[](size_t index) const
+    {
+        return index < array.size() ? array[index] : Null();
+    }
+    // also keeps a literal 0 from resolving to the const char* overload
+    const Value& operator[](int index) const
+    {
+        return index >= 0 ? (*this)[static_cast<size_t>(index)] : Null();
+    }
+    bool Has(const char* key) const
+    {
+        return &(*this)[key] != &Null();
+    }
+    size_t Size() const
+    {
+        return type == Type::Array ? array.size() : object.size();
+    }
+    double Number(double fallback) const
+    {
+        return type == Type::Number ? number : fallback;
+    }
+    int64_t Int(int64_t fallback) const
+    {
+        return type == Type::Number ? static_cast<int64_t>(number) : fallback;
+    }
+    bool Bool(bool fallback) const
+    {
+        return type == Type::Bool ? boolean : fallback;
+    }
+    static const Value& Null()
+    {
+        static const Value null;
+        return null;
+    }
+};
+
+// Recursive-descent parser; nesting is capped so hostile files cannot exhaust the stack.
+class Parser{
+public:
+    static bool Parse(const char* begin, const char* end, Value& out){
+        Parser parser(begin, end);
+        if (!parser.ParseValue(out, 0)){
+            return false;
+        }
+        parser.SkipWhitespace();
+        return parser.p == parser.end;
+    }
+private:
+    static constexpr int MAX_DEPTH = 64;
+    const char* p;
+    const char* end;
+
+    Parser(const char* begin, const char* end) : p(begin), end(end){}
+
+    void SkipWhitespace(){
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')){
+            p++;
+        }
+    }
+    bool Match(const char* literal){
+        const char* q = p;
+        for (; *literal; literal++, q++){
+            if (q >= end || *q != *literal){
+                return false;
+            }
+        }
+        p = q;
+        return true;
+    }
+    bool ParseValue(Value& out, int depth){
+        SkipWhitespace();
+        if (p >= end || depth > MAX_DEPTH){
+            return false;
+        }
+        switch (*p){
+            case '{': return ParseObject(out, depth);
+            case '[': return ParseArray(out, depth);
+            case '"': out.type = Type::String; return ParseString(out.string);
+            case 't': out.type = Type::Bool; out.boolean = true; return Match("true");
+            case 'f': out.type = Type::Bool; out.boolean = false; return Match("false");
+            case 'n': out.type = Type::Null; return Match("null");
+            default: return ParseNumber(out);
+        }
+    }
+    bool ParseNumber(Value& out){
+        // strtod needs a terminated string; numbers are short, so copy them out
+        char buffer[64];
+        size_t length = 0;
+        while (p + length < end && length < sizeof(buffer) - 1 && p[length] != '\0' && strchr("+-0123456789.eE", p[length]) != nullptr){
+            buffer[length] = p[length];
+            length++;
+        }
+        buffer[length] = '\0';
+        char* stop = nullptr;
+        out.number = strtod(buffer, &stop);
+        if (length == 0 || stop != buffer + length){
+            return false;
+        }
+        out.type = Type::Number;
+        p += length;
+        return true;
+    }
+    static void AppendUtf8(std::string& s, uint32_t c){
+        if (c < 0x80){
+            s += static_cast<char>(c);
+        } else if (c < 0x800){
+            s += static_cast<char>(0xC0 | (c >> 6));
+            s += static_cast<char>(0x80 | (c & 0x3F));
+        } else if (c < 0x10000){
+            s += static_cast<char>(0xE0 | (c >> 12));
+            s += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            s += static_cast<char>(0x80 | (c & 0x3F));
+        } else {
+            s += static_cast<char>(0xF0 | (c >> 18));
+            s += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            s += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            s += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+    bool ParseHex4(uint32_t& out){
+        if (end - p < 4){
+            return false;
+        }
+        out = 0;
+        for (int i = 0; i < 4; i++, p++){
+            char c = *p;
+            uint32_t digit = c >= '0' && c <= '9' ? c - '0' : c >= 'a' && c <= 'f' ? c - 'a' + 10 : c >= 'A' && c <= 'F' ? c - 'A' + 10 : 16;
+            if (digit > 15){
+                return false;
+            }
+            out = out * 16 + digit;
+        }
+        return true;
+    }
+    bool ParseString(std::string& out){
+        p++;
+        out.clear();
+        while (p < end && *p != '"'){
+            if (*p != '\\'){
+                out += *p++;
+                continue;
+            }
+            if (++p >= end){
+                return false;
+            }
+            char escape = *p++;
+            switch (escape){
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    uint32_t c;
+                    if (!ParseHex4(c)){
+                        return false;
+                    }
+                    // surrogate pair
+                    uint32_t low;
+                    if (c >= 0xD800 && c < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u'){
+                        p += 2;
+                        if (!ParseHex4(low)){
+                            return false;
+                        }
+                        c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    AppendUtf8(out, c);
+                    break;
+                }
+                default: return false;
+            }
+        }
+        if (p >= end){
+            return false;
+        }
+        p++;
+        return true;
+    }
+    bool ParseArray(Value& out, int depth){
+        p++;
+        out.type = Type::Array;
+        SkipWhitespace();
+        if (p < end && *p == ']'){
+            p++;
+            return true;
+        }
+        while (true){
+            out.array.emplace_back();
+            if (!ParseValue(out.array.back(), depth + 1)){
+                return false;
+            }
+            SkipWhitespace();
+            if (p < end && *p == ','){
+                p++;
+                continue;
+            }
+            if (p < end && *p == ']'){
+                p++;
+                return true;
+            }
+            return false;
+        }
+    }
+    bool ParseObject(Value& out, int depth){
+        p++;
+        out.type = Type::Object;
+        SkipWhitespace();
+        if (p < end && *p == '}'){
+            p++;
+            return true;
+        }
+        while (true){
+            SkipWhitespace();
+            out.object.emplace_back();
+            if (p >= end || *p != '"' || !ParseString(out.object.back().first)){
+                return false;
+            }
+            SkipWhitespace();
+            if (p >= end || *p != ':'){
+                return false;
+            }
+            p++;
+            if (!ParseValue(out.object.back().second, depth + 1)){
+                return false;
+            }
+            SkipWhitespace();
+            if (p < end && *p == ','){
+                p++;
+                continue;
+            }
+            if (p < end && *p == '}'){
+                p++;
+                return true;
+            }
+            return false;
+        }
+    }
+};
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read-only memory mapping of a whole file. The mapping stays valid until Close()
+// or destruction, so callers can hand Data() straight to the driver.
+class MappedFile{
+public:
+    MappedFile() {}
+    explicit MappedFile(const char* path){
+        Open(path);
+    }
+    ~MappedFile(){
+        Close();
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const char* path){
+        Close();
+        int fd = open(path, O_RDONLY);
+        if (fd < 0){
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size <= 0){
+            close(fd);
+            return false;
+        }
+        void* ptr = mmap(NULL, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (ptr == MAP_FAILED){
+            return false;
+        }
+        data = static_cast<const unsigned char*>(ptr);
+        size = static_cast<size_t>(st.st_size);
+        return true;
+    }
+    void Close(){
+        if (data != nullptr){
+            munmap(const_cast<unsigned char*>(data), size);
+        }
+        data = nullptr;
+        size = 0;
+    }
+    // Hint that the whole mapping will be read front to back.
+    void AdviseSequential() const{
+        if (data != nullptr){
+            madvise(const_cast<unsigned char*>(data), size, MADV_SEQUENTIAL);
+        }
+    }
+    // Drops the resident pages wholly inside [begin, begin + bytes) once they have been
+    // consumed. The mapping stays valid; touching the range again re-reads the file.
+    void Release(const void* begin, size_t bytes) const{
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        uintptr_t first = (reinterpret_cast<uintptr_t>(begin) + page - 1) & ~(page - 1);
+        uintptr_t last = (reinterpret_cast<uintptr_t>(begin) + bytes) & ~(page - 1);
+        if (data != nullptr && last > first){
+            madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED);
+        }
+    }
+    bool IsOpen() const{
+        return data != nullptr;
+    }
+    const unsigned char* Data() const{
+        return data;
+    }
+    size_t Size() const{
+        return size;
+    }
+private:
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+};
@@ -0,0 +1,158 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "glm/glm.hpp"
+
+// One level of detail: a range of the shared index buffer plus its geometric error in
+// object-space units (0 for the full-resolution level).
+struct MeshLod
+{
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    float error;
+    uint32_t reserved;
+};
+const uint32_t MAX_LODS = 8;
+
+// Cluster of up to MESHLET_MAX_VERTICES vertices / MESHLET_MAX_TRIANGLES triangles that is a
+// contiguous range of one LOD's indices, with bounds for CPU culling (see Meshlets.h).
+struct Meshlet
+{
+    uint32_t indexOffset;
+    uint32_t indexCount;
+    float center[3];
+    float radius;
+    float coneAxis[3];
+    float coneCutoff; // sin of the normal cone half-angle; >= 1 means never backface-cull
+};
+const uint32_t MESHLET_MAX_VERTICES = 64;
+const uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// CPU-side indexed triangle mesh: interleaved float vertices (position, color, normal)
+// plus a 32-bit index list. Kept free of GL types so offline code can share it.
+// All LODs share the vertex buffer; lods and meshlets are empty until they are built.
+struct Mesh
+{
+    uint32_t floatsPerVertex = 9;
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<MeshLod> lods;
+    std::vector<Meshlet> meshlets;
+
+    uint32_t VertexCount() const
+    {
+        return static_cast<uint32_t>(vertices.size() / floatsPerVertex);
+    }
+    uint32_t IndexCount() const
+    {
+        return static_cast<uint32_t>(indices.size());
+    }
+    // bounding sphere of all vertices (AABB center, so cheap rather than minimal)
+    void ComputeBounds(glm::vec3& center, float& radius) const
+    {
+        glm::vec3 lo(0.0f), hi(0.0f);
+        for (uint32_t v = 0; v < VertexCount(); v++) {
+            glm::vec3 p(vertices[v * floatsPerVertex], vertices[v * floatsPerVertex + 1], vertices[v * floatsPerVertex + 2]);
+            lo = v == 0 ? p : glm::min(lo, p);
+            hi = v == 0 ? p : glm::max(hi, p);
+        }
+        center = (lo + hi) * 0.5f;
+        radius = 0.0f;
+        for (uint32_t v = 0; v < VertexCount(); v++) {
+            glm::vec3 p(vertices[v * floatsPerVertex], vertices[v * floatsPerVertex + 1], vertices[v * floatsPerVertex + 2]);
+            radius = glm::max(radius, glm::length(p - center));
+        }
+    }
+    // 2 when every index fits in 16 bits, 4 otherwise
+    uint32_t IndexSize() const
+    {
+        return VertexCount() <= 0xFFFF ? 2 : 4;
+    }
+};
+
+// Writes indices at the width reported by IndexSize() into out (which must be large enough).
+inline void PackIndices(const uint32_t* indices, size_t count, uint32_t indexSize, void* out)
+{
+    if (indexSize == 4) {
+        memcpy(out, indices, count * sizeof(uint32_t));
+        return;
+    }
+    uint16_t* out16 = static_cast<uint16_t*>(out);
+    for (size_t i = 0; i < count; i++) {
+        out16[i] = static_cast<uint16_t>(indices[i]);
+    }
+}
+
+// Deduplicates vertices as they are emitted: Insert returns the index of an identical,
+// previously seen vertex or appends a new one. Uses an open-addressing table over the raw
+// float bits (with -0 folded into +0), kept at most half full.
+class VertexWelder{
+public:
+    VertexWelder(Mesh& mesh, size_t expectedVertices) : mesh(mesh){
+        size_t capacity = 64;
+        while (capacity < expectedVertices * 2){
+            capacity <<= 1;
+        }
+        table.assign(capacity, EMPTY);
+        mesh.vertices.reserve(expectedVertices * mesh.floatsPerVertex);
+    }
+    uint32_t Insert(const float* vertex){
+        uint32_t stride = mesh.floatsPerVertex;
+        uint32_t bits[32];
+        for (uint32_t i = 0; i < stride; i++){
+            float f = vertex[i] == 0.0f ? 0.0f : vertex[i];
+            memcpy(&bits[i], &f, sizeof(float));
+        }
+        size_t mask = table.size() - 1;
+        size_t slot = Hash(bits, stride) & mask;
+        while (table[slot] != EMPTY){
+            const float* candidate = &mesh.vertices[static_cast<size_t>(table[slot]) * stride];
+            if (memcmp(candidate, bits, stride * sizeof(float)) == 0){
+                return table[slot];
+            }
+            slot = (slot + 1) & mask;
+        }
+        uint32_t index = mesh.VertexCount();
+        size_t offset = mesh.vertices.size();
+        mesh.vertices.resize(offset + stride);
+        memcpy(&mesh.vertices[offset], bits, stride * sizeof(float));
+        table[slot] = index;
+        if (++count * 2 > table.size()){
+            Grow();
+        }
+        return index;
+    }
+private:
+    static constexpr uint32_t EMPTY = 0xFFFFFFFFu;
+    Mesh& mesh;
+    std::vector<uint32_t> table;
+    size_t count = 0;
+
+    static size_t Hash(const uint32_t* bits, uint32_t stride){
+        uint64_t h = 0xCBF29CE484222325ull;
+        for (uint32_t i = 0; i < stride; i++){
+            h = (h ^ bits[i]) * 0x100000001B3ull;
+        }
+        return static_cast<size_t>(h ^ (h >> 31));
+    }
+    void Grow(){
+        std::vector<uint32_t> old;
+        old.swap(table);
+        table.assign(old.size() * 2, EMPTY);
+        size_t mask = table.size() - 1;
+        uint32_t stride = mesh.floatsPerVertex;
+        for (uint32_t index : old){
+            if (index == EMPTY){
+                continue;
+            }
+            uint32_t bits[32];
+            memcpy(bits, &mesh.vertices[static_cast<size_t>(index) * stride], stride * sizeof(float));
+            size_t slot = Hash(bits, stride) & mask;
+            while (table[slot] != EMPTY){
+                slot = (slot + 1) & mask;
+            }
+            table[slot] = index;
+        }
+    }
+};
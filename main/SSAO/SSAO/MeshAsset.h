@@ -0,0 +1,267 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <sys/stat.h>
+#include "MappedFile.h"
+#include "Mesh.h"
+#include "VertexFormat.h"
+#include "MeshCodec.h"
+
+// Versioned binary mesh file written next to a source model ("dragon.obj.compact.meshcache").
+// It holds the final vertex and index streams exactly as LoadModel uploads them, so a
+// valid cache is mmapped and handed to glBufferData without any parsing or copying.
+// Caches written with Encoding::Codec store both streams compressed (MeshCodec.h) instead:
+// smaller on disk and cheaper to read, at the cost of one decode pass into memory.
+namespace MeshAsset
+{
+const uint32_t MAGIC = 0x4F415353; // "SSAO"
+const uint32_t VERSION = 7;
+const uint64_t DATA_ALIGNMENT = 64;
+
+enum class Encoding : uint32_t
+{
+    Raw = 0,
+    Codec = 1
+};
+
+// Identifies the source file and build settings the cache was made from. Any mismatch
+// forces a rebuild.
+struct SourceStamp
+{
+    uint64_t size = 0;
+    int64_t mtime = 0; // nanoseconds since epoch
+    uint64_t hash = 0;
+    uint64_t settings = 0; // hash of settings that shape the data, e.g. LOD ratios
+};
+
+struct Header
+{
+    uint32_t magic;
+    uint32_t version;
+    SourceStamp source;
+    uint32_t vertexFormat; // VertexFormat
+    uint32_t vertexStride; // bytes
+    float quantizationOffset[3];
+    float quantizationScale[3];
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t indexSize; // bytes per index: 2 or 4
+    uint32_t encoding;  // Encoding
+    uint32_t lodCount;
+    MeshLod lods[MAX_LODS];
+    float boundsCenter[3];
+    float boundsRadius;
+    uint64_t vertexOffset;
+    uint64_t vertexBytes; // stored bytes: encoded size when compressed
+    uint64_t indexOffset;
+    uint64_t indexBytes;
+    uint64_t meshletOffset;
+    uint64_t meshletCount;
+};
+
+inline uint64_t Align(uint64_t offset)
+{
+    return (offset + DATA_ALIGNMENT - 1) & ~(DATA_ALIGNMENT - 1);
+}
+
+// One cache per vertex format, so switching layouts for A/B runs does not force a rebuild.
+inline std::string CachePath(const char* sourcePath, VertexFormat format)
+{
+    return std::string(sourcePath) + "." + VertexFormatName(format) + ".meshcache";
+}
+
+// 64-bit word-at-a-time hash; fast enough to run over the whole source on every launch.
+inline uint64_t Hash(const unsigned char* data, size_t size)
+{
+    const uint64_t prime = 0x100000001B3ull;
+    uint64_t h = 0xCBF29CE484222325ull ^ size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        h = (h ^ word) * prime;
+        h ^= h >> 29;
+    }
+    for (; i < size; i++) {
+        h = (h ^ data[i]) * prime;
+    }
+    return h ^ (h >> 32);
+}
+
+inline bool StampSource(const char* sourcePath, SourceStamp& stamp)
+{
+    struct stat st;
+    if (stat(sourcePath, &st) != 0) {
+        return false;
+    }
+    stamp.size = static_cast<uint64_t>(st.st_size);
+#ifdef __APPLE__
+    stamp.mtime = static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000ll + st.st_mtimespec.tv_nsec;
+#else
+    stamp.mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000ll + st.st_mtim.tv_nsec;
+#endif
+    MappedFile source(sourcePath);
+    if (!source.IsOpen()) {
+        return false;
+    }
+    source.AdviseSequential();
+    stamp.hash = Hash(source.Data(), source.Size());
+    return true;
+}
+
+// Maps the cache and validates it against the source stamp. Returns the header inside
+// the mapping, or nullptr if the cache is missing, stale or from another version.
+inline const Header* Open(const char* cachePath, const SourceStamp& stamp, VertexFormat format, MappedFile& file)
+{
+    if (!file.Open(cachePath) || file.Size() < sizeof(Header)) {
+        file.Close();
+        return nullptr;
+    }
+    const Header* header = reinterpret_cast<const Header*>(file.Data());
+    bool valid = header->magic == MAGIC && header->version == VERSION &&
+                 header->source.size == stamp.size && header->source.mtime == stamp.mtime &&
+                 header->source.hash == stamp.hash && header->source.settings == stamp.settings &&
+                 header->lodCount >= 1 && header->lodCount <= MAX_LODS &&
+                 header->vertexFormat == static_cast<uint32_t>(format) && header->vertexStride == VertexStride(format) &&
+                 header->vertexOffset + header->vertexBytes <= file.Size() &&
+                 header->indexOffset + header->indexBytes <= file.Size() &&
+                 (header->indexSize == 2 || header->indexSize == 4) &&
+                 (header->encoding == static_cast<uint32_t>(Encoding::Codec) ||
+                  (header->encoding == static_cast<uint32_t>(Encoding::Raw) &&
+                   header->vertexBytes == static_cast<uint64_t>(header->vertexCount) * header->vertexStride &&
+                   header->indexBytes == static_cast<uint64_t>(header->indexCount) * header->indexSize)) &&
+                 header->meshletOffset + header->meshletCount * sizeof(Meshlet) <= file.Size();
+    for (uint32_t i = 0; valid && i < header->lodCount; i++) {
+        valid = static_cast<uint64_t>(header->lods[i].indexOffset) + header->lods[i].indexCount <= header->indexCount;
+    }
+    if (!valid) {
+        file.Close();
+        return nullptr;
+    }
+    return header;
+}
+
+inline const void* VertexData(const Header* header)
+{
+    return reinterpret_cast<const unsigned char*>(header) + header->vertexOffset;
+}
+
+inline const Meshlet* MeshletData(const Header* header)
+{
+    return reinterpret_cast<const Meshlet*>(reinterpret_cast<const unsigned char*>(header) + header->meshletOffset);
+}
+
+inline Quantization GetQuantization(const Header* header)
+{
+    Quantization q;
+    q.offset = glm::vec3(header->quantizationOffset[0], header->quantizationOffset[1], header->quantizationOffset[2]);
+    q.scale = glm::vec3(header->quantizationScale[0], header->quantizationScale[1], header->quantizationScale[2]);
+    return q;
+}
+
+inline const void* IndexData(const Header* header)
+{
+    return reinterpret_cast<const unsigned char*>(header) + header->indexOffset;
+}
+
+inline bool IsCompressed(const Header* header)
+{
+    return header->encoding == static_cast<uint32_t>(Encoding::Codec);
+}
+
+// Expands a compressed cache's streams into upload-ready vertex and index bytes.
+inline bool Decode(const Header* header, std::vector<unsigned char>& vertices, std::vector<unsigned char>& indices)
+{
+    vertices.resize(static_cast<size_t>(header->vertexCount) * header->vertexStride);
+    indices.resize(static_cast<size_t>(header->indexCount) * header->indexSize);
+    return MeshCodec::DecodeVertices(static_cast<const unsigned char*>(VertexData(header)), header->vertexBytes,
+                                     header->vertexCount, header->vertexStride, vertices.data()) &&
+           MeshCodec::DecodeIndices(static_cast<const unsigned char*>(IndexData(header)), header->indexBytes,
+                                    header->indexCount, header->vertexCount, header->indexSize, indices.data());
+}
+
+// Writes to a temporary file first and renames it into place, so a crash mid-write
+// never leaves a truncated cache that passes validation. Indices are stored at the
+// narrowest width that fits (Mesh::IndexSize) so they can be uploaded as-is. With
+// compress set both streams go through MeshCodec first.
+inline bool Write(const char* cachePath, const SourceStamp& stamp, const VertexStream& vertices, const Mesh& mesh, bool compress = false)
+{
+    std::vector<unsigned char> encodedVertices, encodedIndices;
+    if (compress) {
+        MeshCodec::EncodeVertices(vertices.bytes.data(), vertices.count, vertices.stride, encodedVertices);
+        MeshCodec::EncodeIndices(mesh.indices.data(), mesh.indices.size(), encodedIndices);
+    }
+
+    Header header = {};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.source = stamp;
+    header.vertexFormat = static_cast<uint32_t>(vertices.format);
+    header.vertexStride = vertices.stride;
+    for (int i = 0; i < 3; i++) {
+        header.quantizationOffset[i] = vertices.quantization.offset[i];
+        header.quantizationScale[i] = vertices.quantization.scale[i];
+    }
+    header.vertexCount = vertices.count;
+    header.indexCount = mesh.IndexCount();
+    header.indexSize = mesh.IndexSize();
+    header.encoding = static_cast<uint32_t>(compress ? Encoding::Codec : Encoding::Raw);
+    header.lodCount = mesh.lods.empty() ? 1 : static_cast<uint32_t>(mesh.lods.size());
+    header.lods[0] = { 0, mesh.IndexCount(), 0.0f, 0 };
+    for (size_t i = 0; i < mesh.lods.size() && i < MAX_LODS; i++) {
+        header.lods[i] = mesh.lods[i];
+    }
+    glm::vec3 center;
+    mesh.ComputeBounds(center, header.boundsRadius);
+    header.boundsCenter[0] = center.x;
+    header.boundsCenter[1] = center.y;
+    header.boundsCenter[2] = center.z;
+    header.vertexOffset = Align(sizeof(Header));
+    header.vertexBytes = compress ? encodedVertices.size() : vertices.bytes.size();
+    header.indexOffset = Align(header.vertexOffset + header.vertexBytes);
+    header.indexBytes = compress ? encodedIndices.size() : static_cast<uint64_t>(header.indexCount) * header.indexSize;
+    header.meshletOffset = Align(header.indexOffset + header.indexBytes);
+    header.meshletCount = mesh.meshlets.size();
+
+    std::string tempPath = std::string(cachePath) + ".tmp";
+    FILE* out = fopen(tempPath.c_str(), "wb");
+    if (out == NULL) {
+        std::cout << "Failed to write mesh cache: " << cachePath << std::endl;
+        return false;
+    }
+    static const unsigned char padding[DATA_ALIGNMENT] = {};
+    uint64_t vertexPad = header.vertexOffset - sizeof(header);
+    uint64_t indexPad = header.indexOffset - header.vertexOffset - header.vertexBytes;
+    uint64_t meshletPad = header.meshletOffset - header.indexOffset - header.indexBytes;
+    uint64_t meshletBytes = header.meshletCount * sizeof(Meshlet);
+    bool ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+              fwrite(padding, 1, vertexPad, out) == vertexPad &&
+              fwrite(compress ? encodedVertices.data() : vertices.bytes.data(), 1, header.vertexBytes, out) == header.vertexBytes &&
+              fwrite(padding, 1, indexPad, out) == indexPad;
+    if (compress) {
+        ok = ok && fwrite(encodedIndices.data(), 1, header.indexBytes, out) == header.indexBytes;
+    }
+    // indices are narrowed through a fixed-size staging block rather than a full copy
+    static const size_t STAGING_INDICES = 64 * 1024;
+    std::vector<unsigned char> staging(compress ? 0 : STAGING_INDICES * header.indexSize);
+    for (size_t first = 0; ok && !compress && first < mesh.indices.size(); first += STAGING_INDICES) {
+        size_t count = std::min(STAGING_INDICES, mesh.indices.size() - first);
+        PackIndices(&mesh.indices[first], count, header.indexSize, staging.data());
+        ok = fwrite(staging.data(), header.indexSize, count, out) == count;
+    }
+    ok = ok && fwrite(padding, 1, meshletPad, out) == meshletPad &&
+              fwrite(mesh.meshlets.data(), 1, meshletBytes, out) == meshletBytes;
+    ok = (fclose(out) == 0) && ok;
+    if (!ok || rename(tempPath.c_str(), cachePath) != 0) {
+        remove(tempPath.c_str());
+        std::cout << "Failed to write mesh cache: " << cachePath << std::endl;
+        return false;
+    }
+    return true;
+}
+}
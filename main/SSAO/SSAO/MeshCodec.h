@@ -0,0 +1,403 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+// Lossless compression for the mesh cache streams (see MeshAsset.h).
+//
+// Vertices: every byte lane of the vertex (stride bytes) is delta-coded against the same
+// lane of the previous vertex and zigzagged, so small signed deltas become small bytes.
+// After OptimizeVertexFetch neighbouring vertices are neighbours on the surface, so the
+// quantized positions and packed normals change by a few units at a time. Blocks of
+// VERTEX_BLOCK vertices are stored lane by lane in groups of 16 bytes, each group packed
+// at 0, 2, 4 or 8 bits (a 2-bit mode per group). Decoding is fixed-size group unpacking
+// into a transposed scratch block plus a running sum across the lanes of a vertex; both
+// loops are branch-free over whole groups/vertices and vectorize well.
+//
+// Indices: triangle-topology aware. After Tipsify most triangles share an edge with one
+// of the last few triangles and introduce at most one vertex, which is usually the next
+// unused one (vertices are numbered by first use). Each triangle gets one code byte:
+// the high nibble names a recently seen edge (15 = none) and the low nibble codes the
+// remaining vertex as "next new vertex", a slot of a small FIFO of recent vertices, or an
+// explicit zigzag varint delta in a separate data stream. Triangles may come back rotated
+// (same winding, different first vertex); index ranges of LODs and meshlets are unchanged.
+namespace MeshCodec
+{
+const uint32_t VERTEX_BLOCK = 256;
+const uint32_t GROUP_SIZE = 16;
+const uint32_t MAX_STRIDE = 256;
+const uint32_t EDGE_FIFO = 16;   // ring size; the 15 most recent edges are addressable
+const uint32_t VERTEX_FIFO = 16; // ring size; the 14 most recent vertices are addressable
+const uint32_t CODE_NEXT = 0;
+const uint32_t CODE_EXPLICIT = 15;
+const uint32_t NO_EDGE = 15;
+
+inline uint8_t ZigZag8(uint8_t delta)
+{
+    return static_cast<uint8_t>((delta << 1) ^ (static_cast<int8_t>(delta) >> 7));
+}
+
+inline uint8_t UnZigZag8(uint8_t value)
+{
+    return static_cast<uint8_t>((value >> 1) ^ -(value & 1));
+}
+
+inline uint32_t ZigZag32(int32_t delta)
+{
+    return (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 31);
+}
+
+inline int32_t UnZigZag32(uint32_t value)
+{
+    return static_cast<int32_t>((value >> 1) ^ (0u - (value & 1)));
+}
+
+// Bits per value of a group: 0, 2, 4 or 8, stored as mode 0..3.
+inline uint32_t GroupMode(const uint8_t* group)
+{
+    uint8_t bits = 0;
+    for (uint32_t i = 0; i < GROUP_SIZE; i++) {
+        bits |= group[i];
+    }
+    return bits == 0 ? 0 : bits < 4 ? 1 : bits < 16 ? 2 : 3;
+}
+
+inline void EncodeGroup(const uint8_t* group, uint32_t mode, std::vector<unsigned char>& out)
+{
+    if (mode == 0) {
+        return;
+    }
+    if (mode == 3) {
+        out.insert(out.end(), group, group + GROUP_SIZE);
+        return;
+    }
+    uint32_t bits = mode * 2, perByte = 8 / bits;
+    for (uint32_t i = 0; i < GROUP_SIZE; i += perByte) {
+        uint8_t packed = 0;
+        for (uint32_t j = 0; j < perByte; j++) {
+            packed |= static_cast<uint8_t>(group[i + j] << (j * bits));
+        }
+        out.push_back(packed);
+    }
+}
+
+// Unpacks one group; returns the number of input bytes consumed.
+inline size_t DecodeGroup(const unsigned char* in, uint32_t mode, uint8_t* group)
+{
+    switch (mode) {
+        case 0:
+            memset(group, 0, GROUP_SIZE);
+            return 0;
+        case 1:
+            for (uint32_t i = 0; i < GROUP_SIZE; i++) {
+                group[i] = (in[i >> 2] >> ((i & 3) * 2)) & 3;
+            }
+            return GROUP_SIZE / 4;
+        case 2:
+            for (uint32_t i = 0; i < GROUP_SIZE; i++) {
+                group[i] = (in[i >> 1] >> ((i & 1) * 4)) & 15;
+            }
+            return GROUP_SIZE / 2;
+        default:
+            memcpy(group, in, GROUP_SIZE);
+            return GROUP_SIZE;
+    }
+}
+
+// Appends the encoded form of count vertices of stride bytes to out.
+inline void EncodeVertices(const unsigned char* vertices, size_t count, uint32_t stride, std::vector<unsigned char>& out)
+{
+    std::vector<uint8_t> previous(stride, 0);
+    uint8_t deltas[VERTEX_BLOCK];
+    for (size_t first = 0; first < count; first += VERTEX_BLOCK) {
+        uint32_t blockCount = static_cast<uint32_t>(std::min<size_t>(VERTEX_BLOCK, count - first));
+        uint32_t groups = (blockCount + GROUP_SIZE - 1) / GROUP_SIZE;
+        for (uint32_t k = 0; k < stride; k++) {
+            memset(deltas, 0, sizeof(deltas));
+            for (uint32_t i = 0; i < blockCount; i++) {
+                uint8_t value = vertices[(first + i) * stride + k];
+                deltas[i] = ZigZag8(static_cast<uint8_t>(value - previous[k]));
+                previous[k] = value;
+            }
+            size_t header = out.size();
+            out.resize(out.size() + (groups + 3) / 4, 0);
+            for (uint32_t g = 0; g < groups; g++) {
+                uint32_t mode = GroupMode(deltas + g * GROUP_SIZE);
+                out[header + g / 4] |= static_cast<uint8_t>(mode << ((g % 4) * 2));
+                EncodeGroup(deltas + g * GROUP_SIZE, mode, out);
+            }
+        }
+    }
+}
+
+// Adds the deltas of one block to the previous vertex, vertex by vertex. Instantiated for
+// the strides of both GPU layouts so the lane loop has a constant trip count.
+template <uint32_t Stride>
+inline void ReconstructBlock(const uint8_t* planes, uint32_t blockCount, uint8_t* previous, unsigned char* out)
+{
+    uint8_t vertex[Stride];
+    memcpy(vertex, previous, Stride);
+    for (uint32_t i = 0; i < blockCount; i++) {
+        for (uint32_t k = 0; k < Stride; k++) {
+            vertex[k] = static_cast<uint8_t>(vertex[k] + planes[k * VERTEX_BLOCK + i]);
+        }
+        memcpy(out + static_cast<size_t>(i) * Stride, vertex, Stride);
+    }
+    memcpy(previous, vertex, Stride);
+}
+
+inline void ReconstructBlock(const uint8_t* planes, uint32_t blockCount, uint32_t stride, uint8_t* previous, unsigned char* out)
+{
+    switch (stride) {
+        case 12: ReconstructBlock<12>(planes, blockCount, previous, out); return;
+        case 36: ReconstructBlock<36>(planes, blockCount, previous, out); return;
+    }
+    for (uint32_t i = 0; i < blockCount; i++) {
+        for (uint32_t k = 0; k < stride; k++) {
+            previous[k] = static_cast<uint8_t>(previous[k] + planes[static_cast<size_t>(k) * VERTEX_BLOCK + i]);
+        }
+        memcpy(out + static_cast<size_t>(i) * stride, previous, stride);
+    }
+}
+
+// Decodes count vertices into out (count * stride bytes). Fails on truncated or oversized input.
+inline bool DecodeVertices(const unsigned char* data, size_t size, size_t count, uint32_t stride, unsigned char* out)
+{
+    if (stride == 0 || stride > MAX_STRIDE) {
+        return false;
+    }
+    const unsigned char* p = data;
+    const unsigned char* end = data + size;
+    std::vector<uint8_t> planes(static_cast<size_t>(stride) * VERTEX_BLOCK);
+    std::vector<uint8_t> previous(stride, 0);
+    for (size_t first = 0; first < count; first += VERTEX_BLOCK) {
+        uint32_t blockCount = static_cast<uint32_t>(std::min<size_t>(VERTEX_BLOCK, count - first));
+        uint32_t groups = (blockCount + GROUP_SIZE - 1) / GROUP_SIZE;
+        for (uint32_t k = 0; k < stride; k++) {
+            const unsigned char* header = p;
+            p += (groups + 3) / 4;
+            if (p > end) {
+                return false;
+            }
+            uint8_t* plane = &planes[static_cast<size_t>(k) * VERTEX_BLOCK];
+            for (uint32_t g = 0; g < groups; g++) {
+                uint32_t mode = (header[g / 4] >> ((g % 4) * 2)) & 3;
+                if (static_cast<size_t>(end - p) < (mode == 0 ? 0 : GROUP_SIZE >> (3 - mode))) {
+                    return false;
+                }
+                p += DecodeGroup(p, mode, plane + g * GROUP_SIZE);
+            }
+            for (uint32_t i = 0; i < groups * GROUP_SIZE; i++) {
+                plane[i] = UnZigZag8(plane[i]);
+            }
+        }
+        ReconstructBlock(planes.data(), blockCount, stride, previous.data(), out + first * stride);
+    }
+    return p == end;
+}
+
+// Coder state shared by the index encoder and decoder; both must update it identically.
+struct IndexState
+{
+    uint32_t edges[EDGE_FIFO][2];
+    uint32_t vertices[VERTEX_FIFO];
+    uint32_t edgeHead = 0;
+    uint32_t vertexHead = 0;
+    uint32_t next = 0; // lowest vertex not referenced yet (in first-use order)
+    uint32_t last = 0; // previous explicit index, the base of the next delta
+
+    IndexState()
+    {
+        memset(edges, 0xFF, sizeof(edges));
+        memset(vertices, 0xFF, sizeof(vertices));
+    }
+    void PushEdge(uint32_t a, uint32_t b)
+    {
+        edges[edgeHead][0] = a;
+        edges[edgeHead][1] = b;
+        edgeHead = (edgeHead + 1) % EDGE_FIFO;
+    }
+    void PushVertex(uint32_t v)
+    {
+        vertices[vertexHead] = v;
+        vertexHead = (vertexHead + 1) % VERTEX_FIFO;
+    }
+    // age 0 is the most recent entry
+    const uint32_t* Edge(uint32_t age) const
+    {
+        return edges[(edgeHead + EDGE_FIFO - 1 - age) % EDGE_FIFO];
+    }
+    uint32_t Vertex(uint32_t age) const
+    {
+        return vertices[(vertexHead + VERTEX_FIFO - 1 - age) % VERTEX_FIFO];
+    }
+    // Adjacent triangles walk a shared edge in the opposite direction, so the reversed
+    // edges of each triangle are what later triangles look up.
+    void PushTriangle(uint32_t a, uint32_t b, uint32_t c, bool edgeHit)
+    {
+        if (!edgeHit) {
+            PushEdge(b, a);
+        }
+        PushEdge(c, b);
+        PushEdge(a, c);
+    }
+};
+
+inline void WriteVarint(uint32_t value, std::vector<unsigned char>& out)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<unsigned char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+inline bool ReadVarint(const unsigned char*& p, const unsigned char* end, uint32_t& value)
+{
+    value = 0;
+    for (uint32_t shift = 0; shift < 35; shift += 7) {
+        if (p >= end) {
+            return false;
+        }
+        unsigned char byte = *p++;
+        value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+        if (byte < 0x80) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline uint32_t EncodeIndex(IndexState& state, uint32_t v, std::vector<unsigned char>& data)
+{
+    if (v == state.next) {
+        state.next++;
+        state.PushVertex(v);
+        return CODE_NEXT;
+    }
+    for (uint32_t age = 0; age < CODE_EXPLICIT - 1; age++) {
+        if (state.Vertex(age) == v) {
+            return 1 + age;
+        }
+    }
+    WriteVarint(ZigZag32(static_cast<int32_t>(v - state.last)), data);
+    state.last = v;
+    state.next = std::max(state.next, v + 1);
+    state.PushVertex(v);
+    return CODE_EXPLICIT;
+}
+
+inline bool DecodeIndex(IndexState& state, uint32_t code, const unsigned char*& p, const unsigned char* end, uint32_t& v)
+{
+    if (code == CODE_NEXT) {
+        v = state.next++;
+        state.PushVertex(v);
+        return true;
+    }
+    if (code != CODE_EXPLICIT) {
+        v = state.Vertex(code - 1);
+        return true;
+    }
+    uint32_t zigzag;
+    if (!ReadVarint(p, end, zigzag)) {
+        return false;
+    }
+    v = state.last + static_cast<uint32_t>(UnZigZag32(zigzag));
+    state.last = v;
+    state.next = std::max(state.next, v + 1);
+    state.PushVertex(v);
+    return true;
+}
+
+// Encodes a triangle list (count a multiple of 3) as one code byte per triangle followed
+// by the explicit data stream.
+inline void EncodeIndices(const uint32_t* indices, size_t count, std::vector<unsigned char>& out)
+{
+    size_t triangles = count / 3;
+    std::vector<unsigned char> codes(triangles), data;
+    IndexState state;
+    for (size_t t = 0; t < triangles; t++) {
+        uint32_t tri[3] = { indices[t * 3], indices[t * 3 + 1], indices[t * 3 + 2] };
+        uint32_t edge = NO_EDGE, rotation = 0;
+        for (uint32_t age = 0; age < NO_EDGE && edge == NO_EDGE; age++) {
+            const uint32_t* e = state.Edge(age);
+            for (uint32_t r = 0; r < 3; r++) {
+                if (tri[r] == e[0] && tri[(r + 1) % 3] == e[1]) {
+                    edge = age;
+                    rotation = r;
+                    break;
+                }
+            }
+        }
+        if (edge != NO_EDGE) {
+            uint32_t a = tri[rotation], b = tri[(rotation + 1) % 3], c = tri[(rotation + 2) % 3];
+            codes[t] = static_cast<unsigned char>((edge << 4) | EncodeIndex(state, c, data));
+            state.PushTriangle(a, b, c, true);
+            continue;
+        }
+        // no shared edge: a's code shares the code byte, b's and c's get a data byte
+        // that precedes their explicit values
+        codes[t] = static_cast<unsigned char>((NO_EDGE << 4) | EncodeIndex(state, tri[0], data));
+        size_t slot = data.size();
+        data.push_back(0);
+        uint32_t codeB = EncodeIndex(state, tri[1], data);
+        uint32_t codeC = EncodeIndex(state, tri[2], data);
+        data[slot] = static_cast<unsigned char>(codeB | (codeC << 4));
+        state.PushTriangle(tri[0], tri[1], tri[2], false);
+    }
+    out.insert(out.end(), codes.begin(), codes.end());
+    out.insert(out.end(), data.begin(), data.end());
+}
+
+// Decodes count indices into out as Index (uint16_t or uint32_t). Rejects truncated input
+// and indices at or beyond vertexCount, so a corrupt file can never index past the buffer.
+template <typename Index>
+inline bool DecodeIndices(const unsigned char* encoded, size_t size, size_t count, uint32_t vertexCount, Index* out)
+{
+    size_t triangles = count / 3;
+    if (count % 3 != 0 || size < triangles) {
+        return false;
+    }
+    const unsigned char* codes = encoded;
+    const unsigned char* p = encoded + triangles;
+    const unsigned char* end = encoded + size;
+    IndexState state;
+    for (size_t t = 0; t < triangles; t++) {
+        uint32_t edge = codes[t] >> 4, a, b, c;
+        if (edge != NO_EDGE) {
+            const uint32_t* e = state.Edge(edge);
+            a = e[0];
+            b = e[1];
+            if (!DecodeIndex(state, codes[t] & 15, p, end, c)) {
+                return false;
+            }
+        } else {
+            if (!DecodeIndex(state, codes[t] & 15, p, end, a) || p >= end) {
+                return false;
+            }
+            uint32_t more = *p++;
+            if (!DecodeIndex(state, more & 15, p, end, b) || !DecodeIndex(state, more >> 4, p, end, c)) {
+                return false;
+            }
+        }
+        if (a >= vertexCount || b >= vertexCount || c >= vertexCount) {
+            return false;
+        }
+        out[t * 3] = static_cast<Index>(a);
+        out[t * 3 + 1] = static_cast<Index>(b);
+        out[t * 3 + 2] = static_cast<Index>(c);
+        state.PushTriangle(a, b, c, edge != NO_EDGE);
+    }
+    return p == end;
+}
+
+// Decodes into 2- or 4-byte indices, the widths the mesh cache stores.
+inline bool DecodeIndices(const unsigned char* encoded, size_t size, size_t count, uint32_t vertexCount, uint32_t indexSize, void* out)
+{
+    if (indexSize == 2) {
+        return DecodeIndices(encoded, size, count, vertexCount, static_cast<uint16_t*>(out));
+    }
+    return indexSize == 4 && DecodeIndices(encoded, size, count, vertexCount, static_cast<uint32_t*>(out));
+}
+}
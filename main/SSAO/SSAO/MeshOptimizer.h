@@ -0,0 +1,378 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <iostream>
+#include "glm/glm.hpp"
+#include "Mesh.h"
+
+// Load-time triangle and vertex reordering for indexed meshes, after Sander et al.,
+// "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (Tipsify):
+//  1. OptimizeVertexCache: Tipsify ordering for the post-transform vertex cache
+//  2. OptimizeOverdraw:    re-sorts Tipsify's clusters front-to-back, view independently
+//  3. OptimizeVertexFetch: renumbers vertices by first use so fetches walk memory forward
+// Analyze measures ACMR/ATVR with a FIFO cache model and overdraw with a tiny CPU rasterizer,
+// so the effect of every step can be checked without a GPU.
+namespace MeshOptimizer
+{
+const uint32_t CACHE_SIZE = 16;
+const float OVERDRAW_THRESHOLD = 1.05f; // allowed ACMR increase when splitting clusters
+const uint32_t MIN_CLUSTER_TRIANGLES = 256; // smaller clusters cost more cache misses than they save overdraw
+
+struct Stats
+{
+    float acmr = 0.0f;     // vertex shader invocations per triangle
+    float atvr = 0.0f;     // vertex shader invocations per unique vertex (1.0 is optimal)
+    float overdraw = 0.0f; // depth-test passes per covered pixel
+};
+
+// FIFO post-transform cache model, stamp-based so lookups are O(1).
+class CacheSim{
+public:
+    explicit CacheSim(uint32_t vertexCount) : stamps(vertexCount, 0) {}
+    // returns true on a miss
+    bool Access(uint32_t v){
+        if (time - stamps[v] < CACHE_SIZE && stamps[v] != 0){
+            return false;
+        }
+        stamps[v] = ++time;
+        return true;
+    }
+    // Empties the cache without touching the stamps: every stamp is now too old to hit.
+    void Reset(){
+        if (time > UINT32_MAX / 2){
+            std::fill(stamps.begin(), stamps.end(), 0u);
+            time = 0;
+        }
+        time += CACHE_SIZE;
+    }
+private:
+    std::vector<uint32_t> stamps;
+    uint32_t time = 0;
+};
+
+inline glm::vec3 Position(const Mesh& mesh, uint32_t v)
+{
+    const float* p = &mesh.vertices[static_cast<size_t>(v) * mesh.floatsPerVertex];
+    return glm::vec3(p[0], p[1], p[2]);
+}
+
+// Starts from an empty cache; pass a CacheSim to reuse its stamps across calls.
+inline uint32_t CountMisses(const uint32_t* indices, size_t count, CacheSim& cache)
+{
+    cache.Reset();
+    uint32_t misses = 0;
+    for (size_t i = 0; i < count; i++) {
+        misses += cache.Access(indices[i]);
+    }
+    return misses;
+}
+
+inline uint32_t CountMisses(const uint32_t* indices, size_t count, uint32_t vertexCount)
+{
+    CacheSim cache(vertexCount);
+    return CountMisses(indices, count, cache);
+}
+
+// Average depth complexity over six axis-aligned orthographic views, rasterized in index order
+// at the given resolution with a LESS depth test and no culling (as in the geometry pass).
+inline float MeasureOverdraw(const Mesh& mesh, int resolution = 256)
+{
+    uint32_t vertexCount = mesh.VertexCount();
+    if (vertexCount == 0 || mesh.indices.empty()) {
+        return 0.0f;
+    }
+    glm::vec3 lo = Position(mesh, 0), hi = lo;
+    for (uint32_t v = 1; v < vertexCount; v++) {
+        lo = glm::min(lo, Position(mesh, v));
+        hi = glm::max(hi, Position(mesh, v));
+    }
+    glm::vec3 extent = glm::max(hi - lo, glm::vec3(1e-6f));
+
+    uint64_t shaded = 0, covered = 0;
+    std::vector<float> depth(static_cast<size_t>(resolution) * resolution);
+    for (int view = 0; view < 6; view++) {
+        int axis = view % 3, uAxis = (axis + 1) % 3, vAxis = (axis + 2) % 3;
+        float sign = view < 3 ? 1.0f : -1.0f;
+        float scale = (resolution - 1) / std::max(extent[uAxis], extent[vAxis]);
+        std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::max());
+        for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+            glm::vec3 s[3];
+            for (int k = 0; k < 3; k++) {
+                glm::vec3 p = Position(mesh, mesh.indices[t + k]) - lo;
+                s[k] = glm::vec3(p[uAxis] * scale, p[vAxis] * scale, sign * p[axis]);
+            }
+            float area = (s[1].x - s[0].x) * (s[2].y - s[0].y) - (s[1].y - s[0].y) * (s[2].x - s[0].x);
+            if (area == 0.0f) {
+                continue;
+            }
+            if (area < 0.0f) {
+                std::swap(s[1], s[2]);
+                area = -area;
+            }
+            int x0 = std::max(0, static_cast<int>(std::ceil(std::min({ s[0].x, s[1].x, s[2].x }) - 0.5f)));
+            int x1 = std::min(resolution - 1, static_cast<int>(std::floor(std::max({ s[0].x, s[1].x, s[2].x }) - 0.5f)));
+            int y0 = std::max(0, static_cast<int>(std::ceil(std::min({ s[0].y, s[1].y, s[2].y }) - 0.5f)));
+            int y1 = std::min(resolution - 1, static_cast<int>(std::floor(std::max({ s[0].y, s[1].y, s[2].y }) - 0.5f)));
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    float px = x + 0.5f, py = y + 0.5f;
+                    float w0 = (s[2].x - s[1].x) * (py - s[1].y) - (s[2].y - s[1].y) * (px - s[1].x);
+                    float w1 = (s[0].x - s[2].x) * (py - s[2].y) - (s[0].y - s[2].y) * (px - s[2].x);
+                    float w2 = area - w0 - w1;
+                    if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) {
+                        continue;
+                    }
+                    float z = (w0 * s[0].z + w1 * s[1].z + w2 * s[2].z) / area;
+                    float& d = depth[static_cast<size_t>(y) * resolution + x];
+                    if (z < d) {
+                        d = z;
+                        shaded++;
+                    }
+                }
+            }
+        }
+        for (float d : depth) {
+            covered += d != std::numeric_limits<float>::max();
+        }
+    }
+    return covered ? static_cast<float>(shaded) / covered : 0.0f;
+}
+
+inline Stats Analyze(const Mesh& mesh, bool overdraw = true)
+{
+    Stats stats;
+    size_t triangles = mesh.indices.size() / 3;
+    if (triangles == 0) {
+        return stats;
+    }
+    uint32_t misses = CountMisses(mesh.indices.data(), mesh.indices.size(), mesh.VertexCount());
+    stats.acmr = static_cast<float>(misses) / triangles;
+    stats.atvr = static_cast<float>(misses) / mesh.VertexCount();
+    stats.overdraw = overdraw ? MeasureOverdraw(mesh) : 0.0f;
+    return stats;
+}
+
+// Tipsify. Reorders triangles in place; when clusters is non-null it receives the index
+// offsets where the walk had to restart from a dead end (hard cluster boundaries).
+inline void OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<uint32_t>* clusters = nullptr)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // vertex -> triangle adjacency (CSR)
+    std::vector<uint32_t> live(vertexCount, 0);
+    for (uint32_t v : indices) {
+        live[v]++;
+    }
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        offsets[v + 1] = offsets[v] + live[v];
+    }
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    std::vector<char> emitted(triangleCount, 0);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    uint32_t time = CACHE_SIZE + 1;
+    uint32_t cursor = 0;
+    int64_t fanning = 0;
+    while (fanning < vertexCount && live[fanning] == 0) {
+        fanning++;
+    }
+    if (clusters) {
+        clusters->assign(1, 0);
+    }
+
+    while (fanning >= 0 && fanning < vertexCount) {
+        candidates.clear();
+        for (uint32_t a = offsets[fanning]; a < offsets[fanning + 1]; a++) {
+            uint32_t t = adjacency[a];
+            if (emitted[t]) {
+                continue;
+            }
+            for (int k = 0; k < 3; k++) {
+                uint32_t v = indices[t * 3 + k];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+                if (time - cacheTime[v] > CACHE_SIZE) {
+                    cacheTime[v] = time++;
+                }
+            }
+            emitted[t] = 1;
+        }
+
+        // next fanning vertex: the candidate that will still be cached after its own fan
+        int64_t best = -1;
+        int bestPriority = -1;
+        for (uint32_t v : candidates) {
+            if (live[v] == 0) {
+                continue;
+            }
+            int priority = 0;
+            if (time - cacheTime[v] + 2 * live[v] <= CACHE_SIZE) {
+                priority = static_cast<int>(time - cacheTime[v]);
+            }
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                best = v;
+            }
+        }
+        if (best < 0) {
+            // dead end: fall back to recently emitted vertices, then to a linear scan
+            while (!deadEnd.empty() && best < 0) {
+                uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[v] > 0) {
+                    best = v;
+                }
+            }
+            while (best < 0 && cursor < vertexCount) {
+                if (live[cursor] > 0) {
+                    best = cursor;
+                }
+                cursor++;
+            }
+            if (clusters && best >= 0 && output.size() != clusters->back()) {
+                clusters->push_back(static_cast<uint32_t>(output.size()));
+            }
+        }
+        fanning = best;
+    }
+    indices.swap(output);
+}
+
+// Splits the hard clusters further wherever the cache efficiency of the prefix is already
+// close to that of the whole cluster, then orders clusters by occlusion potential: clusters
+// facing away from the mesh center are drawn first, so they occlude the ones behind them
+// from most viewpoints.
+inline void OptimizeOverdraw(Mesh& mesh, const std::vector<uint32_t>& hardClusters, float threshold = OVERDRAW_THRESHOLD)
+{
+    std::vector<uint32_t>& indices = mesh.indices;
+    if (indices.empty() || hardClusters.empty()) {
+        return;
+    }
+    uint32_t vertexCount = mesh.VertexCount();
+
+    std::vector<uint32_t> clusters;
+    CacheSim cache(vertexCount); // reset per cluster, so splitting stays linear in the mesh
+    for (size_t c = 0; c < hardClusters.size(); c++) {
+        uint32_t begin = hardClusters[c];
+        uint32_t end = c + 1 < hardClusters.size() ? hardClusters[c + 1] : static_cast<uint32_t>(indices.size());
+        float clusterAcmr = static_cast<float>(CountMisses(&indices[begin], end - begin, cache)) / ((end - begin) / 3);
+        cache.Reset();
+        uint32_t start = begin, misses = 0;
+        clusters.push_back(begin);
+        for (uint32_t i = begin; i < end; i += 3) {
+            for (int k = 0; k < 3; k++) {
+                misses += cache.Access(indices[i + k]);
+            }
+            uint32_t triangles = (i + 3 - start) / 3;
+            if (i + 3 < end && static_cast<float>(misses) / triangles <= threshold * clusterAcmr && triangles >= MIN_CLUSTER_TRIANGLES) {
+                start = i + 3;
+                misses = 0;
+                clusters.push_back(start);
+            }
+        }
+    }
+
+    glm::dvec3 meshCenter(0.0);
+    double meshArea = 0.0;
+    struct Cluster { uint32_t begin, end; double sortKey; };
+    std::vector<Cluster> order(clusters.size());
+    std::vector<glm::dvec3> centers(clusters.size()), normals(clusters.size());
+    std::vector<double> areas(clusters.size());
+    for (size_t c = 0; c < clusters.size(); c++) {
+        order[c].begin = clusters[c];
+        order[c].end = c + 1 < clusters.size() ? clusters[c + 1] : static_cast<uint32_t>(indices.size());
+        glm::dvec3 center(0.0), normal(0.0);
+        double area = 0.0;
+        for (uint32_t i = order[c].begin; i < order[c].end; i += 3) {
+            glm::dvec3 a = Position(mesh, indices[i]), b = Position(mesh, indices[i + 1]), d = Position(mesh, indices[i + 2]);
+            glm::dvec3 n = glm::cross(b - a, d - a);
+            double triangleArea = glm::length(n) * 0.5;
+            center += (a + b + d) * (triangleArea / 3.0);
+            normal += n;
+            area += triangleArea;
+        }
+        centers[c] = center;
+        normals[c] = normal;
+        areas[c] = area;
+        meshCenter += center;
+        meshArea += area;
+    }
+    meshCenter = meshArea > 0.0 ? meshCenter / meshArea : meshCenter;
+    for (size_t c = 0; c < clusters.size(); c++) {
+        glm::dvec3 center = areas[c] > 0.0 ? centers[c] / areas[c] : meshCenter;
+        double length = glm::length(normals[c]);
+        order[c].sortKey = length > 0.0 ? glm::dot(center - meshCenter, normals[c] / length) : 0.0;
+    }
+    std::stable_sort(order.begin(), order.end(), [](const Cluster& a, const Cluster& b) {
+        return a.sortKey > b.sortKey;
+    });
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(indices.size());
+    for (const Cluster& c : order) {
+        sorted.insert(sorted.end(), indices.begin() + c.begin, indices.begin() + c.end);
+    }
+    indices.swap(sorted);
+}
+
+// Renumbers vertices in order of first use and drops unreferenced ones.
+inline void OptimizeVertexFetch(Mesh& mesh)
+{
+    const uint32_t unused = 0xFFFFFFFFu;
+    uint32_t stride = mesh.floatsPerVertex;
+    std::vector<uint32_t> remap(mesh.VertexCount(), unused);
+    std::vector<float> vertices;
+    vertices.reserve(mesh.vertices.size());
+    uint32_t next = 0;
+    for (uint32_t& index : mesh.indices) {
+        if (remap[index] == unused) {
+            remap[index] = next++;
+            const float* v = &mesh.vertices[static_cast<size_t>(index) * stride];
+            vertices.insert(vertices.end(), v, v + stride);
+        }
+        index = remap[index];
+    }
+    mesh.vertices.swap(vertices);
+}
+
+inline void PrintStats(const char* label, const Stats& stats)
+{
+    std::cout << "  " << label << ": ACMR " << stats.acmr << ", ATVR " << stats.atvr
+              << ", overdraw " << stats.overdraw << std::endl;
+}
+
+// Runs all three passes and logs the metrics before and after.
+inline void Optimize(Mesh& mesh, bool report = true)
+{
+    if (report) {
+        std::cout << "Mesh optimization (" << CACHE_SIZE << "-entry FIFO, 6 views):" << std::endl;
+        PrintStats("before", Analyze(mesh));
+    }
+    std::vector<uint32_t> clusters;
+    OptimizeVertexCache(mesh.indices, mesh.VertexCount(), &clusters);
+    if (report) {
+        PrintStats("cache ", Analyze(mesh));
+    }
+    OptimizeOverdraw(mesh, clusters);
+    OptimizeVertexFetch(mesh);
+    if (report) {
+        PrintStats("after ", Analyze(mesh));
+    }
+}
+}
@@ -0,0 +1,191 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <strings.h>
+#include "glm/glm.hpp"
+#include "Mesh.h"
+#include "VertexFormat.h"
+#include "ObjParser.h"
+#include "PlyParser.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+#include "MeshAsset.h"
+#include "ClusterHierarchy.h"
+
+// Source mesh -> renderable asset: load (OBJ/PLY), weld, optimize, build LODs and meshlets,
+// quantize and write the mesh cache. GL-free and shared by the renderer, which runs it on
+// its loader thread on a cache miss, and the offline MeshCompiler, which runs it ahead of
+// time so the renderer only ever maps the finished cache.
+namespace MeshPipeline
+{
+struct Options
+{
+    std::vector<float> lodRatios = { 0.5f, 0.25f, 0.125f, 0.0625f, 0.03125f };
+    VertexFormat format = VertexFormat::Compact;
+    unsigned threads = 0;  // parser threads, 0 = automatic
+    bool twoPass = false;  // low-peak-memory OBJ parse
+    bool compress = false; // write the cache through MeshCodec
+    bool report = true;    // print per-stage statistics
+    bool hierarchy = false; // write the out-of-core cluster hierarchy instead of the cache
+};
+
+inline bool HasExtension(const char* path, const char* extension)
+{
+    size_t length = strlen(path), extensionLength = strlen(extension);
+    return length >= extensionLength && strcasecmp(path + length - extensionLength, extension) == 0;
+}
+
+// Source extensions the pipeline can build from.
+inline bool IsSource(const char* path)
+{
+    return HasExtension(path, ".obj") || HasExtension(path, ".ply");
+}
+
+// Cache stamps include the settings that change the output, so changing them rebuilds.
+inline uint64_t SettingsHash(const Options& options)
+{
+    if (options.hierarchy) {
+        return MeshAsset::Hash(reinterpret_cast<const unsigned char*>(&ClusterHierarchy::LEAF_TRIANGLES), sizeof(uint32_t));
+    }
+    return MeshAsset::Hash(reinterpret_cast<const unsigned char*>(options.lodRatios.data()), options.lodRatios.size() * sizeof(float));
+}
+
+// OBJ loader: parses in parallel, then welds identical (position, normal) corners into
+// an indexed mesh with 9-float vertices
+inline bool LoadOBJ(const char* path, Mesh& outMesh, const Options& options)
+{
+    ObjParser::Result obj;
+    if (!ObjParser::Parse(path, obj, options.threads, options.twoPass)) {
+        return false;
+    }
+
+    size_t cornerCount = obj.positionIndices.size();
+    outMesh = Mesh();
+    outMesh.indices.resize(cornerCount);
+    VertexWelder welder(outMesh, std::max(obj.positions.size(), obj.normals.size()));
+    for (size_t i = 0; i < cornerCount; i++) {
+        glm::vec3 vertex = obj.positions[obj.positionIndices[i]];
+        glm::vec3 normal;
+        if (obj.normalIndices[i] >= 0) {
+            normal = obj.normals[obj.normalIndices[i]];
+        } else {
+            // no vn on this face: fall back to the flat face normal
+            size_t first = i - i % 3;
+            glm::vec3 a = obj.positions[obj.positionIndices[first]];
+            glm::vec3 b = obj.positions[obj.positionIndices[first + 1]];
+            glm::vec3 c = obj.positions[obj.positionIndices[first + 2]];
+            glm::vec3 n = glm::cross(b - a, c - a);
+            normal = glm::dot(n, n) > 0.0f ? glm::normalize(n) : glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+
+        // Position, color (white), normal
+        float v[9] = {
+            vertex.x, vertex.y, vertex.z,
+            0.9f, 0.9f, 0.9f,
+            normal.x, normal.y, normal.z
+        };
+        outMesh.indices[i] = welder.Insert(v);
+    }
+
+    if (options.report) {
+        std::cout << "Loaded " << path << ": " << cornerCount / 3 << " triangles, "
+                  << cornerCount << " corners welded to " << outMesh.VertexCount() << " vertices ("
+                  << (cornerCount * 9 * sizeof(float)) / 1024 << " KB -> "
+                  << (outMesh.vertices.size() * sizeof(float) + outMesh.indices.size() * outMesh.IndexSize()) / 1024
+                  << " KB with " << outMesh.IndexSize() * 8 << "-bit indices)" << std::endl;
+    }
+    return true;
+}
+
+// PLY loader: the file is already indexed, so vertices are decoded directly into the
+// 9-float layout; smooth normals are generated in parallel when the file has none
+inline bool LoadPLY(const char* path, Mesh& outMesh, const Options& options)
+{
+    const float color[3] = { 0.9f, 0.9f, 0.9f };
+    if (!PlyParser::Parse(path, outMesh, color, options.threads)) {
+        return false;
+    }
+    if (options.report) {
+        std::cout << "Loaded " << path << ": " << outMesh.IndexCount() / 3 << " triangles, "
+                  << outMesh.VertexCount() << " vertices" << std::endl;
+    }
+    return true;
+}
+
+inline bool Load(const char* path, Mesh& outMesh, const Options& options)
+{
+    bool ok = HasExtension(path, ".ply") ? LoadPLY(path, outMesh, options) : LoadOBJ(path, outMesh, options);
+    if (ok && outMesh.IndexCount() == 0) {
+        std::cout << path << " contains no triangles" << std::endl;
+        return false;
+    }
+    return ok;
+}
+
+// Cache reorder and overdraw sort, then the LOD chain and the meshlets of every LOD.
+inline void Process(Mesh& mesh, const Options& options)
+{
+    MeshOptimizer::Optimize(mesh, options.report);
+    if (options.report) {
+        std::cout << "Building LODs:" << std::endl;
+    }
+    MeshSimplifier::BuildLods(mesh, options.lodRatios, options.report);
+    Meshlets::Build(mesh);
+    if (options.report) {
+        Meshlets::ReportCulling(mesh);
+    }
+}
+
+// Full offline build of one source file into its mesh cache (MeshAsset::CachePath).
+inline bool Compile(const char* sourcePath, const Options& options)
+{
+    MeshAsset::SourceStamp stamp;
+    if (!MeshAsset::StampSource(sourcePath, stamp)) {
+        std::cout << "Failed to read " << sourcePath << std::endl;
+        return false;
+    }
+    stamp.settings = SettingsHash(options);
+    Mesh mesh;
+    if (!Load(sourcePath, mesh, options)) {
+        std::cout << "Failed to load " << sourcePath << std::endl;
+        return false;
+    }
+    Process(mesh, options);
+    VertexStream vertices;
+    EncodeVertices(mesh, options.format, vertices);
+    return MeshAsset::Write(MeshAsset::CachePath(sourcePath, options.format).c_str(), stamp, vertices, mesh, options.compress);
+}
+
+// Offline build of one source file into its cluster hierarchy (ClusterHierarchy::Path).
+// The whole source is loaded once here; only the renderer works out of core.
+inline bool CompileHierarchy(const char* sourcePath, const Options& options)
+{
+    MeshAsset::SourceStamp stamp;
+    if (!MeshAsset::StampSource(sourcePath, stamp)) {
+        std::cout << "Failed to read " << sourcePath << std::endl;
+        return false;
+    }
+    stamp.settings = SettingsHash(options);
+    Mesh mesh;
+    if (!Load(sourcePath, mesh, options)) {
+        std::cout << "Failed to load " << sourcePath << std::endl;
+        return false;
+    }
+    if (options.report) {
+        std::cout << "Building cluster hierarchy:" << std::endl;
+    }
+    std::vector<ClusterHierarchy::BuildNode> nodes;
+    ClusterHierarchy::Build(mesh, nodes, options.threads, options.report);
+    if (nodes[0].indices.size() / 3 > 4 * ClusterHierarchy::LEAF_TRIANGLES) {
+        // locked seams (e.g. flat-shaded faces that never weld) keep every level large
+        std::cout << "Warning: " << sourcePath << " only simplified to " << nodes[0].indices.size() / 3
+                  << " triangles at the root; the hierarchy will be much larger than the source" << std::endl;
+    }
+    return ClusterHierarchy::Write(ClusterHierarchy::Path(sourcePath).c_str(), stamp, mesh, nodes);
+}
+}
@@ -0,0 +1,269 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include "glm/glm.hpp"
+#include "Mesh.h"
+#include "MeshOptimizer.h"
+
+// Quadric-error edge-collapse simplification (Garland & Heckbert) for LOD generation.
+// Collapses are half-edge collapses onto an existing vertex, so every LOD is just another
+// index range into the base mesh's vertex buffer. Border, non-manifold and seam vertices
+// (several vertices sharing one position) are never moved, which keeps silhouettes and
+// normal discontinuities intact. Collapses run in passes: each pass sorts all candidate
+// edges by error and applies the cheapest non-conflicting ones that do not flip a triangle.
+namespace MeshSimplifier
+{
+// symmetric 4x4 quadric, stored as the upper triangle, plus the accumulated plane weight
+struct Quadric
+{
+    double a00 = 0, a01 = 0, a02 = 0, a03 = 0, a11 = 0, a12 = 0, a13 = 0, a22 = 0, a23 = 0, a33 = 0;
+    double weight = 0;
+
+    void AddPlane(glm::dvec3 n, double d, double w)
+    {
+        a00 += w * n.x * n.x; a01 += w * n.x * n.y; a02 += w * n.x * n.z; a03 += w * n.x * d;
+        a11 += w * n.y * n.y; a12 += w * n.y * n.z; a13 += w * n.y * d;
+        a22 += w * n.z * n.z; a23 += w * n.z * d;
+        a33 += w * d * d;
+        weight += w;
+    }
+    void Add(const Quadric& q)
+    {
+        a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+        a11 += q.a11; a12 += q.a12; a13 += q.a13;
+        a22 += q.a22; a23 += q.a23; a33 += q.a33;
+        weight += q.weight;
+    }
+    // weighted sum of squared distances to the accumulated planes
+    double Evaluate(glm::dvec3 p) const
+    {
+        double e = a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z + a33
+                 + 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+                 + 2.0 * (a03 * p.x + a13 * p.y + a23 * p.z);
+        return std::max(e, 0.0);
+    }
+};
+
+struct Collapse
+{
+    uint32_t from, to;
+    double cost;
+};
+
+inline uint64_t EdgeKey(uint32_t a, uint32_t b)
+{
+    return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+}
+
+// Marks vertices that must not be collapsed away.
+inline std::vector<char> FindLockedVertices(const Mesh& mesh, const uint32_t* indices, size_t indexCount)
+{
+    uint32_t vertexCount = mesh.VertexCount();
+    std::vector<char> locked(vertexCount, 0);
+
+    // seams: several vertices at one position (sorted by position, equal neighbours lock each other)
+    std::vector<uint32_t> byPosition(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        byPosition[v] = v;
+    }
+    auto less = [&](uint32_t a, uint32_t b) {
+        glm::vec3 pa = MeshOptimizer::Position(mesh, a), pb = MeshOptimizer::Position(mesh, b);
+        return pa.x != pb.x ? pa.x < pb.x : pa.y != pb.y ? pa.y < pb.y : pa.z < pb.z;
+    };
+    std::sort(byPosition.begin(), byPosition.end(), less);
+    for (uint32_t i = 1; i < vertexCount; i++) {
+        if (!less(byPosition[i - 1], byPosition[i])) {
+            locked[byPosition[i - 1]] = locked[byPosition[i]] = 1;
+        }
+    }
+
+    // borders and non-manifold edges: any edge not shared by exactly two triangles
+    std::vector<uint64_t> edges;
+    edges.reserve(indexCount);
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+        for (int k = 0; k < 3; k++) {
+            edges.push_back(EdgeKey(indices[i + k], indices[i + (k + 1) % 3]));
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < edges.size();) {
+        size_t j = i;
+        while (j < edges.size() && edges[j] == edges[i]) {
+            j++;
+        }
+        if (j - i != 2) {
+            locked[edges[i] >> 32] = locked[edges[i] & 0xFFFFFFFFu] = 1;
+        }
+        i = j;
+    }
+    return locked;
+}
+
+// Simplifies the triangle list in indices towards targetIndexCount. Returns the geometric
+// error of the result in object-space units (RMS distance to the original planes of the
+// worst collapse performed).
+inline float Simplify(const Mesh& mesh, const uint32_t* indices, size_t indexCount, size_t targetIndexCount,
+                      std::vector<uint32_t>& out)
+{
+    uint32_t vertexCount = mesh.VertexCount();
+    out.assign(indices, indices + indexCount);
+    if (indexCount <= targetIndexCount) {
+        return 0.0f;
+    }
+
+    std::vector<glm::dvec3> positions(vertexCount);
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        positions[v] = glm::dvec3(MeshOptimizer::Position(mesh, v));
+    }
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i + 2 < indexCount; i += 3) {
+        glm::dvec3 a = positions[indices[i]], b = positions[indices[i + 1]], c = positions[indices[i + 2]];
+        glm::dvec3 n = glm::cross(b - a, c - a);
+        double length = glm::length(n);
+        if (length <= 0.0) {
+            continue;
+        }
+        n /= length;
+        for (int k = 0; k < 3; k++) {
+            quadrics[indices[i + k]].AddPlane(n, -glm::dot(n, a), length * 0.5);
+        }
+    }
+    std::vector<char> locked = FindLockedVertices(mesh, indices, indexCount);
+
+    std::vector<Collapse> collapses;
+    std::vector<uint32_t> remap(vertexCount), offsets(vertexCount + 1), adjacency, fill;
+    std::vector<char> touched(vertexCount);
+    double maxError = 0.0;
+
+    while (out.size() > targetIndexCount) {
+        // vertex -> triangle adjacency for the current triangles
+        std::fill(offsets.begin(), offsets.end(), 0);
+        for (uint32_t v : out) {
+            offsets[v + 1]++;
+        }
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            offsets[v + 1] += offsets[v];
+        }
+        adjacency.resize(out.size());
+        fill.assign(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < out.size(); i++) {
+            adjacency[fill[out[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        collapses.clear();
+        for (size_t i = 0; i < out.size(); i += 3) {
+            for (int k = 0; k < 3; k++) {
+                uint32_t a = out[i + k], b = out[i + (k + 1) % 3];
+                for (int dir = 0; dir < 2; dir++) {
+                    if (!locked[a]) {
+                        Quadric q = quadrics[a];
+                        q.Add(quadrics[b]);
+                        collapses.push_back({ a, b, q.Evaluate(positions[b]) / std::max(q.weight, 1e-30) });
+                    }
+                    std::swap(a, b);
+                }
+            }
+        }
+        if (collapses.empty()) {
+            break;
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) {
+            return x.cost < y.cost;
+        });
+
+        for (uint32_t v = 0; v < vertexCount; v++) {
+            remap[v] = v;
+        }
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t removeGoal = (out.size() - targetIndexCount) / 3;
+        size_t removed = 0;
+        for (const Collapse& c : collapses) {
+            if (removed >= removeGoal) {
+                break;
+            }
+            if (touched[c.from] || touched[c.to]) {
+                continue;
+            }
+            // reject collapses that flip any surviving triangle around 'from'
+            bool flips = false;
+            size_t dying = 0;
+            for (uint32_t a = offsets[c.from]; a < offsets[c.from + 1] && !flips; a++) {
+                const uint32_t* t = &out[static_cast<size_t>(adjacency[a]) * 3];
+                if (t[0] == c.to || t[1] == c.to || t[2] == c.to) {
+                    dying++;
+                    continue;
+                }
+                glm::dvec3 p[3], q[3];
+                for (int k = 0; k < 3; k++) {
+                    p[k] = positions[t[k]];
+                    q[k] = t[k] == c.from ? positions[c.to] : p[k];
+                }
+                glm::dvec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::dvec3 after = glm::cross(q[1] - q[0], q[2] - q[0]);
+                flips = glm::dot(before, after) <= 0.0;
+            }
+            if (flips) {
+                continue;
+            }
+            // one collapse per neighbourhood per pass keeps the flip checks valid
+            for (uint32_t a = offsets[c.from]; a < offsets[c.from + 1]; a++) {
+                const uint32_t* t = &out[static_cast<size_t>(adjacency[a]) * 3];
+                touched[t[0]] = touched[t[1]] = touched[t[2]] = 1;
+            }
+            remap[c.from] = c.to;
+            quadrics[c.to].Add(quadrics[c.from]);
+            maxError = std::max(maxError, c.cost);
+            removed += dying;
+        }
+        if (removed == 0) {
+            break;
+        }
+
+        size_t write = 0;
+        for (size_t i = 0; i < out.size(); i += 3) {
+            uint32_t a = remap[out[i]], b = remap[out[i + 1]], c = remap[out[i + 2]];
+            if (a != b && b != c && a != c) {
+                out[write++] = a;
+                out[write++] = b;
+                out[write++] = c;
+            }
+        }
+        out.resize(write);
+    }
+    return static_cast<float>(std::sqrt(maxError));
+}
+
+// Appends one simplified index range per ratio (relative to the base triangle count) and
+// fills mesh.lods; LOD 0 is the existing index buffer. Each LOD simplifies the previous one
+// and is reordered for the vertex cache. Stops early when a level cannot be reduced further.
+inline void BuildLods(Mesh& mesh, const std::vector<float>& ratios, bool report = true)
+{
+    uint32_t baseCount = mesh.IndexCount();
+    mesh.lods.clear();
+    mesh.lods.push_back({ 0, baseCount, 0.0f, 0 });
+    std::vector<uint32_t> previous(mesh.indices.begin(), mesh.indices.end()), lod;
+    for (float ratio : ratios) {
+        if (mesh.lods.size() >= MAX_LODS) {
+            break;
+        }
+        size_t target = static_cast<size_t>(baseCount / 3 * ratio) * 3;
+        float error = Simplify(mesh, previous.data(), previous.size(), target, lod);
+        if (lod.size() >= previous.size() * 0.95 || lod.empty()) {
+            break;
+        }
+        MeshOptimizer::OptimizeVertexCache(lod, mesh.VertexCount());
+        // each level is measured against its parent, so errors add up along the chain
+        error += mesh.lods.back().error;
+        mesh.lods.push_back({ mesh.IndexCount(), static_cast<uint32_t>(lod.size()), error, 0 });
+        mesh.indices.insert(mesh.indices.end(), lod.begin(), lod.end());
+        previous.swap(lod);
+    }
+    for (size_t i = 0; report && i < mesh.lods.size(); i++) {
+        std::cout << "  LOD " << i << ": " << mesh.lods[i].indexCount / 3 << " triangles, error "
+                  << mesh.lods[i].error << std::endl;
+    }
+}
+}
@@ -0,0 +1,221 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "Mesh.h"
+#include "MeshOptimizer.h"
+
+// Meshlet partitioning and per-frame CPU cluster culling. Meshlets are cut greedily from the
+// cache-optimized triangle order of every LOD, so each one is a contiguous index range and
+// the survivors of culling can be drawn straight from the existing element buffer.
+namespace Meshlets
+{
+struct CullStats
+{
+    uint32_t total = 0;
+    uint32_t frustumCulled = 0;
+    uint32_t backfaceCulled = 0;
+};
+
+// One draw range (in indices) after culling; adjacent visible meshlets are merged.
+struct Range
+{
+    uint32_t indexOffset;
+    uint32_t indexCount;
+};
+
+inline Meshlet MakeMeshlet(const Mesh& mesh, uint32_t indexOffset, uint32_t indexCount)
+{
+    Meshlet m = {};
+    m.indexOffset = indexOffset;
+    m.indexCount = indexCount;
+
+    glm::vec3 lo(0.0f), hi(0.0f);
+    for (uint32_t i = 0; i < indexCount; i++) {
+        glm::vec3 p = MeshOptimizer::Position(mesh, mesh.indices[indexOffset + i]);
+        lo = i == 0 ? p : glm::min(lo, p);
+        hi = i == 0 ? p : glm::max(hi, p);
+    }
+    glm::vec3 center = (lo + hi) * 0.5f;
+    float radius = 0.0f;
+    glm::vec3 axis(0.0f);
+    std::vector<glm::vec3> normals;
+    normals.reserve(indexCount / 3);
+    for (uint32_t i = 0; i < indexCount; i += 3) {
+        glm::vec3 a = MeshOptimizer::Position(mesh, mesh.indices[indexOffset + i]);
+        glm::vec3 b = MeshOptimizer::Position(mesh, mesh.indices[indexOffset + i + 1]);
+        glm::vec3 c = MeshOptimizer::Position(mesh, mesh.indices[indexOffset + i + 2]);
+        radius = glm::max(radius, glm::max(glm::length(a - center), glm::max(glm::length(b - center), glm::length(c - center))));
+        glm::vec3 n = glm::cross(b - a, c - a);
+        float length = glm::length(n);
+        if (length > 0.0f) {
+            normals.push_back(n / length);
+            axis += n / length;
+        }
+    }
+    for (int k = 0; k < 3; k++) {
+        m.center[k] = center[k];
+    }
+    m.radius = radius;
+
+    // normal cone: if the normals spread too far the cluster can never be fully backfacing
+    float axisLength = glm::length(axis);
+    m.coneCutoff = 1.0f;
+    if (axisLength > 0.0f && !normals.empty()) {
+        axis /= axisLength;
+        float minDot = 1.0f;
+        for (const glm::vec3& n : normals) {
+            minDot = glm::min(minDot, glm::dot(axis, n));
+        }
+        if (minDot > 0.1f) {
+            m.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+        }
+    }
+    for (int k = 0; k < 3; k++) {
+        m.coneAxis[k] = axisLength > 0.0f ? axis[k] : 0.0f;
+    }
+    return m;
+}
+
+// Greedily cuts [indexOffset, indexOffset + indexCount) into meshlets in triangle order.
+inline void BuildRange(const Mesh& mesh, uint32_t indexOffset, uint32_t indexCount, std::vector<Meshlet>& out)
+{
+    std::vector<uint32_t> used;
+    used.reserve(MESHLET_MAX_VERTICES);
+    uint32_t start = indexOffset, end = indexOffset + indexCount;
+    for (uint32_t i = indexOffset; i < end; i += 3) {
+        uint32_t added = 0;
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = mesh.indices[i + k];
+            bool seen = std::find(used.begin(), used.end(), v) != used.end();
+            for (int j = 0; j < k && !seen; j++) {
+                seen = mesh.indices[i + j] == v;
+            }
+            added += !seen;
+        }
+        if (used.size() + added > MESHLET_MAX_VERTICES || (i - start) / 3 >= MESHLET_MAX_TRIANGLES) {
+            out.push_back(MakeMeshlet(mesh, start, i - start));
+            start = i;
+            used.clear();
+        }
+        for (int k = 0; k < 3; k++) {
+            if (std::find(used.begin(), used.end(), mesh.indices[i + k]) == used.end()) {
+                used.push_back(mesh.indices[i + k]);
+            }
+        }
+    }
+    if (end > start) {
+        out.push_back(MakeMeshlet(mesh, start, end - start));
+    }
+}
+
+// Builds meshlets for every LOD (or the whole index buffer if there are no LODs).
+inline void Build(Mesh& mesh)
+{
+    mesh.meshlets.clear();
+    if (mesh.lods.empty()) {
+        BuildRange(mesh, 0, mesh.IndexCount(), mesh.meshlets);
+    }
+    for (const MeshLod& lod : mesh.lods) {
+        BuildRange(mesh, lod.indexOffset, lod.indexCount, mesh.meshlets);
+    }
+}
+
+// Meshlets belonging to one LOD: [first, first + count) of the meshlet array.
+inline void FindLodMeshlets(const Meshlet* meshlets, size_t meshletCount, const MeshLod& lod, uint32_t& first, uint32_t& count)
+{
+    const Meshlet* begin = std::lower_bound(meshlets, meshlets + meshletCount, lod.indexOffset,
+                                            [](const Meshlet& m, uint32_t offset) { return m.indexOffset < offset; });
+    const Meshlet* end = std::lower_bound(begin, meshlets + meshletCount, lod.indexOffset + lod.indexCount,
+                                          [](const Meshlet& m, uint32_t offset) { return m.indexOffset < offset; });
+    first = static_cast<uint32_t>(begin - meshlets);
+    count = static_cast<uint32_t>(end - begin);
+}
+
+// Normalized frustum planes (Gribb/Hartmann) of clipFromObject, in object space.
+inline void ExtractFrustum(const glm::mat4& clipFromObject, glm::vec4 planes[6])
+{
+    glm::mat4 m = glm::transpose(clipFromObject);
+    planes[0] = m[3] + m[0];
+    planes[1] = m[3] - m[0];
+    planes[2] = m[3] + m[1];
+    planes[3] = m[3] - m[1];
+    planes[4] = m[3] + m[2];
+    planes[5] = m[3] - m[2];
+    for (int i = 0; i < 6; i++) {
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+    }
+}
+
+// Culls meshlets against the frustum and by normal cone. cameraPosition is in object space.
+// Visible ranges are appended to out, merging neighbours into single draws.
+inline void Cull(const Meshlet* meshlets, uint32_t count, const glm::mat4& clipFromObject, glm::vec3 cameraPosition,
+                 std::vector<Range>& out, CullStats& stats)
+{
+    glm::vec4 planes[6];
+    ExtractFrustum(clipFromObject, planes);
+    stats.total += count;
+    for (uint32_t i = 0; i < count; i++) {
+        const Meshlet& m = meshlets[i];
+        glm::vec3 center(m.center[0], m.center[1], m.center[2]);
+        bool outside = false;
+        for (int p = 0; p < 6 && !outside; p++) {
+            outside = glm::dot(glm::vec3(planes[p]), center) + planes[p].w < -m.radius;
+        }
+        if (outside) {
+            stats.frustumCulled++;
+            continue;
+        }
+        glm::vec3 toCenter = center - cameraPosition;
+        glm::vec3 axis(m.coneAxis[0], m.coneAxis[1], m.coneAxis[2]);
+        if (glm::dot(toCenter, axis) >= m.coneCutoff * glm::length(toCenter) + m.radius) {
+            stats.backfaceCulled++;
+            continue;
+        }
+        if (!out.empty() && out.back().indexOffset + out.back().indexCount == m.indexOffset) {
+            out.back().indexCount += m.indexCount;
+        } else {
+            out.push_back({ m.indexOffset, m.indexCount });
+        }
+    }
+}
+
+// Culled fraction of the full-resolution meshlets from typical viewpoints: orbits of eight
+// cameras at eye level and from 35 degrees above, framing the whole mesh (3x the bounding
+// radius) and close up (1.5x).
+inline void ReportCulling(const Mesh& mesh)
+{
+    if (mesh.meshlets.empty()) {
+        return;
+    }
+    MeshLod base = mesh.lods.empty() ? MeshLod{ 0, mesh.IndexCount(), 0.0f, 0 } : mesh.lods[0];
+    uint32_t first, count;
+    FindLodMeshlets(mesh.meshlets.data(), mesh.meshlets.size(), base, first, count);
+    glm::vec3 center;
+    float radius;
+    mesh.ComputeBounds(center, radius);
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.01f * radius, 100.0f * radius);
+    std::vector<Range> ranges;
+    std::cout << "Meshlet culling, " << count << " meshlets at LOD 0:" << std::endl;
+    for (float distance : { 3.0f, 1.5f }) {
+        for (float elevation : { 0.0f, 35.0f }) {
+            CullStats stats;
+            for (int i = 0; i < 8; i++) {
+                float azimuth = glm::radians(45.0f * i), e = glm::radians(elevation);
+                glm::vec3 eye = center + distance * radius * glm::vec3(std::cos(e) * std::cos(azimuth), std::sin(e), std::cos(e) * std::sin(azimuth));
+                glm::mat4 view = glm::lookAt(eye, center, glm::vec3(0.0f, 1.0f, 0.0f));
+                ranges.clear();
+                Cull(&mesh.meshlets[first], count, projection * view, eye, ranges, stats);
+            }
+            std::cout << "  distance " << distance << "r, elevation " << elevation << " deg: "
+                      << 100.0f * (stats.frustumCulled + stats.backfaceCulled) / stats.total << "% culled ("
+                      << 100.0f * stats.frustumCulled / stats.total << "% frustum, "
+                      << 100.0f * stats.backfaceCulled / stats.total << "% normal cone)" << std::endl;
+        }
+    }
+}
+}
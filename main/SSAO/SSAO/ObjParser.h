@@ -0,0 +1,545 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <iostream>
+#include "glm/glm.hpp"
+#include "MappedFile.h"
+
+// Multithreaded Wavefront OBJ parser. The file is mmapped, split at line boundaries into
+// one chunk per thread, and every chunk is parsed independently with allocation-free number
+// routines. Chunks are merged back in file order, so the result is identical to a
+// sequential parse. Only v, vn and f records are read; faces are fan-triangulated.
+namespace ObjParser
+{
+struct Result
+{
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    // 0-based, one entry per triangle corner. A normal index of -1 means the face had none.
+    std::vector<int32_t> positionIndices;
+    std::vector<int32_t> normalIndices;
+};
+
+// Skip to the first character of the next line.
+inline const char* NextLine(const char* p, const char* end)
+{
+    const void* nl = memchr(p, '\n', static_cast<size_t>(end - p));
+    return nl ? static_cast<const char*>(nl) + 1 : end;
+}
+
+inline const char* SkipBlanks(const char* p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+// from_chars-style: parses at p, returns the first unparsed character or nullptr on failure.
+inline const char* ParseInt(const char* p, const char* end, int64_t& out)
+{
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    const char* start = p;
+    int64_t value = 0;
+    while (p < end && static_cast<unsigned>(*p - '0') < 10u) {
+        value = value * 10 + (*p - '0');
+        p++;
+    }
+    if (p == start) {
+        return nullptr;
+    }
+    out = negative ? -value : value;
+    return p;
+}
+
+inline const char* ParseFloat(const char* p, const char* end, float& out)
+{
+    static const double powersOf10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    uint64_t mantissa = 0;
+    int exponent = 0, significant = 0;
+    bool anyDigit = false;
+    while (p < end && static_cast<unsigned>(*p - '0') < 10u) {
+        if (significant < 19) {
+            mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+            significant += mantissa != 0;
+        } else {
+            exponent++;
+        }
+        anyDigit = true;
+        p++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && static_cast<unsigned>(*p - '0') < 10u) {
+            if (significant < 19) {
+                mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+                significant += mantissa != 0;
+                exponent--;
+            }
+            anyDigit = true;
+            p++;
+        }
+    }
+    if (!anyDigit) {
+        return nullptr;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        int64_t e = 0;
+        const char* q = ParseInt(p + 1, end, e);
+        if (q != nullptr) {
+            exponent += static_cast<int>(glm::clamp<int64_t>(e, -400, 400));
+            p = q;
+        }
+    }
+    double value = static_cast<double>(mantissa);
+    if (exponent >= 0 && exponent <= 22) {
+        value *= powersOf10[exponent];
+    } else if (exponent < 0 && exponent >= -22) {
+        value /= powersOf10[-exponent];
+    } else if (mantissa != 0) {
+        value *= std::pow(10.0, exponent);
+    }
+    out = static_cast<float>(negative ? -value : value);
+    return p;
+}
+
+inline const char* ParseVec3(const char* p, const char* end, glm::vec3& v)
+{
+    for (int i = 0; i < 3 && p != nullptr; i++) {
+        p = ParseFloat(SkipBlanks(p, end), end, v[i]);
+    }
+    return p;
+}
+
+// Per-thread output. Relative (negative) face indices cannot be resolved until the number
+// of elements in earlier chunks is known, so they are stored chunk-local and patched on merge.
+struct Chunk
+{
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<int32_t> positionIndices;
+    std::vector<int32_t> normalIndices;
+    std::vector<uint32_t> positionFixups;
+    std::vector<uint32_t> normalFixups;
+    bool ok = true;
+
+    bool AddPosition(const glm::vec3& v)
+    {
+        positions.push_back(v);
+        return true;
+    }
+    bool AddNormal(const glm::vec3& n)
+    {
+        normals.push_back(n);
+        return true;
+    }
+    // OBJ indices are 1-based, negative ones relative, 0 means absent (normals only)
+    bool AddCorner(int64_t v, int64_t vn)
+    {
+        uint32_t corner = static_cast<uint32_t>(positionIndices.size());
+        positionIndices.push_back(ResolveIndex(v, positions.size(), corner, positionFixups));
+        normalIndices.push_back(vn == 0 ? -1 : ResolveIndex(vn, normals.size(), corner, normalFixups));
+        return true;
+    }
+
+    // Converts a 1-based OBJ index to 0-based. Negative indices are relative to the current
+    // element count; those are recorded as fixups because they may reach into earlier chunks.
+    static int32_t ResolveIndex(int64_t index, size_t localCount, uint32_t corner, std::vector<uint32_t>& fixups)
+    {
+        if (index > 0) {
+            return static_cast<int32_t>(index - 1);
+        }
+        fixups.push_back(corner);
+        return static_cast<int32_t>(static_cast<int64_t>(localCount) + index);
+    }
+};
+
+// Element counts of a chunk (pass one of the two-pass parse), and the running write
+// positions of a chunk in pass two.
+struct Counts
+{
+    size_t positions = 0;
+    size_t normals = 0;
+    size_t corners = 0;
+};
+
+// Pass-two output: writes straight into the final, exactly sized arrays starting at the
+// chunk's base offsets, so there are no per-chunk vectors and no merge copy. Every element
+// before the chunk is already accounted for in base, so relative indices resolve directly.
+struct DirectChunk
+{
+    Result& out;
+    Counts next;
+    Counts limit;
+    bool ok = true;
+
+    bool AddPosition(const glm::vec3& v)
+    {
+        if (next.positions >= limit.positions) {
+            return false;
+        }
+        out.positions[next.positions++] = v;
+        return true;
+    }
+    bool AddNormal(const glm::vec3& n)
+    {
+        if (next.normals >= limit.normals) {
+            return false;
+        }
+        out.normals[next.normals++] = n;
+        return true;
+    }
+    bool AddCorner(int64_t v, int64_t vn)
+    {
+        if (next.corners >= limit.corners) {
+            return false;
+        }
+        int64_t position = v > 0 ? v - 1 : static_cast<int64_t>(next.positions) + v;
+        int64_t normal = vn == 0 ? -1 : vn > 0 ? vn - 1 : static_cast<int64_t>(next.normals) + vn;
+        if (position < 0 || position >= static_cast<int64_t>(out.positions.size()) ||
+            normal < -1 || normal >= static_cast<int64_t>(out.normals.size())) {
+            return false;
+        }
+        out.positionIndices[next.corners] = static_cast<int32_t>(position);
+        out.normalIndices[next.corners++] = static_cast<int32_t>(normal);
+        return true;
+    }
+};
+
+inline bool IsRecord(const char* line, const char* next, const char* tag, size_t length)
+{
+    return line + length < next && memcmp(line, tag, length) == 0 && (line[length] == ' ' || line[length] == '\t');
+}
+
+// Number of corners of the face starting after "f ", or 0 if it is not a polygon.
+inline size_t CountFaceVertices(const char* p, const char* end)
+{
+    size_t count = 0;
+    while (true) {
+        p = SkipBlanks(p, end);
+        if (p >= end || *p == '\n' || *p == '#') {
+            return count;
+        }
+        count++;
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+            p++;
+        }
+    }
+}
+
+// Pass one: counts records without parsing any numbers.
+inline void CountChunk(const char* p, const char* end, Counts& counts)
+{
+    while (p < end) {
+        const char* line = SkipBlanks(p, end);
+        const char* next = NextLine(line, end);
+        if (IsRecord(line, next, "v", 1)) {
+            counts.positions++;
+        } else if (IsRecord(line, next, "vn", 2)) {
+            counts.normals++;
+        } else if (IsRecord(line, next, "f", 1)) {
+            size_t n = CountFaceVertices(line + 2, next);
+            counts.corners += n >= 3 ? (n - 2) * 3 : 0;
+        }
+        p = next;
+    }
+}
+
+template <typename Sink>
+inline void ParseChunk(const char* p, const char* end, Sink& chunk)
+{
+    struct Corner { int64_t v, vn; };
+    std::vector<Corner> corners;
+    corners.reserve(16);
+
+    while (p < end) {
+        const char* line = SkipBlanks(p, end);
+        const char* next = NextLine(line, end);
+        if (line + 1 >= next) {
+            p = next;
+            continue;
+        }
+        if (IsRecord(line, next, "v", 1)) {
+            glm::vec3 v;
+            if (ParseVec3(line + 2, next, v) == nullptr || !chunk.AddPosition(v)) {
+                chunk.ok = false;
+                return;
+            }
+        }
+        else if (IsRecord(line, next, "vn", 2)) {
+            glm::vec3 n;
+            if (ParseVec3(line + 3, next, n) == nullptr || !chunk.AddNormal(n)) {
+                chunk.ok = false;
+                return;
+            }
+        }
+        else if (IsRecord(line, next, "f", 1)) {
+            // f v, f v/vt, f v//vn or f v/vt/vn
+            corners.clear();
+            const char* q = line + 2;
+            while (true) {
+                q = SkipBlanks(q, next);
+                if (q >= next || *q == '\n' || *q == '#') {
+                    break;
+                }
+                Corner c = { 0, 0 };
+                q = ParseInt(q, next, c.v);
+                if (q == nullptr) {
+                    chunk.ok = false;
+                    return;
+                }
+                if (q < next && *q == '/') {
+                    q++;
+                    if (q < next && *q != '/') {
+                        int64_t vt;
+                        const char* r = ParseInt(q, next, vt);
+                        q = r ? r : q;
+                    }
+                    if (q < next && *q == '/') {
+                        q = ParseInt(q + 1, next, c.vn);
+                        if (q == nullptr) {
+                            chunk.ok = false;
+                            return;
+                        }
+                    }
+                }
+                corners.push_back(c);
+            }
+            for (size_t i = 1; i + 1 < corners.size(); i++) {
+                const Corner* tri[3] = { &corners[0], &corners[i], &corners[i + 1] };
+                for (const Corner* c : tri) {
+                    if (!chunk.AddCorner(c->v, c->vn)) {
+                        chunk.ok = false;
+                        return;
+                    }
+                }
+            }
+        }
+        p = next;
+    }
+}
+
+inline unsigned DefaultThreadCount(size_t bytes)
+{
+    // Below ~1 MB per thread the spawn cost outweighs the parse.
+    size_t byBytes = bytes / (1u << 20) + 1;
+    size_t hw = std::max(1u, std::thread::hardware_concurrency());
+    return static_cast<unsigned>(std::min(hw, byBytes));
+}
+
+// Splits [data, data + size) at line boundaries into threadCount chunks.
+inline std::vector<const char*> SplitLines(const char* data, size_t size, unsigned threadCount)
+{
+    const char* end = data + size;
+    std::vector<const char*> bounds(threadCount + 1);
+    bounds[0] = data;
+    bounds[threadCount] = end;
+    for (unsigned i = 1; i < threadCount; i++) {
+        const char* guess = data + size / threadCount * i;
+        guess = std::max(guess, bounds[i - 1]);
+        bounds[i] = guess == data ? data : NextLine(guess - 1, end);
+    }
+    return bounds;
+}
+
+inline bool ParseMemory(const char* data, size_t size, Result& out, unsigned threadCount = 0)
+{
+    if (threadCount == 0) {
+        threadCount = DefaultThreadCount(size);
+    }
+    std::vector<const char*> bounds = SplitLines(data, size, threadCount);
+
+    std::vector<Chunk> chunks(threadCount);
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threadCount; i++) {
+        workers.emplace_back(ParseChunk<Chunk>, bounds[i], bounds[i + 1], std::ref(chunks[i]));
+    }
+    ParseChunk(bounds[0], bounds[1], chunks[0]);
+    for (std::thread& t : workers) {
+        t.join();
+    }
+    workers.clear();
+
+    // prefix sums give every chunk its slot in the merged arrays
+    std::vector<size_t> positionBase(threadCount + 1, 0), normalBase(threadCount + 1, 0), cornerBase(threadCount + 1, 0);
+    for (unsigned i = 0; i < threadCount; i++) {
+        if (!chunks[i].ok) {
+            std::cout << "Malformed OBJ data" << std::endl;
+            return false;
+        }
+        positionBase[i + 1] = positionBase[i] + chunks[i].positions.size();
+        normalBase[i + 1] = normalBase[i] + chunks[i].normals.size();
+        cornerBase[i + 1] = cornerBase[i] + chunks[i].positionIndices.size();
+    }
+    size_t positionCount = positionBase[threadCount], normalCount = normalBase[threadCount];
+    if (positionCount > INT32_MAX || normalCount > INT32_MAX || cornerBase[threadCount] > UINT32_MAX) {
+        std::cout << "OBJ too large" << std::endl;
+        return false;
+    }
+    out.positions.resize(positionCount);
+    out.normals.resize(normalCount);
+    out.positionIndices.resize(cornerBase[threadCount]);
+    out.normalIndices.resize(cornerBase[threadCount]);
+
+    std::atomic<bool> rangeOk(true);
+    auto merge = [&](unsigned i) {
+        Chunk& c = chunks[i];
+        std::copy(c.positions.begin(), c.positions.end(), out.positions.begin() + positionBase[i]);
+        std::copy(c.normals.begin(), c.normals.end(), out.normals.begin() + normalBase[i]);
+        for (uint32_t corner : c.positionFixups) {
+            c.positionIndices[corner] += static_cast<int32_t>(positionBase[i]);
+        }
+        for (uint32_t corner : c.normalFixups) {
+            c.normalIndices[corner] += static_cast<int32_t>(normalBase[i]);
+        }
+        bool ok = true;
+        for (size_t k = 0; k < c.positionIndices.size(); k++) {
+            int32_t v = c.positionIndices[k], n = c.normalIndices[k];
+            ok &= v >= 0 && static_cast<size_t>(v) < positionCount;
+            ok &= n >= -1 && (n == -1 || static_cast<size_t>(n) < normalCount);
+        }
+        if (!ok) {
+            rangeOk = false;
+        }
+        std::copy(c.positionIndices.begin(), c.positionIndices.end(), out.positionIndices.begin() + cornerBase[i]);
+        std::copy(c.normalIndices.begin(), c.normalIndices.end(), out.normalIndices.begin() + cornerBase[i]);
+        // release chunk memory as soon as it is merged
+        c = Chunk();
+    };
+    for (unsigned i = 1; i < threadCount; i++) {
+        workers.emplace_back(merge, i);
+    }
+    merge(0);
+    for (std::thread& t : workers) {
+        t.join();
+    }
+    if (!rangeOk) {
+        std::cout << "OBJ face index out of range" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Low-peak-memory variant of ParseMemory. Pass one counts the records of every chunk, so
+// the output arrays are allocated once at their exact final size. Pass two then parses
+// each chunk straight into its slice of those arrays. Peak memory is one copy of the
+// result instead of the per-chunk vectors and the merged copy that coexist in ParseMemory.
+// The file is read twice, which costs some parse time.
+inline bool ParseMemoryTwoPass(const char* data, size_t size, Result& out, unsigned threadCount = 0, const MappedFile* file = nullptr)
+{
+    // with a file, each thread drops the pages it has finished with every RELEASE_BYTES so
+    // the mapped source never becomes resident as a whole
+    const size_t RELEASE_BYTES = 16u << 20;
+    auto release = [file](const char* begin, const char* end) {
+        if (file != nullptr) {
+            file->Release(begin, static_cast<size_t>(end - begin));
+        }
+    };
+    if (threadCount == 0) {
+        threadCount = DefaultThreadCount(size);
+    }
+    std::vector<const char*> bounds = SplitLines(data, size, threadCount);
+    // both passes walk a chunk in line-aligned blocks, releasing each block behind them
+    auto forEachBlock = [&](unsigned i, auto body) {
+        const char* end = bounds[i + 1];
+        for (const char* p = bounds[i]; p < end;) {
+            const char* stop = end - p > static_cast<ptrdiff_t>(RELEASE_BYTES) ? NextLine(p + RELEASE_BYTES - 1, end) : end;
+            body(p, stop);
+            release(p, stop);
+            p = stop;
+        }
+    };
+    std::vector<Counts> counts(threadCount);
+    auto count = [&](unsigned i) {
+        forEachBlock(i, [&](const char* p, const char* stop) { CountChunk(p, stop, counts[i]); });
+    };
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threadCount; i++) {
+        workers.emplace_back(count, i);
+    }
+    count(0);
+    for (std::thread& t : workers) {
+        t.join();
+    }
+    workers.clear();
+
+    // chunk i writes from the sum of the counts before it, up to that plus its own counts
+    std::vector<Counts> base(threadCount + 1);
+    for (unsigned i = 0; i < threadCount; i++) {
+        base[i + 1].positions = base[i].positions + counts[i].positions;
+        base[i + 1].normals = base[i].normals + counts[i].normals;
+        base[i + 1].corners = base[i].corners + counts[i].corners;
+    }
+    const Counts& total = base[threadCount];
+    if (total.positions > INT32_MAX || total.normals > INT32_MAX || total.corners > UINT32_MAX) {
+        std::cout << "OBJ too large" << std::endl;
+        return false;
+    }
+    out.positions.assign(total.positions, glm::vec3(0.0f));
+    out.positions.shrink_to_fit();
+    out.normals.assign(total.normals, glm::vec3(0.0f));
+    out.normals.shrink_to_fit();
+    out.positionIndices.assign(total.corners, 0);
+    out.positionIndices.shrink_to_fit();
+    out.normalIndices.assign(total.corners, 0);
+    out.normalIndices.shrink_to_fit();
+
+    std::vector<DirectChunk> chunks;
+    chunks.reserve(threadCount);
+    for (unsigned i = 0; i < threadCount; i++) {
+        chunks.push_back({ out, base[i], base[i + 1] });
+    }
+    auto parse = [&](unsigned i) {
+        forEachBlock(i, [&](const char* p, const char* stop) {
+            if (chunks[i].ok) {
+                ParseChunk(p, stop, chunks[i]);
+            }
+        });
+    };
+    for (unsigned i = 1; i < threadCount; i++) {
+        workers.emplace_back(parse, i);
+    }
+    parse(0);
+    for (std::thread& t : workers) {
+        t.join();
+    }
+    for (unsigned i = 0; i < threadCount; i++) {
+        // a chunk that wrote fewer elements than it counted would leave holes
+        bool complete = chunks[i].next.positions == base[i + 1].positions && chunks[i].next.normals == base[i + 1].normals &&
+                        chunks[i].next.corners == base[i + 1].corners;
+        if (!chunks[i].ok || !complete) {
+            std::cout << "Malformed OBJ data or face index out of range" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+inline bool Parse(const char* path, Result& out, unsigned threadCount = 0, bool twoPass = false)
+{
+    MappedFile file(path);
+    if (!file.IsOpen()) {
+        std::cout << "Failed to open OBJ file: " << path << std::endl;
+        return false;
+    }
+    file.AdviseSequential();
+    const char* data = reinterpret_cast<const char*>(file.Data());
+    return twoPass ? ParseMemoryTwoPass(data, file.Size(), out, threadCount, &file) : ParseMemory(data, file.Size(), out, threadCount);
+}
+}
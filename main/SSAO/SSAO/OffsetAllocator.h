@@ -0,0 +1,330 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Two-level segregated fit (TLSF) allocator for ranges of a buffer, in caller-defined units.
+// Free blocks sit in 240 size bins laid out like a tiny float: the top level is the power
+// of two, the second level splits it into 8 linear steps. Bitmaps over both levels find the
+// first non-empty bin at least as large as a request in O(1), and freed blocks merge with
+// their physical neighbours, so allocation and free never scan. The allocator only hands out
+// offsets; it never touches the memory itself.
+//
+// Allocations are identified by node index, which stays valid across Grow() and Compact();
+// look the offset up through Offset() rather than keeping it.
+class OffsetAllocator{
+public:
+    static constexpr uint32_t NO_SPACE = 0xffffffff;
+
+    struct Allocation
+    {
+        uint32_t node = NO_SPACE;
+        bool Valid() const{
+            return node != NO_SPACE;
+        }
+    };
+    struct Move
+    {
+        uint32_t from;
+        uint32_t to;
+        uint32_t size;
+    };
+    struct Report
+    {
+        uint32_t freeUnits = 0;
+        uint32_t largestFree = 0;
+        uint32_t freeBlocks = 0;
+    };
+
+    void Reset(uint32_t capacity){
+        this->capacity = 0;
+        freeUnits = 0;
+        usedTop = 0;
+        for (uint32_t& leaf : usedLeaf){
+            leaf = 0;
+        }
+        for (uint32_t& head : binHeads){
+            head = NO_SPACE;
+        }
+        nodes.clear();
+        unusedNodes.clear();
+        head = tail = NO_SPACE;
+        Grow(capacity);
+    }
+    // Returns an invalid allocation if no free block is large enough (see Grow).
+    Allocation Allocate(uint32_t size){
+        Allocation allocation;
+        if (size == 0){
+            return allocation;
+        }
+        uint32_t index = NO_SPACE;
+        uint32_t bin = FindFreeBin(BinRoundUp(size));
+        if (bin != NO_SPACE){
+            index = binHeads[bin];
+        } else {
+            // the bin the request itself falls in holds blocks both smaller and larger than
+            // it; search it before giving up so Allocate only fails when nothing fits
+            for (uint32_t candidate = binHeads[BinRoundDown(size)]; candidate != NO_SPACE; candidate = nodes[candidate].binNext){
+                if (nodes[candidate].size >= size){
+                    index = candidate;
+                    break;
+                }
+            }
+            if (index == NO_SPACE){
+                return allocation;
+            }
+        }
+        RemoveFromBin(index);
+        Node& node = nodes[index];
+        node.used = true;
+        freeUnits -= node.size;
+        if (node.size > size){
+            // the remainder becomes a free block right after this one
+            uint32_t rest = NewNode(node.offset + size, node.size - size);
+            Node& split = nodes[rest];
+            Node& allocated = nodes[index]; // NewNode may have moved nodes
+            split.neighborPrev = index;
+            split.neighborNext = allocated.neighborNext;
+            if (allocated.neighborNext != NO_SPACE){
+                nodes[allocated.neighborNext].neighborPrev = rest;
+            } else {
+                tail = rest;
+            }
+            allocated.neighborNext = rest;
+            allocated.size = size;
+            InsertFree(rest);
+        }
+        allocation.node = index;
+        return allocation;
+    }
+    void Free(Allocation& allocation){
+        if (!allocation.Valid()){
+            return;
+        }
+        uint32_t index = allocation.node;
+        allocation.node = NO_SPACE;
+        nodes[index].used = false;
+        // absorb free neighbours; the surviving node is always the lower one
+        uint32_t next = nodes[index].neighborNext;
+        if (next != NO_SPACE && !nodes[next].used){
+            RemoveFromBin(next);
+            freeUnits -= nodes[next].size;
+            Absorb(index, next);
+        }
+        uint32_t prev = nodes[index].neighborPrev;
+        if (prev != NO_SPACE && !nodes[prev].used){
+            RemoveFromBin(prev);
+            freeUnits -= nodes[prev].size;
+            Absorb(prev, index);
+            index = prev;
+        }
+        InsertFree(index);
+    }
+    // Appends [capacity, newCapacity) as free space; existing offsets are unchanged.
+    void Grow(uint32_t newCapacity){
+        if (newCapacity <= capacity){
+            return;
+        }
+        uint32_t index = NewNode(capacity, newCapacity - capacity);
+        nodes[index].neighborPrev = tail;
+        if (tail != NO_SPACE){
+            nodes[tail].neighborNext = index;
+        } else {
+            head = index;
+        }
+        tail = index;
+        capacity = newCapacity;
+        nodes[index].used = true;
+        Allocation added;
+        added.node = index;
+        Free(added);
+    }
+    // Packs every allocation towards offset 0 in address order, leaving one free block at
+    // the end. Returns the moves to apply to the memory, in address order; each one goes
+    // to a lower offset.
+    std::vector<Move> Compact(){
+        std::vector<Move> moves;
+        for (uint32_t& leaf : usedLeaf){
+            leaf = 0;
+        }
+        for (uint32_t& bin : binHeads){
+            bin = NO_SPACE;
+        }
+        usedTop = 0;
+        uint32_t cursor = 0, previous = NO_SPACE;
+        uint32_t first = NO_SPACE;
+        for (uint32_t index = head; index != NO_SPACE;){
+            Node& node = nodes[index];
+            uint32_t next = node.neighborNext;
+            if (!node.used){
+                unusedNodes.push_back(index);
+            } else {
+                if (node.offset != cursor){
+                    moves.push_back({ node.offset, cursor, node.size });
+                }
+                node.offset = cursor;
+                node.neighborPrev = previous;
+                node.neighborNext = NO_SPACE;
+                if (previous != NO_SPACE){
+                    nodes[previous].neighborNext = index;
+                } else {
+                    first = index;
+                }
+                previous = index;
+                cursor += node.size;
+            }
+            index = next;
+        }
+        head = first;
+        tail = previous;
+        freeUnits = 0;
+        uint32_t end = capacity;
+        capacity = cursor;
+        Grow(end);
+        return moves;
+    }
+    uint32_t Offset(Allocation allocation) const{
+        return nodes[allocation.node].offset;
+    }
+    uint32_t Size(Allocation allocation) const{
+        return nodes[allocation.node].size;
+    }
+    uint32_t Capacity() const{
+        return capacity;
+    }
+    Report GetReport() const{
+        Report report;
+        report.freeUnits = freeUnits;
+        for (uint32_t bin = 0; bin < BIN_COUNT; bin++){
+            for (uint32_t index = binHeads[bin]; index != NO_SPACE; index = nodes[index].binNext){
+                report.freeBlocks++;
+                report.largestFree = nodes[index].size > report.largestFree ? nodes[index].size : report.largestFree;
+            }
+        }
+        return report;
+    }
+private:
+    static constexpr uint32_t MANTISSA_BITS = 3;
+    static constexpr uint32_t LEAF_BINS = 1 << MANTISSA_BITS;
+    static constexpr uint32_t TOP_BINS = 30;
+    static constexpr uint32_t BIN_COUNT = TOP_BINS * LEAF_BINS;
+
+    struct Node
+    {
+        uint32_t offset = 0;
+        uint32_t size = 0;
+        uint32_t binPrev = NO_SPACE;
+        uint32_t binNext = NO_SPACE;
+        uint32_t neighborPrev = NO_SPACE; // physically adjacent blocks
+        uint32_t neighborNext = NO_SPACE;
+        bool used = false;
+    };
+    uint32_t capacity = 0;
+    uint32_t freeUnits = 0;
+    uint32_t usedTop = 0;              // bit per top level with any non-empty bin
+    uint32_t usedLeaf[TOP_BINS] = {};  // bit per non-empty bin
+    uint32_t binHeads[BIN_COUNT];
+    std::vector<Node> nodes;
+    std::vector<uint32_t> unusedNodes;
+    uint32_t head = NO_SPACE, tail = NO_SPACE;
+
+    static uint32_t HighestBit(uint32_t value){
+        return 31 - static_cast<uint32_t>(__builtin_clz(value));
+    }
+    static uint32_t LowestBit(uint32_t value){
+        return static_cast<uint32_t>(__builtin_ctz(value));
+    }
+    // Sizes below 8 get a bin each; above, the top three bits below the leading one pick
+    // the second level. Round down to insert (every block in a bin is at least its size),
+    // round up to search (every block in the found bin is large enough).
+    static uint32_t BinRoundDown(uint32_t size){
+        if (size < LEAF_BINS){
+            return size;
+        }
+        uint32_t shift = HighestBit(size) - MANTISSA_BITS;
+        return ((shift + 1) << MANTISSA_BITS) | ((size >> shift) & (LEAF_BINS - 1));
+    }
+    static uint32_t BinRoundUp(uint32_t size){
+        uint32_t bin = BinRoundDown(size);
+        if (size >= LEAF_BINS){
+            uint32_t shift = HighestBit(size) - MANTISSA_BITS;
+            if ((size & ((1u << shift) - 1)) != 0){
+                bin++;
+            }
+        }
+        return bin;
+    }
+    uint32_t FindFreeBin(uint32_t bin) const{
+        if (bin >= BIN_COUNT){
+            return NO_SPACE;
+        }
+        uint32_t top = bin >> MANTISSA_BITS;
+        uint32_t leaves = usedLeaf[top] & (~0u << (bin & (LEAF_BINS - 1)));
+        if (leaves != 0){
+            return (top << MANTISSA_BITS) | LowestBit(leaves);
+        }
+        uint32_t tops = top + 1 < 32 ? usedTop & (~0u << (top + 1)) : 0;
+        if (tops == 0){
+            return NO_SPACE;
+        }
+        top = LowestBit(tops);
+        return (top << MANTISSA_BITS) | LowestBit(usedLeaf[top]);
+    }
+    uint32_t NewNode(uint32_t offset, uint32_t size){
+        uint32_t index;
+        if (!unusedNodes.empty()){
+            index = unusedNodes.back();
+            unusedNodes.pop_back();
+            nodes[index] = Node();
+        } else {
+            index = static_cast<uint32_t>(nodes.size());
+            nodes.emplace_back();
+        }
+        nodes[index].offset = offset;
+        nodes[index].size = size;
+        return index;
+    }
+    void InsertFree(uint32_t index){
+        Node& node = nodes[index];
+        uint32_t bin = BinRoundDown(node.size);
+        node.used = false;
+        node.binPrev = NO_SPACE;
+        node.binNext = binHeads[bin];
+        if (binHeads[bin] != NO_SPACE){
+            nodes[binHeads[bin]].binPrev = index;
+        }
+        binHeads[bin] = index;
+        usedLeaf[bin >> MANTISSA_BITS] |= 1u << (bin & (LEAF_BINS - 1));
+        usedTop |= 1u << (bin >> MANTISSA_BITS);
+        freeUnits += node.size;
+    }
+    void RemoveFromBin(uint32_t index){
+        Node& node = nodes[index];
+        uint32_t bin = BinRoundDown(node.size);
+        if (node.binPrev != NO_SPACE){
+            nodes[node.binPrev].binNext = node.binNext;
+        } else {
+            binHeads[bin] = node.binNext;
+            if (node.binNext == NO_SPACE){
+                usedLeaf[bin >> MANTISSA_BITS] &= ~(1u << (bin & (LEAF_BINS - 1)));
+                if (usedLeaf[bin >> MANTISSA_BITS] == 0){
+                    usedTop &= ~(1u << (bin >> MANTISSA_BITS));
+                }
+            }
+        }
+        if (node.binNext != NO_SPACE){
+            nodes[node.binNext].binPrev = node.binPrev;
+        }
+        node.binPrev = node.binNext = NO_SPACE;
+    }
+    // Merges the block right after lower into lower and recycles its node.
+    void Absorb(uint32_t lower, uint32_t upper){
+        nodes[lower].size += nodes[upper].size;
+        nodes[lower].neighborNext = nodes[upper].neighborNext;
+        if (nodes[upper].neighborNext != NO_SPACE){
+            nodes[nodes[upper].neighborNext].neighborPrev = lower;
+        } else {
+            tail = lower;
+        }
+        unusedNodes.push_back(upper);
+    }
+};
@@ -0,0 +1,526 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <iostream>
+#include "glm/glm.hpp"
+#include "MappedFile.h"
+#include "Mesh.h"
+#include "ObjParser.h"
+
+// Stanford PLY reader (ascii, binary_little_endian and binary_big_endian). Reads x/y/z and
+// optional nx/ny/nz from the "vertex" element and the vertex index list from the "face"
+// element; every other element and property is skipped. The file is already indexed, so
+// vertices go straight into Mesh::vertices without welding. Faces are fan-triangulated.
+// When the file has no normals, smooth area-weighted normals are computed on all cores.
+namespace PlyParser
+{
+enum class Type : uint8_t
+{
+    Invalid, Int8, Uint8, Int16, Uint16, Int32, Uint32, Float32, Float64
+};
+
+struct Property
+{
+    std::string name;
+    Type type = Type::Invalid;
+    Type countType = Type::Invalid; // != Invalid for list properties
+};
+
+struct Element
+{
+    std::string name;
+    uint64_t count = 0;
+    std::vector<Property> properties;
+};
+
+enum class Format
+{
+    Ascii, BinaryLittleEndian, BinaryBigEndian
+};
+
+inline Type ParseType(const std::string& name)
+{
+    if (name == "char" || name == "int8") return Type::Int8;
+    if (name == "uchar" || name == "uint8") return Type::Uint8;
+    if (name == "short" || name == "int16") return Type::Int16;
+    if (name == "ushort" || name == "uint16") return Type::Uint16;
+    if (name == "int" || name == "int32") return Type::Int32;
+    if (name == "uint" || name == "uint32") return Type::Uint32;
+    if (name == "float" || name == "float32") return Type::Float32;
+    if (name == "double" || name == "float64") return Type::Float64;
+    return Type::Invalid;
+}
+
+inline size_t TypeSize(Type type)
+{
+    static const size_t sizes[] = { 0, 1, 1, 2, 2, 4, 4, 4, 8 };
+    return sizes[static_cast<int>(type)];
+}
+
+// Reads one binary scalar of the given type as a double, swapping bytes if needed.
+inline double ReadBinary(const unsigned char* p, Type type, bool swap)
+{
+    unsigned char bytes[8];
+    size_t size = TypeSize(type);
+    for (size_t i = 0; i < size; i++) {
+        bytes[i] = swap ? p[size - 1 - i] : p[i];
+    }
+    switch (type) {
+        case Type::Int8: { int8_t v; memcpy(&v, bytes, 1); return v; }
+        case Type::Uint8: { uint8_t v; memcpy(&v, bytes, 1); return v; }
+        case Type::Int16: { int16_t v; memcpy(&v, bytes, 2); return v; }
+        case Type::Uint16: { uint16_t v; memcpy(&v, bytes, 2); return v; }
+        case Type::Int32: { int32_t v; memcpy(&v, bytes, 4); return v; }
+        case Type::Uint32: { uint32_t v; memcpy(&v, bytes, 4); return v; }
+        case Type::Float32: { float v; memcpy(&v, bytes, 4); return v; }
+        case Type::Float64: { double v; memcpy(&v, bytes, 8); return v; }
+        default: return 0.0;
+    }
+}
+
+// Sequential reader over the element data in either encoding.
+class Reader{
+public:
+    Reader(const char* begin, const char* end, Format format) : p(begin), end(end), format(format){}
+
+    bool Read(Type type, double& out){
+        if (format == Format::Ascii){
+            p = SkipWhitespace(p);
+            const char* q;
+            if (type == Type::Float32 || type == Type::Float64){
+                float f = 0.0f;
+                q = ObjParser::ParseFloat(p, end, f);
+                out = f;
+            } else {
+                // integers go through ParseInt so large indices stay exact
+                int64_t i = 0;
+                q = ObjParser::ParseInt(p, end, i);
+                out = static_cast<double>(i);
+            }
+            if (q == nullptr){
+                return false;
+            }
+            p = q;
+            return true;
+        }
+        size_t size = TypeSize(type);
+        if (static_cast<size_t>(end - p) < size){
+            return false;
+        }
+        out = ReadBinary(reinterpret_cast<const unsigned char*>(p), type, format == Format::BinaryBigEndian);
+        p += size;
+        return true;
+    }
+    // Reads the item count of a list property. Fails on counts that are negative, not whole
+    // or larger than the rest of the data could hold, before anything is sized by them.
+    bool ReadCount(const Property& property, size_t& count){
+        double value;
+        if (!Read(property.countType, value) || value < 0.0 || value != std::floor(value)){
+            return false;
+        }
+        // an ascii item takes at least a separator and a digit
+        size_t remaining = static_cast<size_t>(end - p);
+        size_t limit = format == Format::Ascii ? remaining / 2 + 1 : remaining / TypeSize(property.type);
+        if (value > static_cast<double>(limit)){
+            return false;
+        }
+        count = static_cast<size_t>(value);
+        return true;
+    }
+    // False if the rest of the data is too short for the element's instance count, so that
+    // nothing is sized by a corrupt header. Lists count as empty; an ascii value takes at
+    // least a digit and a separator.
+    bool Holds(const Element& element) const{
+        size_t minBytes = 0;
+        for (const Property& property : element.properties){
+            Type first = property.countType != Type::Invalid ? property.countType : property.type;
+            minBytes += format == Format::Ascii ? 2 : TypeSize(first);
+        }
+        size_t remaining = static_cast<size_t>(end - p) + (format == Format::Ascii ? 1 : 0);
+        return element.count <= remaining / std::max<size_t>(minBytes, 1);
+    }
+    // Skips one property instance (scalar or list).
+    bool Skip(const Property& property){
+        size_t count = 1;
+        if (property.countType != Type::Invalid && !ReadCount(property, count)){
+            return false;
+        }
+        if (format != Format::Ascii){
+            size_t bytes = count * TypeSize(property.type);
+            if (static_cast<size_t>(end - p) < bytes){
+                return false;
+            }
+            p += bytes;
+            return true;
+        }
+        double unused;
+        for (size_t i = 0; i < count; i++){
+            if (!Read(property.type, unused)){
+                return false;
+            }
+        }
+        return true;
+    }
+    const char* Position() const{
+        return p;
+    }
+    void SetPosition(const char* position){
+        p = position;
+    }
+private:
+    const char* p;
+    const char* end;
+    Format format;
+
+    const char* SkipWhitespace(const char* q) const{
+        while (q < end && (*q == ' ' || *q == '\t' || *q == '\r' || *q == '\n')){
+            q++;
+        }
+        return q;
+    }
+};
+
+// Parses the header; on success data points at the first byte of element data.
+inline bool ParseHeader(const char*& data, const char* end, Format& format, std::vector<Element>& elements)
+{
+    const char* p = data;
+    std::string line;
+    auto nextLine = [&]() {
+        if (p >= end) {
+            return false;
+        }
+        const char* next = ObjParser::NextLine(p, end);
+        const char* stop = next;
+        while (stop > p && (stop[-1] == '\n' || stop[-1] == '\r')) {
+            stop--;
+        }
+        line.assign(p, stop);
+        p = next;
+        return true;
+    };
+    auto split = [](const std::string& s) {
+        std::vector<std::string> words;
+        size_t i = 0;
+        while (i < s.size()) {
+            while (i < s.size() && (s[i] == ' ' || s[i] == '\t')) {
+                i++;
+            }
+            size_t j = i;
+            while (j < s.size() && s[j] != ' ' && s[j] != '\t') {
+                j++;
+            }
+            if (j > i) {
+                words.push_back(s.substr(i, j - i));
+            }
+            i = j;
+        }
+        return words;
+    };
+
+    if (!nextLine() || line != "ply") {
+        return false;
+    }
+    bool haveFormat = false;
+    while (nextLine()) {
+        std::vector<std::string> words = split(line);
+        if (words.empty() || words[0] == "comment" || words[0] == "obj_info") {
+            continue;
+        }
+        if (words[0] == "end_header") {
+            data = p;
+            return haveFormat;
+        }
+        if (words[0] == "format" && words.size() >= 2) {
+            if (words[1] == "ascii") {
+                format = Format::Ascii;
+            } else if (words[1] == "binary_little_endian") {
+                format = Format::BinaryLittleEndian;
+            } else if (words[1] == "binary_big_endian") {
+                format = Format::BinaryBigEndian;
+            } else {
+                return false;
+            }
+            haveFormat = true;
+        }
+        else if (words[0] == "element" && words.size() == 3) {
+            Element element;
+            element.name = words[1];
+            element.count = strtoull(words[2].c_str(), nullptr, 10);
+            elements.push_back(element);
+        }
+        else if (words[0] == "property" && !elements.empty()) {
+            Property property;
+            if (words.size() == 5 && words[1] == "list") {
+                property.countType = ParseType(words[2]);
+                property.type = ParseType(words[3]);
+                property.name = words[4];
+                if (property.countType == Type::Invalid || property.countType == Type::Float32 || property.countType == Type::Float64) {
+                    return false;
+                }
+            } else if (words.size() == 3) {
+                property.type = ParseType(words[1]);
+                property.name = words[2];
+            }
+            if (property.type == Type::Invalid) {
+                return false;
+            }
+            elements.back().properties.push_back(property);
+        }
+        else {
+            return false;
+        }
+    }
+    return false;
+}
+
+inline int FindProperty(const Element& element, const char* name)
+{
+    for (size_t i = 0; i < element.properties.size(); i++) {
+        if (element.properties[i].name == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+// Runs body(begin, end) over [0, count) split evenly across threads (0 = all cores).
+template <typename Body>
+inline void ParallelFor(size_t count, unsigned threadCount, Body body)
+{
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    std::vector<std::thread> workers;
+    size_t step = (count + threadCount - 1) / threadCount;
+    for (unsigned t = 1; t < threadCount && t * step < count; t++) {
+        workers.emplace_back(body, t * step, std::min(count, (t + 1) * step));
+    }
+    body(0, std::min(count, step));
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+// Area-weighted smooth vertex normals, written into the normal slots of mesh.vertices.
+// Face normals are computed in parallel, then each thread gathers them for its own range of
+// vertices through a vertex -> triangle adjacency, so no two threads write the same vertex.
+inline void ComputeSmoothNormals(Mesh& mesh, unsigned threadCount = 0)
+{
+    uint32_t vertexCount = mesh.VertexCount();
+    size_t triangleCount = mesh.indices.size() / 3;
+    const uint32_t stride = mesh.floatsPerVertex;
+    auto position = [&](uint32_t v) {
+        const float* p = &mesh.vertices[static_cast<size_t>(v) * stride];
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+
+    // unnormalized cross products are twice the triangle area, which is the weight we want
+    std::vector<glm::vec3> faceNormals(triangleCount);
+    ParallelFor(triangleCount, threadCount, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; t++) {
+            glm::vec3 a = position(mesh.indices[t * 3]), b = position(mesh.indices[t * 3 + 1]), c = position(mesh.indices[t * 3 + 2]);
+            faceNormals[t] = glm::cross(b - a, c - a);
+        }
+    });
+
+    std::vector<uint32_t> offsets(static_cast<size_t>(vertexCount) + 1, 0);
+    for (uint32_t v : mesh.indices) {
+        offsets[v + 1]++;
+    }
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        offsets[v + 1] += offsets[v];
+    }
+    std::vector<uint32_t> adjacency(mesh.indices.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < mesh.indices.size(); i++) {
+        adjacency[fill[mesh.indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    ParallelFor(vertexCount, threadCount, [&](size_t begin, size_t end) {
+        for (size_t v = begin; v < end; v++) {
+            glm::vec3 n(0.0f);
+            for (uint32_t a = offsets[v]; a < offsets[v + 1]; a++) {
+                n += faceNormals[adjacency[a]];
+            }
+            float length = glm::length(n);
+            n = length > 0.0f ? n / length : glm::vec3(0.0f, 1.0f, 0.0f);
+            float* out = &mesh.vertices[v * stride + 6];
+            out[0] = n.x;
+            out[1] = n.y;
+            out[2] = n.z;
+        }
+    });
+}
+
+// Binary vertex elements made only of scalars have a fixed stride, so every vertex can be
+// decoded independently and in parallel. Returns false (reader untouched) if the element
+// contains a list or is truncated, leaving it to the sequential path.
+inline bool DecodeFixedVertices(Reader& reader, const Element& element, const int xyz[3], const int* normal,
+                                const char* end, bool swap, const float color[3], Mesh& out, unsigned threadCount)
+{
+    std::vector<size_t> offsets;
+    size_t vertexBytes = 0;
+    for (const Property& property : element.properties) {
+        if (property.countType != Type::Invalid) {
+            return false;
+        }
+        offsets.push_back(vertexBytes);
+        vertexBytes += TypeSize(property.type);
+    }
+    const unsigned char* base = reinterpret_cast<const unsigned char*>(reader.Position());
+    size_t totalBytes = static_cast<size_t>(element.count) * vertexBytes;
+    if (static_cast<size_t>(end - reader.Position()) < totalBytes) {
+        return false; // the sequential path reports the truncation
+    }
+    const uint32_t stride = out.floatsPerVertex;
+    ParallelFor(static_cast<size_t>(element.count), threadCount, [&](size_t begin, size_t last) {
+        for (size_t v = begin; v < last; v++) {
+            const unsigned char* src = base + v * vertexBytes;
+            float* vertex = &out.vertices[v * stride];
+            for (int k = 0; k < 3; k++) {
+                const Property& p = element.properties[xyz[k]];
+                vertex[k] = static_cast<float>(ReadBinary(src + offsets[xyz[k]], p.type, swap));
+                vertex[3 + k] = color[k];
+                vertex[6 + k] = normal ? static_cast<float>(ReadBinary(src + offsets[normal[k]], element.properties[normal[k]].type, swap)) : 0.0f;
+            }
+        }
+    });
+    reader.SetPosition(reader.Position() + totalBytes);
+    return true;
+}
+
+inline bool ParseMemory(const char* data, size_t size, Mesh& out, const float color[3], unsigned threadCount = 0)
+{
+    const char* end = data + size;
+    Format format = Format::Ascii;
+    std::vector<Element> elements;
+    if (!ParseHeader(data, end, format, elements)) {
+        std::cout << "Malformed PLY header" << std::endl;
+        return false;
+    }
+
+    out = Mesh();
+    const uint32_t stride = out.floatsPerVertex;
+    bool haveNormals = false;
+    bool haveFaces = false;
+    Reader reader(data, end, format);
+    std::vector<double> values;
+    std::vector<uint32_t> polygon;
+    for (const Element& element : elements) {
+        if (!reader.Holds(element)) {
+            std::cout << "Truncated PLY data: too little left for " << element.count << " of element " << element.name << std::endl;
+            return false;
+        }
+        if (element.name == "vertex") {
+            int xyz[3] = { FindProperty(element, "x"), FindProperty(element, "y"), FindProperty(element, "z") };
+            int normal[3] = { FindProperty(element, "nx"), FindProperty(element, "ny"), FindProperty(element, "nz") };
+            if (xyz[0] < 0 || xyz[1] < 0 || xyz[2] < 0 || element.count > UINT32_MAX) {
+                std::cout << "PLY vertex element needs x, y and z" << std::endl;
+                return false;
+            }
+            haveNormals = normal[0] >= 0 && normal[1] >= 0 && normal[2] >= 0;
+            out.vertices.resize(static_cast<size_t>(element.count) * stride);
+            if (format != Format::Ascii && DecodeFixedVertices(reader, element, xyz, haveNormals ? normal : nullptr, end,
+                                                               format == Format::BinaryBigEndian, color, out, threadCount)) {
+                continue;
+            }
+            values.resize(element.properties.size());
+            for (uint64_t v = 0; v < element.count; v++) {
+                for (size_t k = 0; k < element.properties.size(); k++) {
+                    const Property& property = element.properties[k];
+                    bool ok = property.countType == Type::Invalid ? reader.Read(property.type, values[k]) : reader.Skip(property);
+                    if (!ok) {
+                        std::cout << "Truncated PLY vertex data" << std::endl;
+                        return false;
+                    }
+                }
+                float* vertex = &out.vertices[static_cast<size_t>(v) * stride];
+                for (int k = 0; k < 3; k++) {
+                    vertex[k] = static_cast<float>(values[xyz[k]]);
+                    vertex[3 + k] = color[k];
+                    vertex[6 + k] = haveNormals ? static_cast<float>(values[normal[k]]) : 0.0f;
+                }
+            }
+        }
+        else if (element.name == "face") {
+            int list = FindProperty(element, "vertex_indices");
+            list = list < 0 ? FindProperty(element, "vertex_index") : list;
+            if (list < 0 || element.properties[list].countType == Type::Invalid) {
+                std::cout << "PLY face element needs a vertex_indices list" << std::endl;
+                return false;
+            }
+            haveFaces = true;
+            out.indices.reserve(static_cast<size_t>(element.count) * 3);
+            const Property& indices = element.properties[list];
+            for (uint64_t f = 0; f < element.count; f++) {
+                for (size_t k = 0; k < element.properties.size(); k++) {
+                    if (static_cast<int>(k) != list) {
+                        if (!reader.Skip(element.properties[k])) {
+                            std::cout << "Truncated PLY face data" << std::endl;
+                            return false;
+                        }
+                        continue;
+                    }
+                    size_t count;
+                    if (!reader.ReadCount(indices, count)) {
+                        std::cout << "Truncated PLY face data or invalid face size" << std::endl;
+                        return false;
+                    }
+                    polygon.resize(count);
+                    for (uint32_t& index : polygon) {
+                        double value;
+                        if (!reader.Read(indices.type, value)) {
+                            std::cout << "Truncated PLY face data" << std::endl;
+                            return false;
+                        }
+                        if (value < 0.0 || value >= static_cast<double>(out.VertexCount())) {
+                            std::cout << "PLY face index out of range" << std::endl;
+                            return false;
+                        }
+                        index = static_cast<uint32_t>(value);
+                    }
+                    for (size_t i = 1; i + 1 < polygon.size(); i++) {
+                        out.indices.push_back(polygon[0]);
+                        out.indices.push_back(polygon[i]);
+                        out.indices.push_back(polygon[i + 1]);
+                    }
+                }
+            }
+        }
+        else {
+            for (uint64_t i = 0; i < element.count; i++) {
+                for (const Property& property : element.properties) {
+                    if (!reader.Skip(property)) {
+                        std::cout << "Truncated PLY data" << std::endl;
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    if (!haveFaces || out.indices.empty()) {
+        std::cout << "PLY file has no faces" << std::endl;
+        return false;
+    }
+    if (!haveNormals) {
+        ComputeSmoothNormals(out, threadCount);
+    }
+    return true;
+}
+
+inline bool Parse(const char* path, Mesh& out, const float color[3], unsigned threadCount = 0)
+{
+    MappedFile file(path);
+    if (!file.IsOpen()) {
+        std::cout << "Failed to open PLY file: " << path << std::endl;
+        return false;
+    }
+    file.AdviseSequential();
+    return ParseMemory(reinterpret_cast<const char*>(file.Data()), file.Size(), out, color, threadCount);
+}
+}
@@ -0,0 +1,181 @@
+#pragma once
+#include <cstdint>
+#include <cfloat>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include "glm/glm.hpp"
+
+struct Aabb
+{
+    glm::vec3 min;
+    glm::vec3 max;
+};
+
+// Bounding volume hierarchy over scene instances for per-frame frustum culling. Every node
+// has four children whose bounds are stored as SoA lanes (minX[4], minY[4], ...), so one
+// frustum plane is tested against all four children with straight-line 4-wide arithmetic
+// the compiler vectorizes. The tree is built top-down by median splits along the longest
+// centroid axis; Refit() recomputes the bounds bottom-up for moved instances while keeping
+// the topology, which stays fine as long as instances move locally (rebuild otherwise).
+class SceneBvh{
+public:
+    struct CullStats
+    {
+        uint32_t visitedNodes = 0;
+        uint32_t culledInstances = 0;
+        uint32_t visibleInstances = 0;
+        double milliseconds = 0.0;
+    };
+    static constexpr uint32_t LEAF_SIZE = 4;
+
+    void Build(const std::vector<Aabb>& bounds){
+        nodes.clear();
+        items.resize(bounds.size());
+        centroids.resize(bounds.size());
+        for (uint32_t i = 0; i < bounds.size(); i++){
+            items[i] = i;
+            centroids[i] = 0.5f * (bounds[i].min + bounds[i].max);
+        }
+        if (!bounds.empty()){
+            BuildNode(0, static_cast<uint32_t>(bounds.size()));
+        }
+        Refit(bounds);
+    }
+    // Recomputes all bounds from the instances' current AABBs (same instances as Build).
+    // Children always come after their parent, so one reverse pass is bottom-up.
+    void Refit(const std::vector<Aabb>& bounds){
+        for (size_t n = nodes.size(); n-- > 0;){
+            Node& node = nodes[n];
+            for (int i = 0; i < 4; i++){
+                Aabb box = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+                if (node.child[i] == LEAF){
+                    for (uint32_t j = node.first[i]; j < node.first[i] + node.count[i]; j++){
+                        box.min = glm::min(box.min, bounds[items[j]].min);
+                        box.max = glm::max(box.max, bounds[items[j]].max);
+                    }
+                } else if (node.child[i] != EMPTY){
+                    box = NodeBounds(nodes[node.child[i]]);
+                }
+                node.minX[i] = box.min.x; node.minY[i] = box.min.y; node.minZ[i] = box.min.z;
+                node.maxX[i] = box.max.x; node.maxY[i] = box.max.y; node.maxZ[i] = box.max.z;
+            }
+        }
+    }
+    // Appends the indices of instances that may intersect the frustum (normalized planes
+    // facing inwards, see Meshlets::ExtractFrustum). Subtrees entirely inside all planes
+    // are accepted without visiting them.
+    void Cull(const glm::vec4 planes[6], std::vector<uint32_t>& visible, CullStats& stats){
+        auto start = std::chrono::steady_clock::now();
+        stack.clear();
+        if (!nodes.empty()){
+            stack.push_back(0);
+        }
+        while (!stack.empty()){
+            const Node& node = nodes[stack.back()];
+            stack.pop_back();
+            stats.visitedNodes++;
+            bool outside[4] = { false, false, false, false };
+            bool inside[4] = { true, true, true, true };
+            for (int p = 0; p < 6; p++){
+                const glm::vec4& plane = planes[p];
+                for (int i = 0; i < 4; i++){
+                    // farthest and nearest box corners along the plane normal
+                    float farthest = plane.w + plane.x * (plane.x > 0.0f ? node.maxX[i] : node.minX[i]) +
+                                     plane.y * (plane.y > 0.0f ? node.maxY[i] : node.minY[i]) +
+                                     plane.z * (plane.z > 0.0f ? node.maxZ[i] : node.minZ[i]);
+                    float nearest = plane.w + plane.x * (plane.x > 0.0f ? node.minX[i] : node.maxX[i]) +
+                                    plane.y * (plane.y > 0.0f ? node.minY[i] : node.maxY[i]) +
+                                    plane.z * (plane.z > 0.0f ? node.minZ[i] : node.maxZ[i]);
+                    outside[i] = outside[i] || farthest < 0.0f;
+                    inside[i] = inside[i] && nearest >= 0.0f;
+                }
+            }
+            for (int i = 0; i < 4; i++){
+                if (node.child[i] == EMPTY){
+                    continue;
+                }
+                if (outside[i]){
+                    stats.culledInstances += node.count[i];
+                } else if (inside[i] || node.child[i] == LEAF){
+                    visible.insert(visible.end(), items.begin() + node.first[i], items.begin() + node.first[i] + node.count[i]);
+                    stats.visibleInstances += node.count[i];
+                } else {
+                    stack.push_back(static_cast<uint32_t>(node.child[i]));
+                }
+            }
+        }
+        stats.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    size_t NodeCount() const{
+        return nodes.size();
+    }
+private:
+    static constexpr int32_t LEAF = -1;
+    static constexpr int32_t EMPTY = -2;
+
+    struct alignas(16) Node
+    {
+        float minX[4], minY[4], minZ[4];
+        float maxX[4], maxY[4], maxZ[4];
+        int32_t child[4];  // node index, LEAF or EMPTY
+        uint32_t first[4]; // range of items covered by the child's whole subtree
+        uint32_t count[4];
+    };
+    std::vector<Node> nodes;
+    std::vector<uint32_t> items; // instance indices, grouped so every subtree is a range
+    std::vector<glm::vec3> centroids;
+    std::vector<uint32_t> stack;
+
+    static Aabb NodeBounds(const Node& node){
+        Aabb box = { glm::vec3(FLT_MAX), glm::vec3(-FLT_MAX) };
+        for (int i = 0; i < 4; i++){
+            box.min = glm::min(box.min, glm::vec3(node.minX[i], node.minY[i], node.minZ[i]));
+            box.max = glm::max(box.max, glm::vec3(node.maxX[i], node.maxY[i], node.maxZ[i]));
+        }
+        return box;
+    }
+    // Splits items[first, first + count) at the median centroid of its longest axis.
+    uint32_t SplitMedian(uint32_t first, uint32_t count){
+        glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+        for (uint32_t i = first; i < first + count; i++){
+            lo = glm::min(lo, centroids[items[i]]);
+            hi = glm::max(hi, centroids[items[i]]);
+        }
+        glm::vec3 extent = hi - lo;
+        int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+        uint32_t half = count / 2;
+        std::nth_element(items.begin() + first, items.begin() + first + half, items.begin() + first + count,
+                         [&](uint32_t a, uint32_t b){ return centroids[a][axis] < centroids[b][axis]; });
+        return half;
+    }
+    uint32_t BuildNode(uint32_t first, uint32_t count){
+        // split the largest range until there are four or all fit in a leaf
+        uint32_t rangeFirst[4] = { first }, rangeCount[4] = { count };
+        int ranges = 1;
+        while (ranges < 4){
+            int largest = 0;
+            for (int i = 1; i < ranges; i++){
+                largest = rangeCount[i] > rangeCount[largest] ? i : largest;
+            }
+            if (rangeCount[largest] <= LEAF_SIZE){
+                break;
+            }
+            uint32_t half = SplitMedian(rangeFirst[largest], rangeCount[largest]);
+            rangeFirst[ranges] = rangeFirst[largest] + half;
+            rangeCount[ranges] = rangeCount[largest] - half;
+            rangeCount[largest] = half;
+            ranges++;
+        }
+        uint32_t index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+        for (int i = 0; i < 4; i++){
+            // children are built first and assigned after: emplace_back may move nodes
+            int32_t child = i >= ranges ? EMPTY : rangeCount[i] <= LEAF_SIZE ? LEAF : static_cast<int32_t>(BuildNode(rangeFirst[i], rangeCount[i]));
+            nodes[index].child[i] = child;
+            nodes[index].first[i] = i < ranges ? rangeFirst[i] : 0;
+            nodes[index].count[i] = i < ranges ? rangeCount[i] : 0;
+        }
+        return index;
+    }
+};
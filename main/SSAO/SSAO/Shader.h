@@ -25,6 +25,16 @@ public:
         CompileShaderFromFile(fragmentPath, GL_FRAGMENT_SHADER);
         LinkShaderProgram();
     }
+    // compute-only program; needs a GL 4.3 context
+    explicit Shader(const char* computePath){
+        shaderProgram = glCreateProgram();
+        if (shaderProgram == 0){
+            std::cout <<"ERROR Creating Shader Program!" << std::endl;
+            exit(-1);
+        }
+        CompileShaderFromFile(computePath, GL_COMPUTE_SHADER);
+        LinkShaderProgram();
+    }
     ~Shader(){
         glDeleteProgram(shaderProgram);
     }
@@ -37,6 +47,9 @@ public:
     void SetFloat(const std::string &name, float value) const {
         glUniform1f(glGetUniformLocation(shaderProgram, name.c_str()), value);
     }
+    void SetFloatv(const std::string &name, int count, const float* value) const{
+        glUniform1fv(glGetUniformLocation(shaderProgram, name.c_str()), count, value);
+    }
     void SetVec2f(const std::string& name, glm::vec2 value){
         glUniform2f(glGetUniformLocation(shaderProgram, name.c_str()), value.x, value.y);
     }
@@ -46,6 +59,9 @@ public:
     void SetVec3fv(const std::string& name, int count, const glm::vec3* value){
         glUniform3fv(glGetUniformLocation(shaderProgram, name.c_str()), count, glm::value_ptr(value[0]));
     }
+    void SetVec4fv(const std::string& name, int count, const glm::vec4* value){
+        glUniform4fv(glGetUniformLocation(shaderProgram, name.c_str()), count, glm::value_ptr(value[0]));
+    }
     void SetMatrix4fv(const std::string& name, glm::mat4 matrix) const{
         glUniformMatrix4fv(glGetUniformLocation(shaderProgram, name.c_str()), 1, GL_FALSE, glm::value_ptr(matrix));
     }
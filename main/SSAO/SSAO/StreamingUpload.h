@@ -0,0 +1,63 @@
+#pragma once
+#include <GL/glew.h>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+// Copies a block of CPU memory into a GL buffer over several frames. Begin() allocates the
+// storage, and each Step() maps and fills slices until its time budget is spent. Nothing
+// draws from the buffer before the upload completes, so the mapping is unsynchronized and
+// never waits on the GPU. Uploads go through GL_COPY_WRITE_BUFFER, which keeps them off the
+// bound VAO's element buffer binding.
+class StreamingUpload{
+public:
+    static constexpr size_t SLICE_BYTES = 256 * 1024;
+
+    void Begin(GLuint buffer, const void* data, size_t size){
+        BeginRange(buffer, 0, data, size);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(size), NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    // Uploads into [offset, offset + size) of a buffer that already has its storage, such as
+    // a range sub-allocated from the GeometryBuffer; the range must not be drawn meanwhile.
+    void BeginRange(GLuint buffer, size_t offset, const void* data, size_t size){
+        this->buffer = buffer;
+        this->offset = offset;
+        this->data = static_cast<const unsigned char*>(data);
+        this->size = size;
+        uploaded = 0;
+    }
+    // Uploads slices until done or the budget is exhausted; returns true once complete.
+    // At least one slice is written per call so progress is guaranteed.
+    bool Step(double budgetSeconds){
+        if (Done()){
+            return true;
+        }
+        auto start = std::chrono::steady_clock::now();
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+        do {
+            size_t bytes = std::min(SLICE_BYTES, size - uploaded);
+            void* dst = glMapBufferRange(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(offset + uploaded), static_cast<GLsizeiptr>(bytes),
+                                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            if (dst != NULL){
+                memcpy(dst, data + uploaded, bytes);
+                glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            } else {
+                glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(offset + uploaded), static_cast<GLsizeiptr>(bytes), data + uploaded);
+            }
+            uploaded += bytes;
+        } while (!Done() && std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < budgetSeconds);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return Done();
+    }
+    bool Done() const{
+        return uploaded >= size;
+    }
+private:
+    GLuint buffer = 0;
+    size_t offset = 0;
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+    size_t uploaded = 0;
+};
@@ -0,0 +1,398 @@
+#pragma once
+#include <GL/glew.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <utility>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include "glm/glm.hpp"
+#include "Shader.h"
+#include "Meshlets.h"
+#include "SOIL2/stb_image.h" // stbi_load_16, compiled into SOIL2.c
+
+// Heightfield terrain built from 16-bit grayscale tiles (PNG/PGM, read with the stb_image
+// copy inside SOIL2). Tile (x, z) covers [x - 0.5, x + 0.5) * tileSize on each axis, so tile
+// (0, 0) is centered on the origin; a path pattern with two %d is filled with x and z,
+// a plain path is the single tile (0, 0). Tiles within LOAD_RADIUS tiles of the camera are
+// decoded on a loader thread and uploaded as R16 textures, farther ones are dropped again.
+//
+// Each tile is cut into chunks of CHUNK_QUADS texels. All chunks share one patch mesh per
+// LOD (a grid with a skirt ring, LOD l has CHUNK_QUADS >> l quads per side) and terrain.vs
+// fetches the heights, so a chunk is one draw with a few uniforms. Chunks are frustum
+// culled on their height bounds and pick their LOD from the distance to the camera: LOD l is
+// used out to 2^(l+1) chunk widths. Vertices geomorph towards the next LOD from MORPH_START of
+// that distance on, so levels blend instead of popping, and the skirts hide the cracks that
+// remain where neighbouring chunks differ. Beyond the loaded
+// ring nothing is drawn, so the triangle count is bounded however many tiles exist.
+class Terrain{
+public:
+    static constexpr int CHUNK_QUADS = 64;
+    static constexpr int LOD_COUNT = 5; // 64 down to 4 quads per side
+    static constexpr int LOAD_RADIUS = 1; // tiles around the camera's tile: 3x3 loaded
+    static constexpr float MORPH_START = 0.7f; // of a LOD's outer distance
+
+    struct Stats
+    {
+        uint32_t residentTiles = 0;
+        uint32_t drawnChunks = 0;
+        uint32_t culledChunks = 0;
+        uint64_t triangles = 0;
+    };
+
+    ~Terrain(){
+        Close();
+    }
+    // tileSize and heightScale are in world units; heights span [baseHeight, baseHeight +
+    // heightScale].
+    bool Create(const char* pathPattern, float tileSize, float heightScale, float baseHeight){
+        pattern = pathPattern;
+        tiled = CountFormats(pathPattern) == 2;
+        this->tileSize = tileSize;
+        this->heightScale = heightScale;
+        this->baseHeight = baseHeight;
+        shader.reset(new Shader("res/shaders/terrain.vs", "res/shaders/ssao_geometry.fs"));
+        shader->UseProgram();
+        shader->SetInt("heights", 0);
+        CreatePatches();
+        quit = false;
+        loader = std::thread(&Terrain::LoaderThread, this);
+        return true;
+    }
+    void Close(){
+        if (!loader.joinable()){
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+        loader.join();
+    }
+    bool IsEnabled() const{
+        return shader != nullptr;
+    }
+    // Requests the tiles around the camera, uploads at most one decoded tile and frees
+    // tiles that fell out of range. Call once per frame.
+    void Update(glm::vec3 cameraPosition){
+        int cameraX = static_cast<int>(std::floor(cameraPosition.x / tileSize + 0.5f));
+        int cameraZ = static_cast<int>(std::floor(cameraPosition.z / tileSize + 0.5f));
+        std::vector<Request> requests;
+        if (!tiled && tiles.empty()){
+            tiles[{ 0, 0 }] = Tile();
+            requests.push_back({ 0, 0, pattern });
+        }
+        for (int z = cameraZ - LOAD_RADIUS; z <= cameraZ + LOAD_RADIUS; z++){
+            for (int x = cameraX - LOAD_RADIUS; x <= cameraX + LOAD_RADIUS; x++){
+                if (tiled && tiles.find({ x, z }) == tiles.end()){
+                    tiles[{ x, z }] = Tile();
+                    requests.push_back({ x, z, TilePath(x, z) });
+                }
+            }
+        }
+        // one ring of slack so walking along a tile border does not reload tiles
+        for (auto it = tiles.begin(); tiled && it != tiles.end();){
+            if (std::abs(it->first.first - cameraX) > LOAD_RADIUS + 1 || std::abs(it->first.second - cameraZ) > LOAD_RADIUS + 1){
+                if (it->second.status == Status::Loading){
+                    ++it; // the loader still owns it; dropped once it arrives
+                    continue;
+                }
+                glDeleteTextures(1, &it->second.texture);
+                it = tiles.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        std::vector<Decoded> arrived;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.insert(queue.end(), requests.begin(), requests.end());
+            if (!decoded.empty()){
+                // one tile per frame keeps the texture upload out of the frame time
+                arrived.push_back(std::move(decoded.front()));
+                decoded.erase(decoded.begin());
+            }
+        }
+        if (!requests.empty()){
+            wake.notify_one();
+        }
+        for (Decoded& tile : arrived){
+            Upload(tile);
+        }
+        stats.residentTiles = 0;
+        for (const auto& entry : tiles){
+            stats.residentTiles += entry.second.status == Status::Resident ? 1 : 0;
+        }
+    }
+    // Draws every visible chunk into the bound framebuffer with its own shader.
+    void Render(const glm::mat4& view, const glm::mat4& projection, glm::vec3 cameraPosition, glm::vec3 albedo){
+        stats.drawnChunks = stats.culledChunks = 0;
+        stats.triangles = 0;
+        glm::vec4 planes[6];
+        Meshlets::ExtractFrustum(projection * view, planes);
+        shader->UseProgram();
+        shader->SetMatrix4fv("view", view);
+        shader->SetMatrix4fv("projection", projection);
+        shader->SetVec3f("albedo", albedo);
+        shader->SetVec3f("cameraPosition", cameraPosition);
+        shader->SetFloat("heightScale", heightScale);
+        shader->SetFloat("baseHeight", baseHeight);
+        glActiveTexture(GL_TEXTURE0);
+        glBindVertexArray(vao);
+        for (const auto& entry : tiles){
+            const Tile& tile = entry.second;
+            if (tile.status != Status::Resident){
+                continue;
+            }
+            float texelSize = tileSize / static_cast<float>(tile.quads);
+            // LOD 0 reaches two chunk widths out, so neighbouring chunks differ by one level
+            float lodDistance = CHUNK_QUADS * texelSize;
+            glm::vec2 origin = (glm::vec2(entry.first.first, entry.first.second) - 0.5f) * tileSize;
+            glBindTexture(GL_TEXTURE_2D, tile.texture);
+            shader->SetVec2f("tileOrigin", origin);
+            shader->SetFloat("texelSize", texelSize);
+            shader->SetInt("tileQuads", tile.quads);
+            for (int cz = 0; cz < tile.chunks; cz++){
+                for (int cx = 0; cx < tile.chunks; cx++){
+                    const glm::vec2& range = tile.chunkHeights[cz * tile.chunks + cx];
+                    glm::vec3 lo(origin.x + cx * CHUNK_QUADS * texelSize, baseHeight + range.x * heightScale, origin.y + cz * CHUNK_QUADS * texelSize);
+                    glm::vec3 hi(std::min(lo.x + CHUNK_QUADS * texelSize, origin.x + tileSize), baseHeight + range.y * heightScale,
+                                 std::min(lo.z + CHUNK_QUADS * texelSize, origin.y + tileSize));
+                    // no LOD can open a crack deeper than the chunk's height range
+                    float skirtDepth = hi.y - lo.y + texelSize;
+                    lo.y -= skirtDepth;
+                    if (!BoxInFrustum(planes, lo, hi)){
+                        stats.culledChunks++;
+                        continue;
+                    }
+                    glm::vec3 nearest = glm::clamp(cameraPosition, lo, hi);
+                    float distance = glm::length(nearest - cameraPosition);
+                    int lod = 0;
+                    while (lod + 1 < LOD_COUNT && distance >= lodDistance * static_cast<float>(2 << lod)){
+                        lod++;
+                    }
+                    float morphEnd = lodDistance * static_cast<float>(2 << lod);
+                    shader->SetVec2f("chunkOrigin", glm::vec2(cx * CHUNK_QUADS, cz * CHUNK_QUADS));
+                    shader->SetFloat("gridQuads", static_cast<float>(CHUNK_QUADS >> lod));
+                    shader->SetFloat("skirtDepth", skirtDepth);
+                    // the coarsest LOD has nothing to morph to
+                    shader->SetVec2f("morphRange", lod + 1 < LOD_COUNT ? glm::vec2(morphEnd * MORPH_START, morphEnd) : glm::vec2(1e30f, 2e30f));
+                    const Patch& patch = patches[lod];
+                    glDrawElementsBaseVertex(GL_TRIANGLES, patch.indexCount, GL_UNSIGNED_SHORT,
+                                             (GLvoid*)(patch.firstIndex * sizeof(GLushort)), patch.baseVertex);
+                    stats.drawnChunks++;
+                    stats.triangles += patch.indexCount / 3;
+                }
+            }
+        }
+        glBindVertexArray(0);
+    }
+    const Stats& GetStats() const{
+        return stats;
+    }
+private:
+    enum class Status
+    {
+        Loading,
+        Resident,
+        Missing // no file or not a 16-bit grayscale image; not retried
+    };
+    struct Tile
+    {
+        Status status = Status::Loading;
+        GLuint texture = 0;
+        int quads = 0;  // texels - 1 per side
+        int chunks = 0; // per side
+        std::vector<glm::vec2> chunkHeights; // normalized min/max of each chunk
+    };
+    struct Request
+    {
+        int x, z;
+        std::string path;
+    };
+    struct Decoded
+    {
+        int x, z;
+        int size = 0; // texels per side; 0 if the file could not be used
+        std::vector<uint16_t> heights;
+        std::vector<glm::vec2> chunkHeights;
+    };
+    struct Patch
+    {
+        GLint baseVertex;
+        GLuint firstIndex;
+        GLsizei indexCount;
+    };
+
+    std::string pattern;
+    bool tiled = false;
+    float tileSize = 64.0f, heightScale = 8.0f, baseHeight = 0.0f;
+    std::unique_ptr<Shader> shader;
+    GLuint vao = 0, vbo = 0, ebo = 0;
+    Patch patches[LOD_COUNT];
+    std::map<std::pair<int, int>, Tile> tiles;
+    Stats stats;
+
+    // shared with the loader thread, guarded by mutex
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<Request> queue;
+    std::vector<Decoded> decoded;
+    bool quit = false;
+    std::thread loader;
+
+    static int CountFormats(const char* path){
+        int count = 0;
+        for (const char* c = strstr(path, "%d"); c != nullptr; c = strstr(c + 2, "%d")){
+            count++;
+        }
+        return count;
+    }
+    std::string TilePath(int x, int z) const{
+        char path[1024];
+        snprintf(path, sizeof(path), pattern.c_str(), x, z);
+        return path;
+    }
+    static bool BoxInFrustum(const glm::vec4 planes[6], glm::vec3 lo, glm::vec3 hi){
+        for (int p = 0; p < 6; p++){
+            glm::vec3 n = glm::vec3(planes[p]);
+            // corner farthest along the plane normal
+            glm::vec3 corner(n.x >= 0.0f ? hi.x : lo.x, n.y >= 0.0f ? hi.y : lo.y, n.z >= 0.0f ? hi.z : lo.z);
+            if (glm::dot(n, corner) + planes[p].w < 0.0f){
+                return false;
+            }
+        }
+        return true;
+    }
+    // One grid per LOD in [0, 1]^2 (x, z) with y = 1 on the skirt ring, all in one VBO/IBO.
+    void CreatePatches(){
+        std::vector<glm::vec3> vertices;
+        std::vector<GLushort> indices;
+        for (int lod = 0; lod < LOD_COUNT; lod++){
+            int quads = CHUNK_QUADS >> lod;
+            int side = quads + 1;
+            patches[lod].baseVertex = static_cast<GLint>(vertices.size());
+            patches[lod].firstIndex = static_cast<GLuint>(indices.size());
+            for (int z = 0; z <= quads; z++){
+                for (int x = 0; x <= quads; x++){
+                    vertices.push_back(glm::vec3(x / static_cast<float>(quads), 0.0f, z / static_cast<float>(quads)));
+                }
+            }
+            for (int z = 0; z < quads; z++){
+                for (int x = 0; x < quads; x++){
+                    GLushort a = static_cast<GLushort>(z * side + x), b = a + 1, c = a + side, d = c + 1;
+                    indices.insert(indices.end(), { a, c, b, b, c, d });
+                }
+            }
+            // skirt: the border walked counter-clockwise, each vertex dropped by skirtDepth
+            std::vector<int> border;
+            for (int x = 0; x < quads; x++) border.push_back(x);
+            for (int z = 0; z < quads; z++) border.push_back(z * side + quads);
+            for (int x = quads; x > 0; x--) border.push_back(quads * side + x);
+            for (int z = quads; z > 0; z--) border.push_back(z * side);
+            GLushort skirt = static_cast<GLushort>(side * side);
+            for (int v : border){
+                glm::vec3 top = vertices[patches[lod].baseVertex + v];
+                vertices.push_back(glm::vec3(top.x, 1.0f, top.z));
+            }
+            for (size_t i = 0; i < border.size(); i++){
+                size_t j = (i + 1) % border.size();
+                GLushort a = static_cast<GLushort>(border[i]), b = static_cast<GLushort>(border[j]);
+                GLushort c = static_cast<GLushort>(skirt + i), d = static_cast<GLushort>(skirt + j);
+                indices.insert(indices.end(), { a, b, c, b, d, c });
+            }
+            patches[lod].indexCount = static_cast<GLsizei>(indices.size() - patches[lod].firstIndex);
+        }
+        glGenVertexArrays(1, &vao);
+        glGenBuffers(1, &vbo);
+        glGenBuffers(1, &ebo);
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), vertices.data(), GL_STATIC_DRAW);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (GLvoid*)0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
+        glBindVertexArray(0);
+    }
+    void Upload(Decoded& decodedTile){
+        auto it = tiles.find({ decodedTile.x, decodedTile.z });
+        if (it == tiles.end()){
+            return;
+        }
+        Tile& tile = it->second;
+        if (decodedTile.size == 0){
+            tile.status = Status::Missing;
+            return;
+        }
+        glGenTextures(1, &tile.texture);
+        glBindTexture(GL_TEXTURE_2D, tile.texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 2);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R16, decodedTile.size, decodedTile.size, 0, GL_RED, GL_UNSIGNED_SHORT, decodedTile.heights.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        tile.quads = decodedTile.size - 1;
+        tile.chunks = (tile.quads + CHUNK_QUADS - 1) / CHUNK_QUADS;
+        tile.chunkHeights = std::move(decodedTile.chunkHeights);
+        tile.status = Status::Resident;
+    }
+    // Decodes requested tiles and computes their chunk height bounds. Missing files are
+    // expected at the edge of a tiled world and reported only for the single-tile form.
+    void LoaderThread(){
+        for (;;){
+            Request request;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]{ return quit || !queue.empty(); });
+                if (quit){
+                    return;
+                }
+                request = queue.front();
+                queue.erase(queue.begin());
+            }
+            Decoded tile;
+            tile.x = request.x;
+            tile.z = request.z;
+            int width = 0, height = 0, channels = 0;
+            stbi_us* pixels = stbi_load_16(request.path.c_str(), &width, &height, &channels, 1);
+            if (pixels != nullptr && width == height && width >= 2){
+                tile.size = width;
+                tile.heights.assign(pixels, pixels + static_cast<size_t>(width) * height);
+                int quads = width - 1, chunks = (quads + CHUNK_QUADS - 1) / CHUNK_QUADS;
+                tile.chunkHeights.resize(static_cast<size_t>(chunks) * chunks);
+                for (int cz = 0; cz < chunks; cz++){
+                    for (int cx = 0; cx < chunks; cx++){
+                        uint16_t lo = 0xFFFF, hi = 0;
+                        for (int z = cz * CHUNK_QUADS; z <= std::min((cz + 1) * CHUNK_QUADS, quads); z++){
+                            for (int x = cx * CHUNK_QUADS; x <= std::min((cx + 1) * CHUNK_QUADS, quads); x++){
+                                lo = std::min(lo, tile.heights[z * width + x]);
+                                hi = std::max(hi, tile.heights[z * width + x]);
+                            }
+                        }
+                        tile.chunkHeights[cz * chunks + cx] = glm::vec2(lo, hi) / 65535.0f;
+                    }
+                }
+            } else if (!tiled){
+                std::cout << "Failed to load terrain heights " << request.path << ": "
+                          << (pixels == nullptr ? stbi_failure_reason() : "tiles must be square") << std::endl;
+            }
+            stbi_image_free(pixels);
+            std::lock_guard<std::mutex> lock(mutex);
+            decoded.push_back(std::move(tile));
+        }
+    }
+};
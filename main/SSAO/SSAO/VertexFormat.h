@@ -0,0 +1,122 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "glm/glm.hpp"
+#include "Mesh.h"
+
+// GPU vertex layouts for the geometry pass.
+//  Float:   position, color, normal as 9 floats (36 bytes)
+//  Compact: position as 3 x unorm16 against the mesh AABB + 2 bytes padding, normal packed
+//           as snorm 2_10_10_10 (12 bytes). Color comes from the per-draw "albedo" uniform.
+// ssao_geometry.vs decodes both with the same code: normalized attributes arrive in [0,1]
+// and [-1,1], and positionOffset/positionScale undo the quantization (0 and 1 for Float).
+enum class VertexFormat : uint32_t
+{
+    Float = 0,
+    Compact = 1
+};
+
+struct CompactVertex
+{
+    uint16_t position[4];
+    uint32_t normal;
+};
+static_assert(sizeof(CompactVertex) == 12, "compact vertex must stay 12 bytes");
+
+struct Quantization
+{
+    glm::vec3 offset = glm::vec3(0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+};
+
+// Encoded vertex buffer contents, ready for glBufferData.
+struct VertexStream
+{
+    VertexFormat format = VertexFormat::Float;
+    uint32_t stride = 0;
+    uint32_t count = 0;
+    Quantization quantization;
+    std::vector<unsigned char> bytes;
+};
+
+inline uint32_t VertexStride(VertexFormat format)
+{
+    return format == VertexFormat::Compact ? sizeof(CompactVertex) : 9 * sizeof(float);
+}
+
+inline const char* VertexFormatName(VertexFormat format)
+{
+    return format == VertexFormat::Compact ? "compact" : "float";
+}
+
+// snorm 10-bit per component, w = 0 (GL_INT_2_10_10_10_REV)
+inline uint32_t PackNormal(glm::vec3 n)
+{
+    uint32_t packed = 0;
+    for (int i = 0; i < 3; i++) {
+        int32_t c = static_cast<int32_t>(glm::round(glm::clamp(n[i], -1.0f, 1.0f) * 511.0f));
+        packed |= (static_cast<uint32_t>(c) & 0x3FFu) << (10 * i);
+    }
+    return packed;
+}
+
+inline glm::vec3 UnpackNormal(uint32_t packed)
+{
+    glm::vec3 n;
+    for (int i = 0; i < 3; i++) {
+        int32_t c = static_cast<int32_t>((packed >> (10 * i)) & 0x3FFu);
+        c = c >= 512 ? c - 1024 : c;
+        n[i] = glm::max(static_cast<float>(c) / 511.0f, -1.0f);
+    }
+    return n;
+}
+
+// Position quantization grid spanning the AABB of the given floats (stride in floats).
+inline Quantization ComputeQuantization(const float* vertices, size_t count, size_t stride)
+{
+    Quantization q;
+    if (count == 0) {
+        return q;
+    }
+    glm::vec3 lo(vertices[0], vertices[1], vertices[2]), hi = lo;
+    for (size_t i = 1; i < count; i++) {
+        glm::vec3 p(vertices[i * stride], vertices[i * stride + 1], vertices[i * stride + 2]);
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    q.offset = lo;
+    q.scale = hi - lo;
+    return q;
+}
+
+inline CompactVertex EncodeCompact(const float* v, const Quantization& q)
+{
+    CompactVertex out;
+    for (int i = 0; i < 3; i++) {
+        float t = q.scale[i] > 0.0f ? (v[i] - q.offset[i]) / q.scale[i] : 0.0f;
+        out.position[i] = static_cast<uint16_t>(glm::round(glm::clamp(t, 0.0f, 1.0f) * 65535.0f));
+    }
+    out.position[3] = 0;
+    out.normal = PackNormal(glm::vec3(v[6], v[7], v[8]));
+    return out;
+}
+
+// Converts a Float-layout mesh (9 floats per vertex) into the requested GPU layout.
+inline void EncodeVertices(const Mesh& mesh, VertexFormat format, VertexStream& out)
+{
+    out.format = format;
+    out.stride = VertexStride(format);
+    out.count = mesh.VertexCount();
+    out.quantization = Quantization();
+    out.bytes.resize(static_cast<size_t>(out.count) * out.stride);
+    if (format == VertexFormat::Float) {
+        memcpy(out.bytes.data(), mesh.vertices.data(), out.bytes.size());
+        return;
+    }
+    out.quantization = ComputeQuantization(mesh.vertices.data(), out.count, mesh.floatsPerVertex);
+    CompactVertex* dst = reinterpret_cast<CompactVertex*>(out.bytes.data());
+    for (uint32_t i = 0; i < out.count; i++) {
+        dst[i] = EncodeCompact(&mesh.vertices[static_cast<size_t>(i) * mesh.floatsPerVertex], out.quantization);
+    }
+}
@@ -1,7 +1,11 @@
 #define GLM_ENABLE_EXPERIMENTAL
 
 #include <iostream>
+#include <string>
 #include <random>
+#include <thread>
+#include <atomic>
+#include <chrono>
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include "Shader.h"
@@ -10,6 +14,17 @@
 #include "glm/gtc/type_ptr.hpp"
 #include "Camera.h"
 #include "glm/gtx/rotate_vector.hpp"
+#include "MeshAsset.h"
+#include "MeshPipeline.h"
+#include "GltfModel.h"
+#include "StreamingUpload.h"
+#include "SceneBvh.h"
+#include "HiZ.h"
+#include "GpuCulling.h"
+#include "GeometryBuffer.h"
+#include "ClusterStreamer.h"
+#include "Terrain.h"
+#include "Benchmark.h"
 
 #define ERROR_LOG(ErrorMessage) glfwTerminate(); std::cout << ErrorMessage << std::endl; return -1;
 
@@ -29,132 +44,330 @@ void MouseCallback(GLFWwindow * window, double xPos, double yPos);
 void ScrollCallback(GLFWwindow *window, double xOffset, double yOffset);
 
 // geometry
-static GLuint modelVAO = 0, modelVBO = 0;
-static int modelVertexCount = 0;
-static GLuint floorVAO = 0, floorVBO = 0;
-
-// quad
-static GLuint quadVAO = 0, quadVBO = 0;
+static const char* modelPath = "res/models/dragon.obj"; // --model: .obj, .ply or .glb
+static GltfModel gltfModel; // used instead of the mesh pipeline for .glb models
+static GeometryBuffer geometry; // vertices and indices of the floor and the model, one VAO
+static GeometryBuffer::Allocation modelGeometry;
+static int modelIndexCount = 0;
+static GLenum modelIndexType = GL_UNSIGNED_INT;
+static Quantization modelQuantization;
+static std::vector<MeshLod> modelLods;
+static glm::vec3 modelBoundsCenter = glm::vec3(0.0f);
+static float modelBoundsRadius = 0.0f;
+// build settings shared with the offline MeshCompiler: --float-vertices, --lod-ratios, --low-memory,
+// --compress-mesh
+static MeshPipeline::Options pipelineOptions;
+static float lodPixelError = 1.0f; // --lod-error: allowed projected error in pixels
+static std::vector<Meshlet> modelMeshlets;
+static bool clusterCulling = true; // toggled with C
+static Meshlets::CullStats clusterStats;
+static StreamingUpload modelVertexUpload, modelIndexUpload;
+static double uploadBudgetMs = 2.0; // --upload-budget: max milliseconds of model upload per frame
+static int gridSize = 1; // --grid: N x N dragons
+static std::vector<glm::mat4> modelInstances;
+static GLuint modelInstanceVBO = 0;
+static bool instancing = true; // toggled with I; off draws every dragon with its own call
+static SceneBvh instanceBvh; // over the world AABBs of modelInstances
+static std::vector<Aabb> instanceBounds;
+static std::vector<uint32_t> visibleInstances; // survivors of this frame's BVH cull
+static SceneBvh::CullStats instanceCullStats;
+static bool animateInstances = false; // toggled with M; bobs the dragons to exercise refits
+static HiZPyramid hiZ; // max-depth pyramid of the previous geometry pass
+static bool occlusionCulling = true; // toggled with O
+static uint32_t occlusionCulledInstances = 0; // accumulated for the --grid report
+static GpuCulling gpuCulling; // compute culling + one indirect multi-draw, GL 4.3 only
+static bool gpuCullingSupported = false;
+static bool gpuDriven = true; // toggled with G; falls back to CPU submission without GL 4.3
+static bool gpuInstancesDirty = true; // modelInstances changed since the last upload
+static int geometryDrawCalls = 0;
+static bool benchSubmission = false; // --bench-submission
+static const char* outOfCorePath = nullptr; // --out-of-core: cluster hierarchy to stream instead of the model
+static size_t gpuBudgetMB = 256; // --gpu-budget: geometry memory for --out-of-core
+static ClusterStreamer clusterStreamer;
+static const char* terrainPath = nullptr; // --terrain: 16-bit heightmap, or a pattern with two %d for tiles
+static float terrainTileSize = 64.0f; // --terrain-tile-size: world units per tile
+static float terrainHeight = 8.0f; // --terrain-height: world units of the full 16-bit range
+static Terrain terrain; // replaces the floor quad when --terrain is given
+static GeometryBuffer::Allocation floorGeometry;
+static Quantization floorQuantization;
+static const glm::vec3 modelAlbedo = glm::vec3(0.9f);
+static const glm::vec3 floorAlbedo = glm::vec3(0.8f);
 
 // buffers
-static GLuint gBuffer = 0, gPosition = 0, gNormal = 0, gAlbedo = 0, rboDepth = 0;
+static GLuint gBuffer = 0, gPosition = 0, gNormal = 0, gAlbedo = 0, gDepth = 0;
 static GLuint ssaoFBO = 0, ssaoBlurFBO = 0;
 static GLuint ssaoColorBuffer = 0, ssaoColorBufferBlur = 0, noiseTexture = 0;
 
 // ssao data
 static std::vector<glm::vec3> ssaoKernel;
+static std::vector<glm::vec3> ssaoNoise; // the 4x4 rotation tile, row by row
+static int ssaoDivisor = 1; // --ssao-resolution: 1 full, 2 half, 4 quarter; cycled with R
+static bool ssaoDeinterleaved = false; // --ssao-deinterleaved, toggled with T; hemisphere kernel only
+enum class SsaoTechnique { Hemisphere, Hbao, Gtao, Count };
+static SsaoTechnique ssaoTechnique = SsaoTechnique::Hemisphere; // --ssao-technique, cycled with H
+static bool ssaoMultiBounce = true; // GTAO only; --ssao-single-bounce turns it off, toggled with B
+static float ssaoRadius = 0.5f; // --ssao-radius: world units
+static const float SSAO_MAX_RADIUS_SCREEN = 1.0f / 6.0f; // projected radius limit, fraction of the screen height
+
+// linear depth pyramid for the direct AO pass: view-space z of the G-buffer, then halved per
+// level so far taps read small levels
+static const GLint SSAO_DEPTH_MIPS = 6;
+static GLint ssaoDepthMipCount = 0;
+static GLuint ssaoDepthMips = 0;
+static GLuint ssaoDepthMipFBOs[SSAO_DEPTH_MIPS] = {};
+static GLsizei ssaoDepthMipWidth[SSAO_DEPTH_MIPS] = {}, ssaoDepthMipHeight[SSAO_DEPTH_MIPS] = {};
+static bool benchSsao = false; // --bench-ssao
+
+// reduced-resolution SSAO: G-buffer downsampled to ssaoWidth x ssaoHeight, AO and blur at
+// that size, then upsampled into ssaoColorBufferBlur; made for ssaoTargetDivisor
+static int ssaoTargetDivisor = 0;
+static GLsizei ssaoWidth = 0, ssaoHeight = 0;
+static GLuint ssaoDownsampleFBO = 0, ssaoLowPosition = 0, ssaoLowNormal = 0;
+static GLuint ssaoLowFBO = 0, ssaoLowBuffer = 0, ssaoLowBlurFBO = 0, ssaoLowBlurBuffer = 0;
 
-// Simple OBJ loader
-static bool LoadOBJ(const char* path, std::vector<GLfloat>& outVertexData)
+// deinterleaved SSAO: the AO input split into 4x4 layers of ssaoLayerWidth x ssaoLayerHeight
+// (normal and depth) and the AO of each layer, both 2D arrays of 16 layers
+static const GLint SSAO_LAYERS = 16;
+static GLsizei ssaoLayerWidth = 0, ssaoLayerHeight = 0;
+static GLuint ssaoLayerInput = 0, ssaoLayerAO = 0;
+static GLuint ssaoDeinterleaveFBOs[2] = {}, ssaoLayerFBOs[SSAO_LAYERS] = {};
+
+// Attribute setup for the currently bound VAO/VBO; see VertexFormat.h for both layouts.
+static void SetupVertexAttributes(VertexFormat format)
 {
-    std::vector<glm::vec3> temp_vertices;
-    std::vector<glm::vec3> temp_normals;
-    std::vector<unsigned int> vertexIndices, normalIndices;
+    if (format == VertexFormat::Compact) {
+        // Position attribute: unorm16 against the mesh AABB
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactVertex), (GLvoid*)0);
+        
+        // Normal attribute: snorm 2_10_10_10
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(CompactVertex), (GLvoid*)offsetof(CompactVertex, normal));
+        return;
+    }
+    
+    // Position attribute
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*)0);
     
-    std::ifstream file(path);
-    if (!file.is_open()) {
-        std::cout << "Failed to open OBJ file: " << path << std::endl;
+    // Color attribute (unused by the shader, kept so the layout matches the original 36 bytes)
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
+    
+    // Normal attribute
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
+}
+
+// Per-instance model matrix at locations 3-6, read from the bound GL_ARRAY_BUFFER starting at
+// byte offset first and advanced once per instance. Enables them; draws of the shared
+// geometry VAO without instance data disable them again to read the identity instead.
+static void SetupInstanceAttributes(GLintptr first)
+{
+    for (GLuint column = 0; column < 4; column++) {
+        glEnableVertexAttribArray(3 + column);
+        glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (GLvoid*)(first + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(3 + column, 1);
+    }
+}
+
+// CPU-side model data ready for upload, filled in on the loader thread. The pointers refer
+// either to the mapped mesh cache or to the vectors built from the OBJ (or decoded from a
+// compressed cache).
+struct ModelData
+{
+    MappedFile cache;
+    VertexStream vertices;
+    std::vector<unsigned char> indices;
+    const void* vertexData = nullptr;
+    size_t vertexBytes = 0;
+    const void* indexData = nullptr;
+    int indexCount = 0;
+    int indexSize = 4;
+    Quantization quantization;
+    std::vector<MeshLod> lods;
+    std::vector<Meshlet> meshlets;
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
+};
+
+// Runs on the loader thread; must not touch GL.
+static bool LoadModel(ModelData& data)
+{
+    // glTF assets are drawn as authored, straight from their buffer views
+    if (MeshPipeline::HasExtension(modelPath, ".glb")) {
+        return gltfModel.Load(modelPath);
+    }
+    
+    MeshAsset::SourceStamp stamp;
+    if (!MeshAsset::StampSource(modelPath, stamp)) {
+        std::cout << "Failed to load dragon model!" << std::endl;
         return false;
     }
+    stamp.settings = MeshPipeline::SettingsHash(pipelineOptions);
     
-    std::string line;
-    while (std::getline(file, line)) {
-        std::istringstream iss(line);
-        std::string prefix;
-        iss >> prefix;
-        
-        if (prefix == "v") {
-            glm::vec3 vertex;
-            iss >> vertex.x >> vertex.y >> vertex.z;
-            temp_vertices.push_back(vertex);
-        }
-        else if (prefix == "vn") {
-            glm::vec3 normal;
-            iss >> normal.x >> normal.y >> normal.z;
-            temp_normals.push_back(normal);
-        }
-        else if (prefix == "f") {
-            std::string vertex1, vertex2, vertex3;
-            unsigned int vertexIndex[3], textureIndex[3], normalIndex[3];
-            
-            iss >> vertex1 >> vertex2 >> vertex3;
-            
-            // Parse f v/vt/vn format
-            sscanf(vertex1.c_str(), "%d/%d/%d", &vertexIndex[0], &textureIndex[0], &normalIndex[0]);
-            sscanf(vertex2.c_str(), "%d/%d/%d", &vertexIndex[1], &textureIndex[1], &normalIndex[1]);
-            sscanf(vertex3.c_str(), "%d/%d/%d", &vertexIndex[2], &textureIndex[2], &normalIndex[2]);
-            
-            vertexIndices.push_back(vertexIndex[0]);
-            vertexIndices.push_back(vertexIndex[1]);
-            vertexIndices.push_back(vertexIndex[2]);
-            normalIndices.push_back(normalIndex[0]);
-            normalIndices.push_back(normalIndex[1]);
-            normalIndices.push_back(normalIndex[2]);
+    // Fast path: map the binary cache and upload straight from the mapping
+    std::string cachePath = MeshAsset::CachePath(modelPath, pipelineOptions.format);
+    const MeshAsset::Header* header = MeshAsset::Open(cachePath.c_str(), stamp, pipelineOptions.format, data.cache);
+    if (header != nullptr) {
+        std::cout << "Loaded " << cachePath << ": " << header->indexCount / 3 << " triangles, "
+                  << header->vertexCount << " " << VertexFormatName(pipelineOptions.format) << " vertices ("
+                  << header->vertexBytes / 1024 << " KB)" << std::endl;
+        data.vertexData = MeshAsset::VertexData(header);
+        data.vertexBytes = header->vertexBytes;
+        data.indexData = MeshAsset::IndexData(header);
+        if (MeshAsset::IsCompressed(header)) {
+            // compressed cache: decode into memory instead of uploading from the mapping
+            auto decodeStart = std::chrono::steady_clock::now();
+            if (!MeshAsset::Decode(header, data.vertices.bytes, data.indices)) {
+                std::cout << "Corrupt mesh cache: " << cachePath << std::endl;
+                return false;
+            }
+            double seconds = Benchmark::SecondsSince(decodeStart);
+            std::cout << "Decoded " << (header->vertexBytes + header->indexBytes) / 1024 << " KB -> "
+                      << (data.vertices.bytes.size() + data.indices.size()) / 1024 << " KB in " << seconds * 1000.0 << " ms" << std::endl;
+            data.vertexData = data.vertices.bytes.data();
+            data.vertexBytes = data.vertices.bytes.size();
+            data.indexData = data.indices.data();
         }
+        data.indexCount = static_cast<int>(header->indexCount);
+        data.indexSize = static_cast<int>(header->indexSize);
+        data.quantization = MeshAsset::GetQuantization(header);
+        data.lods.assign(header->lods, header->lods + header->lodCount);
+        data.meshlets.assign(MeshAsset::MeshletData(header), MeshAsset::MeshletData(header) + header->meshletCount);
+        data.boundsCenter = glm::vec3(header->boundsCenter[0], header->boundsCenter[1], header->boundsCenter[2]);
+        data.boundsRadius = header->boundsRadius;
+        std::cout << "Peak RSS after load: " << Benchmark::PeakResidentBytes() / (1024 * 1024) << " MB" << std::endl;
+        return true;
     }
     
-    file.close();
-    
-    // Build vertex data with white color
-    outVertexData.clear();
-    for (size_t i = 0; i < vertexIndices.size(); i++) {
-        glm::vec3 vertex = temp_vertices[vertexIndices[i] - 1];
-        glm::vec3 normal = temp_normals[normalIndices[i] - 1];
-        
-        // Position
-        outVertexData.push_back(vertex.x);
-        outVertexData.push_back(vertex.y);
-        outVertexData.push_back(vertex.z);
-        
-        // Color (white)
-        outVertexData.push_back(0.9f);
-        outVertexData.push_back(0.9f);
-        outVertexData.push_back(0.9f);
-        
-        // Normal
-        outVertexData.push_back(normal.x);
-        outVertexData.push_back(normal.y);
-        outVertexData.push_back(normal.z);
+    Mesh mesh;
+    if (!MeshPipeline::Load(modelPath, mesh, pipelineOptions)) {
+        std::cout << "Failed to load dragon model!" << std::endl;
+        return false;
     }
+    MeshPipeline::Process(mesh, pipelineOptions);
+    mesh.ComputeBounds(data.boundsCenter, data.boundsRadius);
     
+    EncodeVertices(mesh, pipelineOptions.format, data.vertices);
+    std::cout << "Vertex format " << VertexFormatName(pipelineOptions.format) << ": " << data.vertices.stride << " bytes/vertex, "
+              << data.vertices.bytes.size() / 1024 << " KB" << std::endl;
+    MeshAsset::Write(cachePath.c_str(), stamp, data.vertices, mesh, pipelineOptions.compress);
+    // drop each CPU copy as soon as its encoded form exists
+    uint32_t indexSize = mesh.IndexSize();
+    mesh.vertices = std::vector<float>();
+    data.indices.resize(mesh.indices.size() * indexSize);
+    PackIndices(mesh.indices.data(), mesh.indices.size(), indexSize, data.indices.data());
+    data.indexCount = static_cast<int>(mesh.IndexCount());
+    data.indexSize = static_cast<int>(indexSize);
+    mesh.indices = std::vector<uint32_t>();
+    data.vertexData = data.vertices.bytes.data();
+    data.vertexBytes = data.vertices.bytes.size();
+    data.indexData = data.indices.data();
+    data.quantization = data.vertices.quantization;
+    data.lods = mesh.lods;
+    data.meshlets = mesh.meshlets;
+    std::cout << "Peak RSS after load: " << Benchmark::PeakResidentBytes() / (1024 * 1024) << " MB" << std::endl;
     return true;
 }
 
-static void LoadModel()
+// Allocates the model buffers and VAO; the data itself arrives through StepModelUpload.
+static void BeginModelUpload(const ModelData& data)
 {
-    std::vector<GLfloat> vertexData;
-    
-    if (!LoadOBJ("res/models/dragon.obj", vertexData)) {
-        std::cout << "Failed to load dragon model!" << std::endl;
+    if (gltfModel.IsLoaded()) {
+        gltfModel.BeginUpload();
         return;
     }
+    modelIndexCount = data.indexCount;
+    modelIndexType = data.indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    modelQuantization = data.quantization;
+    modelBoundsCenter = data.boundsCenter;
+    modelBoundsRadius = data.boundsRadius;
     
-    modelVertexCount = static_cast<int>(vertexData.size() / 9); // 9 floats per vertex (pos + color + normal)
-    
-    glGenVertexArrays(1, &modelVAO);
-    glGenBuffers(1, &modelVBO);
-    glBindVertexArray(modelVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, modelVBO);
-    glBufferData(GL_ARRAY_BUFFER, vertexData.size() * sizeof(GLfloat), vertexData.data(), GL_STATIC_DRAW);
-    
-    // Position attribute
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*)0);
-    
-    // Color attribute
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
-    
-    // Normal attribute
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
-    
+    // allocate first: growing the geometry buffer replaces it, the uploads keep the name
+    size_t indexBytes = static_cast<size_t>(data.indexCount) * data.indexSize;
+    modelGeometry = geometry.Allocate(static_cast<uint32_t>(data.vertexBytes / VertexStride(pipelineOptions.format)), indexBytes);
+    modelVertexUpload.BeginRange(geometry.VertexBuffer(), geometry.VertexOffset(modelGeometry), data.vertexData, data.vertexBytes);
+    modelIndexUpload.BeginRange(geometry.IndexBuffer(), geometry.IndexOffset(modelGeometry), data.indexData, indexBytes);
+}
+
+// The shared geometry VAO, with the instance matrices (disabled until an instanced draw) and
+// the GPU-driven instance IDs next to the vertex attributes.
+static void CreateGeometryBuffer()
+{
+    geometry.Create(pipelineOptions.format, SetupVertexAttributes, 64 * 1024, 256 * 1024);
+    geometry.Bind();
+    glGenBuffers(1, &modelInstanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, modelInstanceVBO);
+    SetupInstanceAttributes(0);
+    for (GLuint column = 0; column < 4; column++) {
+        glDisableVertexAttribArray(3 + column);
+    }
+    if (gpuCullingSupported) {
+        gpuCulling.SetupInstanceIdAttribute();
+    }
     glBindVertexArray(0);
 }
 
+// World AABB of every instance's bounding sphere.
+static void UpdateInstanceBounds()
+{
+    instanceBounds.resize(modelInstances.size());
+    for (size_t i = 0; i < modelInstances.size(); i++) {
+        const glm::mat4& model = modelInstances[i];
+        float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        glm::vec3 center = glm::vec3(model * glm::vec4(modelBoundsCenter, 1.0f));
+        glm::vec3 radius = glm::vec3(modelBoundsRadius * scale);
+        instanceBounds[i] = { center - radius, center + radius };
+    }
+}
+
+// Lays the dragons out on a gridSize x gridSize grid centered where the single dragon stands,
+// one bounding diameter (plus a gap) apart.
+static void BuildModelInstances()
+{
+    const float scale = 0.5f;
+    float spacing = glm::max(modelBoundsRadius * scale * 2.2f, 0.01f);
+    float half = 0.5f * static_cast<float>(gridSize - 1);
+    modelInstances.clear();
+    for (int z = 0; z < gridSize; z++) {
+        for (int x = 0; x < gridSize; x++) {
+            glm::vec3 offset = glm::vec3((x - half) * spacing, 0.0f, (z - half) * spacing);
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -1.0f) + offset);
+            modelInstances.push_back(glm::scale(model, glm::vec3(scale)));
+        }
+    }
+    UpdateInstanceBounds();
+    instanceBvh.Build(instanceBounds);
+    gpuInstancesDirty = true;
+}
+
+// Uploads the next slices within the per-frame budget. Once both buffers are complete the
+// model becomes drawable (RenderGeometry skips it while modelLods is empty).
+static bool StepModelUpload(const ModelData& data, double budgetSeconds)
+{
+    if (!gltfModel.GetAsset().instances.empty()) {
+        return gltfModel.StepUpload(budgetSeconds);
+    }
+    auto start = std::chrono::steady_clock::now();
+    bool done = modelVertexUpload.Step(budgetSeconds);
+    double spent = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    done = modelIndexUpload.Step(std::max(budgetSeconds - spent, 0.0)) && done;
+    if (done) {
+        modelLods = data.lods;
+        modelMeshlets = data.meshlets;
+        BuildModelInstances();
+        if (gpuCullingSupported) {
+            gpuCulling.SetMesh(modelLods, modelBoundsCenter, modelBoundsRadius);
+        }
+    }
+    return done;
+}
+
 static void CreateFloor()
 {
-    GLfloat floorVertices[] = {
+    Mesh floor;
+    floor.vertices = {
         // Position            Color              Normal
         -5.0f, -0.5f, -5.0f,  0.8f, 0.8f, 0.8f,  0.0f, 1.0f, 0.0f,
          5.0f, -0.5f, -5.0f,  0.8f, 0.8f, 0.8f,  0.0f, 1.0f, 0.0f,
@@ -163,50 +376,20 @@ static void CreateFloor()
         -5.0f, -0.5f,  5.0f,  0.8f, 0.8f, 0.8f,  0.0f, 1.0f, 0.0f,
         -5.0f, -0.5f, -5.0f,  0.8f, 0.8f, 0.8f,  0.0f, 1.0f, 0.0f
     };
+    VertexStream floorVertices;
+    EncodeVertices(floor, pipelineOptions.format, floorVertices);
+    floorQuantization = floorVertices.quantization;
     
-    glGenVertexArrays(1, &floorVAO);
-    glGenBuffers(1, &floorVBO);
-    glBindVertexArray(floorVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, floorVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(floorVertices), floorVertices, GL_STATIC_DRAW);
-    
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (GLvoid*)(6 * sizeof(GLfloat)));
-    
-    glBindVertexArray(0);
-}
-
-static void CreateQuad()
-{
-    if (quadVAO != 0) return;
-    GLfloat quadVertices[] = {
-        -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-        -1.0f, -1.0f, 0.0f, 0.0f, 0.0f,
-         1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-        -1.0f,  1.0f, 0.0f, 0.0f, 1.0f,
-         1.0f, -1.0f, 0.0f, 1.0f, 0.0f,
-         1.0f,  1.0f, 0.0f, 1.0f, 1.0f
-    };
-    glGenVertexArrays(1, &quadVAO);
-    glGenBuffers(1, &quadVBO);
-    glBindVertexArray(quadVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (GLvoid*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat)));
-    glBindVertexArray(0);
+    floorGeometry = geometry.Allocate(6, 0);
+    geometry.Upload(floorGeometry, floorVertices.bytes.data(), floorVertices.bytes.size(), NULL, 0);
 }
 
+// Fullscreen triangle generated in ssao_quad.vs from gl_VertexID; the geometry VAO is bound
+// only because core profile draws need one, none of its attributes are read.
 static void RenderQuad()
 {
-    glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    geometry.Bind();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
     glBindVertexArray(0);
 }
 
@@ -236,10 +419,13 @@ static void SetupGBuffer()
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gAlbedo, 0);
 
-    glGenRenderbuffers(1, &rboDepth);
-    glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, screenWidth, screenHeight);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
+    // depth is a texture rather than a renderbuffer so the Hi-Z pyramid can be built from it
+    glGenTextures(1, &gDepth);
+    glBindTexture(GL_TEXTURE_2D, gDepth);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, screenWidth, screenHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gDepth, 0);
 
     GLuint attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
     glDrawBuffers(3, attachments);
@@ -278,7 +464,7 @@ static void SetupSSAO()
         ssaoKernel.push_back(sample);
     }
 
-    std::vector<glm::vec3> ssaoNoise;
+    ssaoNoise.clear();
     for (GLuint i = 0; i < 16; i++)
     {
         glm::vec3 noise(randomFloats(generator) * 2.0f - 1.0f,
@@ -319,6 +505,334 @@ static void SetupSSAO()
     {
         std::cout << "SSAO Blur FBO incomplete" << std::endl;
     }
+
+    ssaoDepthMipCount = 0;
+    for (GLsizei w = screenWidth, h = screenHeight; ssaoDepthMipCount < SSAO_DEPTH_MIPS; w = (w + 1) / 2, h = (h + 1) / 2) {
+        ssaoDepthMipWidth[ssaoDepthMipCount] = w;
+        ssaoDepthMipHeight[ssaoDepthMipCount] = h;
+        ssaoDepthMipCount++;
+        if (w == 1 && h == 1) {
+            break;
+        }
+    }
+    glGenTextures(1, &ssaoDepthMips);
+    glBindTexture(GL_TEXTURE_2D, ssaoDepthMips);
+    for (GLint level = 0; level < ssaoDepthMipCount; level++) {
+        glTexImage2D(GL_TEXTURE_2D, level, GL_R32F, ssaoDepthMipWidth[level], ssaoDepthMipHeight[level], 0, GL_RED, GL_FLOAT, NULL);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, ssaoDepthMipCount - 1);
+    glGenFramebuffers(ssaoDepthMipCount, ssaoDepthMipFBOs);
+    for (GLint level = 0; level < ssaoDepthMipCount; level++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, ssaoDepthMipFBOs[level]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ssaoDepthMips, level);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "SSAO depth mip FBO incomplete" << std::endl;
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+static GLuint CreateTargetTexture(GLint internalFormat, GLenum format, GLsizei width, GLsizei height)
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    return texture;
+}
+
+// (Re)creates the reduced-resolution targets for ssaoDivisor. The full-resolution
+// ssaoColorBufferBlur stays the output either way, so lighting does not change.
+static void SetupReducedSSAO()
+{
+    if (ssaoTargetDivisor == ssaoDivisor) {
+        return;
+    }
+    if (ssaoTargetDivisor != 0) {
+        GLuint textures[4] = { ssaoLowPosition, ssaoLowNormal, ssaoLowBuffer, ssaoLowBlurBuffer };
+        GLuint framebuffers[3] = { ssaoDownsampleFBO, ssaoLowFBO, ssaoLowBlurFBO };
+        glDeleteTextures(4, textures);
+        glDeleteFramebuffers(3, framebuffers);
+    }
+    ssaoTargetDivisor = ssaoDivisor;
+    ssaoWidth = (screenWidth + ssaoDivisor - 1) / ssaoDivisor;
+    ssaoHeight = (screenHeight + ssaoDivisor - 1) / ssaoDivisor;
+
+    glGenFramebuffers(1, &ssaoDownsampleFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, ssaoDownsampleFBO);
+    ssaoLowPosition = CreateTargetTexture(GL_RGBA16F, GL_RGBA, ssaoWidth, ssaoHeight);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ssaoLowPosition, 0);
+    ssaoLowNormal = CreateTargetTexture(GL_RGBA16F, GL_RGBA, ssaoWidth, ssaoHeight);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, ssaoLowNormal, 0);
+    GLuint attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, attachments);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cout << "SSAO downsample FBO incomplete" << std::endl;
+    }
+
+    glGenFramebuffers(1, &ssaoLowFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, ssaoLowFBO);
+    ssaoLowBuffer = CreateTargetTexture(GL_RED, GL_RED, ssaoWidth, ssaoHeight);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ssaoLowBuffer, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cout << "SSAO low-resolution FBO incomplete" << std::endl;
+    }
+
+    glGenFramebuffers(1, &ssaoLowBlurFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, ssaoLowBlurFBO);
+    ssaoLowBlurBuffer = CreateTargetTexture(GL_RED, GL_RED, ssaoWidth, ssaoHeight);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, ssaoLowBlurBuffer, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        std::cout << "SSAO low-resolution blur FBO incomplete" << std::endl;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// (Re)creates the 4x4 layers for an AO input of width x height.
+static void SetupDeinterleavedSSAO(GLsizei width, GLsizei height)
+{
+    GLsizei layerWidth = (width + 3) / 4, layerHeight = (height + 3) / 4;
+    if (layerWidth == ssaoLayerWidth && layerHeight == ssaoLayerHeight) {
+        return;
+    }
+    if (ssaoLayerInput != 0) {
+        GLuint textures[2] = { ssaoLayerInput, ssaoLayerAO };
+        glDeleteTextures(2, textures);
+        glDeleteFramebuffers(2, ssaoDeinterleaveFBOs);
+        glDeleteFramebuffers(SSAO_LAYERS, ssaoLayerFBOs);
+    }
+    ssaoLayerWidth = layerWidth;
+    ssaoLayerHeight = layerHeight;
+
+    GLuint* textures[2] = { &ssaoLayerInput, &ssaoLayerAO };
+    GLint formats[2] = { GL_RGBA16F, GL_RED };
+    for (int i = 0; i < 2; i++) {
+        glGenTextures(1, textures[i]);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, *textures[i]);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, formats[i], layerWidth, layerHeight, SSAO_LAYERS, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    // GL 3.3 guarantees 8 draw buffers, so the split takes two passes of 8 layers
+    glGenFramebuffers(2, ssaoDeinterleaveFBOs);
+    GLuint attachments[8];
+    for (GLint pass = 0; pass < 2; pass++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, ssaoDeinterleaveFBOs[pass]);
+        for (GLint i = 0; i < 8; i++) {
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, ssaoLayerInput, 0, pass * 8 + i);
+            attachments[i] = GL_COLOR_ATTACHMENT0 + i;
+        }
+        glDrawBuffers(8, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "SSAO deinterleave FBO incomplete" << std::endl;
+        }
+    }
+    glGenFramebuffers(SSAO_LAYERS, ssaoLayerFBOs);
+    for (GLint layer = 0; layer < SSAO_LAYERS; layer++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, ssaoLayerFBOs[layer]);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, ssaoLayerAO, 0, layer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "SSAO layer FBO incomplete" << std::endl;
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+static bool SsaoDeinterleaved()
+{
+    return ssaoDeinterleaved && ssaoTechnique == SsaoTechnique::Hemisphere;
+}
+
+static const char* SsaoTechniqueName(SsaoTechnique technique)
+{
+    return technique == SsaoTechnique::Gtao ? "GTAO" : technique == SsaoTechnique::Hbao ? "HBAO" : "hemisphere";
+}
+
+static std::string SsaoModeName()
+{
+    std::string name = std::string(SsaoTechniqueName(ssaoTechnique)) + ", "
+                     + (ssaoDivisor == 4 ? "quarter resolution" : ssaoDivisor == 2 ? "half resolution" : "full resolution");
+    if (ssaoTechnique == SsaoTechnique::Gtao && ssaoMultiBounce) {
+        name += ", multi-bounce";
+    }
+    return SsaoDeinterleaved() ? name + ", deinterleaved" : name;
+}
+
+struct SsaoShaders
+{
+    Shader& depthMips;
+    Shader& ao;
+    Shader& hbao;
+    Shader& gtao;
+    Shader& blur;
+    Shader& downsample;
+    Shader& upsample;
+    Shader& deinterleave;
+    Shader& aoLayer;
+    Shader& reinterleave;
+};
+
+// Fills ssaoDepthMips from the G-buffer; leaves the viewport at level 0's size.
+static void BuildSsaoDepthMips(Shader& shader)
+{
+    shader.UseProgram();
+    glActiveTexture(GL_TEXTURE0);
+    for (GLint level = 0; level < ssaoDepthMipCount; level++) {
+        shader.SetInt("level", level);
+        if (level == 0) {
+            glBindTexture(GL_TEXTURE_2D, gPosition);
+        } else {
+            // sample only the previous level while rendering into this one
+            glBindTexture(GL_TEXTURE_2D, ssaoDepthMips);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, ssaoDepthMipFBOs[level]);
+        glViewport(0, 0, ssaoDepthMipWidth[level], ssaoDepthMipHeight[level]);
+        RenderQuad();
+    }
+    glBindTexture(GL_TEXTURE_2D, ssaoDepthMips);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, ssaoDepthMipCount - 1);
+    glViewport(0, 0, ssaoDepthMipWidth[0], ssaoDepthMipHeight[0]);
+}
+
+// The AO pass over the 4x4 split of its input: split, AO per layer with that layer's one
+// noise rotation, and reassembled into target, which is width x height like the input.
+static void RenderDeinterleavedAO(const SsaoShaders& shaders, const glm::mat4& projection, GLuint position, GLuint normal,
+                                  GLsizei width, GLsizei height, GLuint target)
+{
+    SetupDeinterleavedSSAO(width, height);
+    glViewport(0, 0, ssaoLayerWidth, ssaoLayerHeight);
+    shaders.deinterleave.UseProgram();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, position);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, normal);
+    for (GLint pass = 0; pass < 2; pass++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, ssaoDeinterleaveFBOs[pass]);
+        shaders.deinterleave.SetInt("firstLayer", pass * 8);
+        RenderQuad();
+    }
+
+    shaders.aoLayer.UseProgram();
+    shaders.aoLayer.SetMatrix4fv("projection", projection);
+    shaders.aoLayer.SetVec3fv("samples", 64, &ssaoKernel[0]);
+    shaders.aoLayer.SetFloat("radius", ssaoRadius);
+    // imageSize is the AO input, so the limit is in its pixels, not the screen's
+    shaders.aoLayer.SetFloat("maxRadiusPixels", SSAO_MAX_RADIUS_SCREEN * height);
+    shaders.aoLayer.SetVec2f("imageSize", glm::vec2(width, height));
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, ssaoLayerInput);
+    for (GLint layer = 0; layer < SSAO_LAYERS; layer++) {
+        glBindFramebuffer(GL_FRAMEBUFFER, ssaoLayerFBOs[layer]);
+        shaders.aoLayer.SetInt("layer", layer);
+        shaders.aoLayer.SetVec3f("rotation", glm::normalize(ssaoNoise[layer]));
+        RenderQuad();
+    }
+
+    glViewport(0, 0, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+    shaders.reinterleave.UseProgram();
+    glBindTexture(GL_TEXTURE_2D_ARRAY, ssaoLayerAO);
+    RenderQuad();
+}
+
+// AO into ssaoColorBufferBlur at full resolution, or at 1/ssaoDivisor: the G-buffer is
+// downsampled to the closest surface per block, AO and blur run on that, and a joint
+// bilateral upsample guided by the full-resolution depth and normals brings it back.
+// Either way the hemisphere kernel can run deinterleaved; otherwise the AO pass, hemisphere,
+// HBAO or GTAO, reads its taps from the linear depth pyramid, which is built first.
+static void RenderSSAO(const SsaoShaders& shaders, const glm::mat4& projection)
+{
+    bool reduced = ssaoDivisor > 1;
+    bool deinterleaved = SsaoDeinterleaved();
+    if (!deinterleaved) {
+        BuildSsaoDepthMips(shaders.depthMips);
+    }
+    if (reduced) {
+        SetupReducedSSAO();
+        glViewport(0, 0, ssaoWidth, ssaoHeight);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, ssaoDownsampleFBO);
+        shaders.downsample.UseProgram();
+        shaders.downsample.SetInt("divisor", ssaoDivisor);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, gPosition);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, gNormal);
+        RenderQuad();
+    }
+    GLsizei width = reduced ? ssaoWidth : screenWidth, height = reduced ? ssaoHeight : screenHeight;
+
+    // ssao pass
+    GLuint position = reduced ? ssaoLowPosition : gPosition, normal = reduced ? ssaoLowNormal : gNormal;
+    if (deinterleaved) {
+        RenderDeinterleavedAO(shaders, projection, position, normal, width, height, reduced ? ssaoLowFBO : ssaoFBO);
+    } else {
+        glBindFramebuffer(GL_FRAMEBUFFER, reduced ? ssaoLowFBO : ssaoFBO);
+        glClear(GL_COLOR_BUFFER_BIT);
+        Shader& ao = ssaoTechnique == SsaoTechnique::Gtao ? shaders.gtao : ssaoTechnique == SsaoTechnique::Hbao ? shaders.hbao : shaders.ao;
+        ao.UseProgram();
+        ao.SetMatrix4fv("projection", projection);
+        if (ssaoTechnique == SsaoTechnique::Hemisphere) {
+            ao.SetVec3fv("samples", 64, &ssaoKernel[0]);
+        }
+        ao.SetVec2f("noiseScale", glm::vec2(width / 4.0f, height / 4.0f));
+        ao.SetFloat("radius", ssaoRadius);
+        ao.SetFloat("maxRadiusPixels", SSAO_MAX_RADIUS_SCREEN * screenHeight);
+        ao.SetInt("depthMipCount", ssaoDepthMipCount);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, position);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, normal);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, noiseTexture);
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, ssaoDepthMips);
+        RenderQuad();
+    }
+
+    // blur pass
+    glBindFramebuffer(GL_FRAMEBUFFER, reduced ? ssaoLowBlurFBO : ssaoBlurFBO);
+    glClear(GL_COLOR_BUFFER_BIT);
+    shaders.blur.UseProgram();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, reduced ? ssaoLowBuffer : ssaoColorBuffer);
+    RenderQuad();
+
+    if (reduced) {
+        glViewport(0, 0, screenWidth, screenHeight);
+        glBindFramebuffer(GL_FRAMEBUFFER, ssaoBlurFBO);
+        shaders.upsample.UseProgram();
+        shaders.upsample.SetInt("divisor", ssaoDivisor);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, gPosition);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, gNormal);
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, ssaoLowPosition);
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, ssaoLowNormal);
+        glActiveTexture(GL_TEXTURE4);
+        glBindTexture(GL_TEXTURE_2D, ssaoLowBlurBuffer);
+        RenderQuad();
+    }
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
@@ -328,39 +842,342 @@ static void SetViewport(GLFWwindow* window)
     glViewport(0, 0, screenWidth, screenHeight);
 }
 
+// Coarsest LOD whose geometric error projects to at most lodPixelError pixels, measured at
+// the point of the bounding sphere closest to the camera.
+static int SelectLod(const glm::mat4& model, const glm::mat4& view, const glm::mat4& projection)
+{
+    float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+    glm::vec3 center = glm::vec3(view * model * glm::vec4(modelBoundsCenter, 1.0f));
+    float distance = glm::max(glm::length(center) - modelBoundsRadius * scale, 0.1f);
+    float pixelsPerUnit = projection[1][1] * 0.5f * static_cast<float>(screenHeight) / distance;
+    int selected = 0;
+    for (size_t i = 1; i < modelLods.size(); i++) {
+        if (modelLods[i].error * scale * pixelsPerUnit <= lodPixelError) {
+            selected = static_cast<int>(i);
+        }
+    }
+    return selected;
+}
+
+// GPU-driven submission applies to instanced grids; a lone dragon keeps the meshlet-culled
+// path, which the compute pass does not replace.
+static bool GpuDriven()
+{
+    return gpuCullingSupported && gpuDriven && instancing && modelInstances.size() > 1;
+}
+
+static const char* SubmissionName()
+{
+    return GpuDriven() ? "GPU-driven" : instancing ? "instanced" : "one draw each";
+}
+
+// Moves the instances if animated (refitting the BVH) and collects the ones inside the
+// view frustum and not hidden in the last Hi-Z readback into visibleInstances for
+// RenderGeometry. The GPU-driven path only needs the instances uploaded; it culls in
+// RenderGeometry.
+static void CullInstances(const glm::mat4& view, const glm::mat4& projection, float time)
+{
+    visibleInstances.clear();
+    if (modelLods.empty()) {
+        return;
+    }
+    if (animateInstances) {
+        for (size_t i = 0; i < modelInstances.size(); i++) {
+            modelInstances[i][3].y = 0.25f * glm::sin(2.0f * time + 0.7f * static_cast<float>(i));
+        }
+        UpdateInstanceBounds();
+        instanceBvh.Refit(instanceBounds);
+        gpuInstancesDirty = true;
+    }
+    if (GpuDriven()) {
+        if (gpuInstancesDirty) {
+            gpuCulling.UploadInstances(modelInstances);
+            gpuInstancesDirty = false;
+        }
+        return;
+    }
+    glm::vec4 planes[6];
+    Meshlets::ExtractFrustum(projection * view, planes);
+    instanceBvh.Cull(planes, visibleInstances, instanceCullStats);
+
+    hiZ.Poll();
+    if (occlusionCulling && hiZ.Matches(view)) {
+        size_t kept = 0;
+        for (uint32_t instance : visibleInstances) {
+            if (!hiZ.IsOccluded(instanceBounds[instance])) {
+                visibleInstances[kept++] = instance;
+            }
+        }
+        occlusionCulledInstances += static_cast<uint32_t>(visibleInstances.size() - kept);
+        visibleInstances.resize(kept);
+    }
+}
+
 static void RenderGeometry(Shader &shader, const glm::mat4& view, const glm::mat4& projection)
 {
+    // Render the terrain chunks with their own shader, or else the floor
+    if (terrain.IsEnabled()) {
+        terrain.Render(view, projection, camera.GetPosition(), floorAlbedo);
+        geometryDrawCalls += static_cast<int>(terrain.GetStats().drawnChunks);
+    }
     shader.UseProgram();
     shader.SetMatrix4fv("view", view);
     shader.SetMatrix4fv("projection", projection);
 
-    // Render the floor
-    glBindVertexArray(floorVAO);
+    geometry.Bind();
     glm::mat4 model = glm::mat4(1.0f);
     shader.SetMatrix4fv("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    glBindVertexArray(0);
+    if (!terrain.IsEnabled()) {
+        shader.SetVec3f("albedo", floorAlbedo);
+        shader.SetVec3f("positionOffset", floorQuantization.offset);
+        shader.SetVec3f("positionScale", floorQuantization.scale);
+        glDrawArrays(GL_TRIANGLES, geometry.BaseVertex(floorGeometry), 6);
+    }
 
-    // Render the dragon model (no rotation)
-    glBindVertexArray(modelVAO);
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(0.0f, 0.0f, -1.0f));
-    model = glm::scale(model, glm::vec3(0.5f, 0.5f, 0.5f));
-    shader.SetMatrix4fv("model", model);
-    glDrawArrays(GL_TRIANGLES, 0, modelVertexCount);
+    // glTF scene: scaled to a unit radius and stood on the floor where the dragon would be
+    if (gltfModel.Ready()) {
+        const Gltf::Asset& asset = gltfModel.GetAsset();
+        glm::vec3 extent = asset.boundsMax - asset.boundsMin;
+        float scale = 1.0f / glm::max(0.5f * glm::length(extent), 1e-6f);
+        glm::vec3 base = glm::vec3(0.5f * (asset.boundsMin.x + asset.boundsMax.x), asset.boundsMin.y, 0.5f * (asset.boundsMin.z + asset.boundsMax.z));
+        model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.5f, -1.0f));
+        model = glm::scale(model, glm::vec3(scale));
+        model = glm::translate(model, -base);
+        shader.SetVec3f("albedo", modelAlbedo);
+        glBindVertexArray(0);
+        gltfModel.Render(shader, model);
+        return;
+    }
+
+    // streamed scan: scaled and placed like the glTF scene, cut chosen by projected error
+    if (clusterStreamer.IsOpen()) {
+        glm::vec3 boundsMin = clusterStreamer.BoundsMin(), boundsMax = clusterStreamer.BoundsMax();
+        float scale = 1.0f / glm::max(0.5f * glm::length(boundsMax - boundsMin), 1e-6f);
+        glm::vec3 base = glm::vec3(0.5f * (boundsMin.x + boundsMax.x), boundsMin.y, 0.5f * (boundsMin.z + boundsMax.z));
+        model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -0.5f, -1.0f));
+        model = glm::scale(model, glm::vec3(scale));
+        model = glm::translate(model, -base);
+        shader.SetVec3f("albedo", modelAlbedo);
+        clusterStreamer.Select(model, view, projection, screenHeight, lodPixelError);
+        clusterStreamer.Draw(shader, model);
+        geometryDrawCalls += static_cast<int>(clusterStreamer.GetStats().drawnNodes);
+        return;
+    }
+
+    // Render the dragon instances (no rotation)
+    if (modelLods.empty()) {
+        glBindVertexArray(0);
+        return;
+    }
+    shader.SetMatrix4fv("model", glm::mat4(1.0f));
+    shader.SetVec3f("albedo", modelAlbedo);
+    shader.SetVec3f("positionOffset", modelQuantization.offset);
+    shader.SetVec3f("positionScale", modelQuantization.scale);
+    GLsizeiptr indexSize = modelIndexType == GL_UNSIGNED_SHORT ? 2 : 4;
+    // where the model sits in the geometry buffer; LOD and meshlet offsets are relative to it
+    GLint baseVertex = geometry.BaseVertex(modelGeometry);
+    GLintptr indexStart = geometry.IndexOffset(modelGeometry);
+
+    if (GpuDriven()) {
+        // cull, select LODs and draw every dragon with one dispatch and one indirect call;
+        // the compute pass reads the Hi-Z pyramid of the previous frame straight from the GPU
+        bool occlusion = occlusionCulling && hiZ.BuiltMatches(view);
+        gpuCulling.Cull(view, projection, screenHeight, lodPixelError, occlusion ? &hiZ : nullptr,
+                        baseVertex, static_cast<GLuint>(indexStart / indexSize));
+        gpuCulling.Draw(view, projection, modelAlbedo, modelQuantization, modelIndexType);
+        geometryDrawCalls++;
+        glBindVertexArray(0);
+        return;
+    }
+
+    if (!instancing) {
+        // reference path: one draw and one model upload per dragon
+        for (uint32_t visible : visibleInstances) {
+            const glm::mat4& instance = modelInstances[visible];
+            const MeshLod& lod = modelLods[SelectLod(instance, view, projection)];
+            shader.SetMatrix4fv("model", instance);
+            glDrawElementsBaseVertex(GL_TRIANGLES, lod.indexCount, modelIndexType, (GLvoid*)(indexStart + lod.indexOffset * indexSize), baseVertex);
+            geometryDrawCalls++;
+        }
+        glBindVertexArray(0);
+        return;
+    }
+
+    // bucket the instances by LOD so each LOD is a single instanced draw
+    static std::vector<int> instanceLods;
+    static std::vector<glm::mat4> sortedInstances;
+    uint32_t lodCounts[MAX_LODS] = {};
+    instanceLods.resize(visibleInstances.size());
+    for (size_t i = 0; i < visibleInstances.size(); i++) {
+        instanceLods[i] = SelectLod(modelInstances[visibleInstances[i]], view, projection);
+        lodCounts[instanceLods[i]]++;
+    }
+    uint32_t lodFirst[MAX_LODS], first = 0;
+    for (uint32_t lod = 0; lod < MAX_LODS; lod++) {
+        lodFirst[lod] = first;
+        first += lodCounts[lod];
+    }
+    sortedInstances.resize(visibleInstances.size());
+    for (size_t i = 0; i < visibleInstances.size(); i++) {
+        sortedInstances[lodFirst[instanceLods[i]]++] = modelInstances[visibleInstances[i]];
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, modelInstanceVBO);
+    // orphan last frame's storage rather than wait for the draws still reading it
+    glBufferData(GL_ARRAY_BUFFER, sortedInstances.size() * sizeof(glm::mat4), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sortedInstances.size() * sizeof(glm::mat4), sortedInstances.data());
+
+    uint32_t firstMeshlet = 0, meshletCount = 0;
+    if (modelInstances.size() == 1 && visibleInstances.size() == 1) {
+        Meshlets::FindLodMeshlets(modelMeshlets.data(), modelMeshlets.size(), modelLods[instanceLods[0]], firstMeshlet, meshletCount);
+    }
+    if (clusterCulling && meshletCount != 0) {
+        // a lone dragon: cull its meshlets in object space and draw the surviving index
+        // ranges in one call (non-instanced draws read instance 0)
+        static std::vector<Meshlets::Range> ranges;
+        static std::vector<GLsizei> counts;
+        static std::vector<const GLvoid*> offsets;
+        static std::vector<GLint> baseVertices;
+        const glm::mat4& model = modelInstances[0];
+        glm::vec3 cameraObject = glm::vec3(glm::inverse(view * model)[3]);
+        ranges.clear();
+        clusterStats = Meshlets::CullStats();
+        Meshlets::Cull(&modelMeshlets[firstMeshlet], meshletCount, projection * view * model, cameraObject, ranges, clusterStats);
+        counts.resize(ranges.size());
+        offsets.resize(ranges.size());
+        baseVertices.assign(ranges.size(), baseVertex);
+        for (size_t i = 0; i < ranges.size(); i++) {
+            counts[i] = static_cast<GLsizei>(ranges[i].indexCount);
+            offsets[i] = (const GLvoid*)(indexStart + ranges[i].indexOffset * indexSize);
+        }
+        SetupInstanceAttributes(0);
+        glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), modelIndexType, offsets.data(), static_cast<GLsizei>(ranges.size()), baseVertices.data());
+        geometryDrawCalls++;
+    } else {
+        first = 0;
+        for (uint32_t lod = 0; lod < modelLods.size(); lod++) {
+            if (lodCounts[lod] == 0) {
+                continue;
+            }
+            // GL 3.3 has no base instance, so the attribute pointers start at the bucket
+            SetupInstanceAttributes(first * sizeof(glm::mat4));
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, modelLods[lod].indexCount, modelIndexType,
+                                              (GLvoid*)(indexStart + modelLods[lod].indexOffset * indexSize),
+                                              static_cast<GLsizei>(lodCounts[lod]), baseVertex);
+            geometryDrawCalls++;
+            first += lodCounts[lod];
+        }
+    }
+    for (GLuint column = 0; column < 4; column++) {
+        glDisableVertexAttribArray(3 + column);
+    }
     glBindVertexArray(0);
 }
 
-int main()
+int main(int argc, char* argv[])
 {
+    auto startTime = std::chrono::steady_clock::now();
+    auto millisecondsSinceStart = [&]() {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    };
+
+    // headless benchmark: SSAO --bench-obj [megabytes] [path]
+    if (argc >= 2 && strcmp(argv[1], "--bench-obj") == 0) {
+        size_t megabytes = argc >= 3 ? strtoull(argv[2], NULL, 10) : 2048;
+        const char* path = argc >= 4 ? argv[3] : "/tmp/ssao_bench.obj";
+        return Benchmark::ObjParse(path, megabytes) ? 0 : -1;
+    }
+    // headless benchmark: SSAO --bench-codec [path]
+    if (argc >= 2 && strcmp(argv[1], "--bench-codec") == 0) {
+        return Benchmark::Codec(argc >= 3 ? argv[2] : "/tmp/ssao_codec.obj") ? 0 : -1;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--float-vertices") == 0) {
+            pipelineOptions.format = VertexFormat::Float;
+        }
+        else if (strcmp(argv[i], "--lod-ratios") == 0 && i + 1 < argc) {
+            // comma separated triangle ratios relative to the full mesh, e.g. 0.5,0.25,0.1
+            pipelineOptions.lodRatios.clear();
+            for (char* token = strtok(argv[++i], ","); token != NULL; token = strtok(NULL, ",")) {
+                pipelineOptions.lodRatios.push_back(static_cast<float>(atof(token)));
+            }
+        }
+        else if (strcmp(argv[i], "--lod-error") == 0 && i + 1 < argc) {
+            lodPixelError = static_cast<float>(atof(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--model") == 0 && i + 1 < argc) {
+            modelPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--low-memory") == 0) {
+            pipelineOptions.twoPass = true;
+        }
+        else if (strcmp(argv[i], "--compress-mesh") == 0) {
+            // writes the cache compressed on the next rebuild; compressed caches load either way
+            pipelineOptions.compress = true;
+        }
+        else if (strcmp(argv[i], "--grid") == 0 && i + 1 < argc) {
+            gridSize = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--upload-budget") == 0 && i + 1 < argc) {
+            uploadBudgetMs = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--bench-submission") == 0) {
+            benchSubmission = true;
+        }
+        else if (strcmp(argv[i], "--out-of-core") == 0 && i + 1 < argc) {
+            // a .hlod written by MeshCompiler --hierarchy
+            outOfCorePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--gpu-budget") == 0 && i + 1 < argc) {
+            gpuBudgetMB = static_cast<size_t>(std::max(1, atoi(argv[++i])));
+        }
+        else if (strcmp(argv[i], "--terrain") == 0 && i + 1 < argc) {
+            terrainPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--terrain-tile-size") == 0 && i + 1 < argc) {
+            terrainTileSize = std::max(1.0f, static_cast<float>(atof(argv[++i])));
+        }
+        else if (strcmp(argv[i], "--terrain-height") == 0 && i + 1 < argc) {
+            terrainHeight = static_cast<float>(atof(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--ssao-resolution") == 0 && i + 1 < argc) {
+            // full, half or quarter
+            const char* resolution = argv[++i];
+            ssaoDivisor = strcmp(resolution, "quarter") == 0 ? 4 : strcmp(resolution, "half") == 0 ? 2 : 1;
+        }
+        else if (strcmp(argv[i], "--ssao-deinterleaved") == 0) {
+            ssaoDeinterleaved = true;
+        }
+        else if (strcmp(argv[i], "--ssao-technique") == 0 && i + 1 < argc) {
+            // hemisphere, hbao or gtao
+            const char* technique = argv[++i];
+            ssaoTechnique = strcmp(technique, "gtao") == 0 ? SsaoTechnique::Gtao
+                          : strcmp(technique, "hbao") == 0 ? SsaoTechnique::Hbao : SsaoTechnique::Hemisphere;
+        }
+        else if (strcmp(argv[i], "--ssao-single-bounce") == 0) {
+            ssaoMultiBounce = false;
+        }
+        else if (strcmp(argv[i], "--ssao-radius") == 0 && i + 1 < argc) {
+            ssaoRadius = std::max(0.01f, static_cast<float>(atof(argv[++i])));
+        }
+        else if (strcmp(argv[i], "--bench-ssao") == 0) {
+            benchSsao = true;
+        }
+    }
+
     glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    // ask for 4.3 for the GPU-driven path first; macOS stops at 4.1, so retry with 3.3
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
     GLFWwindow* window = glfwCreateWindow(screenWidth, screenHeight, "Fahim Boss", NULL, NULL);
+    if (window == NULL) {
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        window = glfwCreateWindow(screenWidth, screenHeight, "Fahim Boss", NULL, NULL);
+    }
     if (window == NULL) {ERROR_LOG("Failed to get window")}
     glfwMakeContextCurrent(window);
     glfwSetKeyCallback(window, KeyCallback);
@@ -368,26 +1185,130 @@ int main()
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
     glfwSetScrollCallback(window, ScrollCallback);
     if (GLEW_OK != glewInit()) {ERROR_LOG("Failed to init glew")}
+    gpuCullingSupported = GpuCulling::Supported();
+    if (gpuCullingSupported) {
+        gpuCulling.Create();
+    }
+    std::cout << "GL " << glGetString(GL_VERSION) << ": " << (gpuCullingSupported ? "GPU-driven culling available (G toggles it)"
+              : "no GL 4.3, dragons are culled and submitted on the CPU") << std::endl;
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
 
-    LoadModel();
+    // parse/optimize the model in the background; the floor renders meanwhile. Out of core
+    // there is no model to load: the streamer maps the hierarchy and starts from its root.
+    ModelData modelData;
+    std::atomic<bool> modelLoaded(false);
+    bool modelLoadOk = false, modelUploading = false, modelReady = false;
+    std::thread modelLoader([&]() {
+        modelLoadOk = outOfCorePath == nullptr && LoadModel(modelData);
+        modelLoaded.store(true, std::memory_order_release);
+    });
+    int uploadFrames = 0;
+    double worstUploadMs = 0.0;
+    bool firstFrame = true;
+
+    // geometry pass cost, reported every two seconds for the --grid scaling scene
+    GLuint geometryQueries[2];
+    glGenQueries(2, geometryQueries);
+    int frameIndex = 0, statFrames = 0, statDrawCalls = 0;
+    double statCpuMs = 0.0, statGpuMs = 0.0, statStart = glfwGetTime();
+
+    // --bench-submission: CPU time of culling plus submission, stepping through grid sizes
+    // and every available path (one draw each, instanced, GPU-driven)
+    static const int benchGrids[] = { 8, 32, 64, 128, 256 };
+    const int BENCH_WARMUP = 10, BENCH_FRAMES = 50;
+    const int benchPaths = gpuCullingSupported ? 3 : 2;
+    const int benchSteps = benchPaths * static_cast<int>(sizeof(benchGrids) / sizeof(benchGrids[0]));
+    int benchStep = -1, benchFrames = 0;
+    double benchMs = 0.0;
+
+    // SSAO cost per mode, reported when R or T switches away from it and by --bench-ssao,
+    // which also compares each mode's output against the full-resolution pass
+    GLuint ssaoQueries[2];
+    glGenQueries(2, ssaoQueries);
+    int ssaoFrames = 0;
+    std::string ssaoMeasuredMode = SsaoModeName();
+    double ssaoMs = 0.0;
+    struct BenchSsaoMode { SsaoTechnique technique; int divisor; bool deinterleaved; };
+    static const BenchSsaoMode benchSsaoModes[] = {
+        { SsaoTechnique::Hemisphere, 1, false }, { SsaoTechnique::Hemisphere, 1, true }, { SsaoTechnique::Hemisphere, 2, false },
+        { SsaoTechnique::Hemisphere, 2, true }, { SsaoTechnique::Hemisphere, 4, false },
+        { SsaoTechnique::Hbao, 1, false }, { SsaoTechnique::Hbao, 2, false }, { SsaoTechnique::Hbao, 4, false },
+        { SsaoTechnique::Gtao, 1, false }, { SsaoTechnique::Gtao, 2, false }, { SsaoTechnique::Gtao, 4, false }
+    };
+    int benchSsaoStep = -1;
+    std::vector<float> ssaoReference, ssaoResult;
+
+    // draws without an instance buffer (floor, glTF) get the identity instance matrix
+    for (GLuint column = 0; column < 4; column++) {
+        glm::vec4 identity = glm::mat4(1.0f)[column];
+        glVertexAttrib4f(3 + column, identity.x, identity.y, identity.z, identity.w);
+    }
+
+    CreateGeometryBuffer();
     CreateFloor();
-    CreateQuad();
+    if (terrainPath != nullptr) {
+        // heights start at the floor's level
+        terrain.Create(terrainPath, terrainTileSize, terrainHeight, -0.5f);
+    }
+    if (outOfCorePath != nullptr && clusterStreamer.Open(outOfCorePath, gpuBudgetMB * 1024 * 1024, SetupVertexAttributes)) {
+        std::cout << "Streaming " << outOfCorePath << " (" << clusterStreamer.FullTriangles() << " triangles at full detail) within "
+                  << gpuBudgetMB << " MB" << std::endl;
+    }
     SetupGBuffer();
     SetupSSAO();
+    hiZ.Create(screenWidth, screenHeight);
 
     Shader shaderGeometry = Shader("res/shaders/ssao_geometry.vs", "res/shaders/ssao_geometry.fs");
-    Shader shaderLighting = Shader("res/shaders/ssao_lighting.vs", "res/shaders/ssao_lighting.fs");
+    Shader shaderLighting = Shader("res/shaders/ssao_quad.vs", "res/shaders/ssao_lighting.fs");
     Shader shaderSSAO = Shader("res/shaders/ssao_quad.vs", "res/shaders/ssao.fs");
+    Shader shaderHBAO = Shader("res/shaders/ssao_quad.vs", "res/shaders/ssao_hbao.fs");
+    Shader shaderGTAO = Shader("res/shaders/ssao_quad.vs", "res/shaders/ssao_gtao.fs");
     Shader shaderSSAOBlur = Shader("res/shaders/ssao_quad.vs", "res/shaders/ssao_blur.fs");
+    Shader shaderSSAODepthMips = Shader("res/shaders/ssao_quad.vs", "res/shaders/ssao_depth_mips.fs");
+    Shader shaderSSAODownsample = Shader("res/shaders/ssao_quad.vs", "res/shaders/ssao_downsample.fs");
+    Shader shaderSSAOUpsample = Shader("res/shaders/ssao_quad.vs", "res/shaders/ssao_upsample.fs");
+    Shader shaderSSAODeinterleave = Shader("res/shaders/ssao_quad.vs", "res/shaders/ssao_deinterleave.fs");
+    Shader shaderSSAOLayer = Shader("res/shaders/ssao_quad.vs", "res/shaders/ssao_deinterleaved.fs");
+    Shader shaderSSAOReinterleave = Shader("res/shaders/ssao_quad.vs", "res/shaders/ssao_reinterleave.fs");
+    SsaoShaders ssaoShaders = { shaderSSAODepthMips, shaderSSAO, shaderHBAO, shaderGTAO, shaderSSAOBlur, shaderSSAODownsample,
+                                shaderSSAOUpsample, shaderSSAODeinterleave, shaderSSAOLayer, shaderSSAOReinterleave };
 
     shaderSSAO.UseProgram();
     shaderSSAO.SetInt("gPosition", 0);
     shaderSSAO.SetInt("gNormal", 1);
     shaderSSAO.SetInt("texNoise", 2);
+    shaderSSAO.SetInt("depthMips", 3);
+    shaderHBAO.UseProgram();
+    shaderHBAO.SetInt("gPosition", 0);
+    shaderHBAO.SetInt("gNormal", 1);
+    shaderHBAO.SetInt("texNoise", 2);
+    shaderHBAO.SetInt("depthMips", 3);
+    shaderGTAO.UseProgram();
+    shaderGTAO.SetInt("gPosition", 0);
+    shaderGTAO.SetInt("gNormal", 1);
+    shaderGTAO.SetInt("texNoise", 2);
+    shaderGTAO.SetInt("depthMips", 3);
+    shaderSSAODepthMips.UseProgram();
+    shaderSSAODepthMips.SetInt("source", 0);
     shaderSSAOBlur.UseProgram();
     shaderSSAOBlur.SetInt("ssaoInput", 0);
+    shaderSSAODownsample.UseProgram();
+    shaderSSAODownsample.SetInt("gPosition", 0);
+    shaderSSAODownsample.SetInt("gNormal", 1);
+    shaderSSAOUpsample.UseProgram();
+    shaderSSAOUpsample.SetInt("gPosition", 0);
+    shaderSSAOUpsample.SetInt("gNormal", 1);
+    shaderSSAOUpsample.SetInt("lowPosition", 2);
+    shaderSSAOUpsample.SetInt("lowNormal", 3);
+    shaderSSAOUpsample.SetInt("ssaoInput", 4);
+    shaderSSAODeinterleave.UseProgram();
+    shaderSSAODeinterleave.SetInt("gPosition", 0);
+    shaderSSAODeinterleave.SetInt("gNormal", 1);
+    shaderSSAOLayer.UseProgram();
+    shaderSSAOLayer.SetInt("layers", 0);
+    shaderSSAOReinterleave.UseProgram();
+    shaderSSAOReinterleave.SetInt("aoLayers", 0);
     shaderLighting.UseProgram();
     shaderLighting.SetInt("gPosition", 0);
     shaderLighting.SetInt("gNormal", 1);
@@ -412,32 +1333,40 @@ int main()
         glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        geometryDrawCalls = 0;
+        auto cullStart = std::chrono::steady_clock::now();
+        CullInstances(view, projection, currentTime);
+        auto geometryStart = std::chrono::steady_clock::now();
+        glBeginQuery(GL_TIME_ELAPSED, geometryQueries[frameIndex % 2]);
         RenderGeometry(shaderGeometry, view, projection);
+        glEndQuery(GL_TIME_ELAPSED);
+        auto geometryEnd = std::chrono::steady_clock::now();
+        statCpuMs += std::chrono::duration<double, std::milli>(geometryEnd - geometryStart).count();
+        double submitMs = std::chrono::duration<double, std::milli>(geometryEnd - cullStart).count();
+        statDrawCalls += geometryDrawCalls;
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        // the pyramid only pays off when one dragon can hide another
+        if (occlusionCulling && modelInstances.size() > 1) {
+            hiZ.Build(gDepth, view, projection, screenWidth, screenHeight);
+        } else {
+            hiZ.Invalidate();
+        }
 
-        // ssao pass
-        glBindFramebuffer(GL_FRAMEBUFFER, ssaoFBO);
-        glClear(GL_COLOR_BUFFER_BIT);
-        shaderSSAO.UseProgram();
-        shaderSSAO.SetMatrix4fv("projection", projection);
-        shaderSSAO.SetVec3fv("samples", 64, &ssaoKernel[0]);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, gPosition);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, gNormal);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, noiseTexture);
-        RenderQuad();
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-        // blur pass
-        glBindFramebuffer(GL_FRAMEBUFFER, ssaoBlurFBO);
-        glClear(GL_COLOR_BUFFER_BIT);
-        shaderSSAOBlur.UseProgram();
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, ssaoColorBuffer);
-        RenderQuad();
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        // ssao and blur passes, at full or reduced resolution
+        std::string ssaoMode = SsaoModeName();
+        if (ssaoMeasuredMode != ssaoMode) {
+            if (!benchSsao && ssaoFrames > 0) {
+                std::cout << "SSAO " << ssaoMeasuredMode << ": GPU " << ssaoMs / ssaoFrames << " ms over " << ssaoFrames
+                          << " frames; now " << ssaoMode << std::endl;
+            }
+            ssaoMeasuredMode = ssaoMode;
+            // the previous frame's query timed the old resolution; the benchmark also warms up
+            ssaoFrames = benchSsao ? -1 - BENCH_WARMUP : -1;
+            ssaoMs = 0.0;
+        }
+        glBeginQuery(GL_TIME_ELAPSED, ssaoQueries[frameIndex % 2]);
+        RenderSSAO(ssaoShaders, projection);
+        glEndQuery(GL_TIME_ELAPSED);
 
         // lighting combine
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -445,6 +1374,7 @@ int main()
         shaderLighting.SetVec3f("light.Position", glm::vec3(view * glm::vec4(LightPos, 1.0f)));
         shaderLighting.SetVec3f("light.Color", glm::vec3(1.4f, 1.3f, 1.2f));
         shaderLighting.SetVec3f("viewPos", camera.GetPosition());
+        shaderLighting.SetInt("multiBounce", ssaoTechnique == SsaoTechnique::Gtao && ssaoMultiBounce);
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, gPosition);
         glActiveTexture(GL_TEXTURE1);
@@ -457,8 +1387,166 @@ int main()
 
 
         glfwSwapBuffers(window);
+        // recycle ranges freed by finished frames. The scene never frees its floor or model
+        // ranges, so it never fragments; compaction happens in ClusterStreamer, whose
+        // evictions do.
+        geometry.EndFrame();
+        // last frame's query has finished by now, so reading it does not stall
+        if (frameIndex > 0) {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(geometryQueries[(frameIndex - 1) % 2], GL_QUERY_RESULT, &elapsed);
+            statGpuMs += elapsed / 1e6;
+            glGetQueryObjectui64v(ssaoQueries[(frameIndex - 1) % 2], GL_QUERY_RESULT, &elapsed);
+            if (ssaoFrames++ >= 0) {
+                ssaoMs += elapsed / 1e6;
+            }
+        }
+        frameIndex++;
+        statFrames++;
+        if (gridSize > 1 && glfwGetTime() - statStart >= 2.0) {
+            std::cout << "Geometry pass: " << modelInstances.size() << " dragons " << SubmissionName()
+                      << ", " << statDrawCalls / statFrames << " draw calls, CPU " << statCpuMs / statFrames << " ms, GPU "
+                      << statGpuMs / statFrames << " ms" << std::endl;
+            if (GpuDriven()) {
+                // reading the counts back waits for the GPU, acceptable once per report
+                std::cout << "Instance culling on the GPU: " << gpuCulling.ReadVisibleCount() << " of " << modelInstances.size()
+                          << " dragons drawn last frame" << (occlusionCulling ? "" : " (Hi-Z off)") << std::endl;
+            } else {
+                std::cout << "Instance culling: " << instanceBvh.NodeCount() << " BVH nodes, " << instanceCullStats.visitedNodes / statFrames
+                          << " visited, " << instanceCullStats.culledInstances / statFrames << " dragons culled, "
+                          << instanceCullStats.visibleInstances / statFrames << " visible, " << instanceCullStats.milliseconds / statFrames
+                          << " ms" << (animateInstances ? " (animated, refit every frame)" : "") << ", "
+                          << occlusionCulledInstances / statFrames << " occluded" << (occlusionCulling ? "" : " (Hi-Z off)") << std::endl;
+            }
+        }
+        if (clusterStreamer.IsOpen() && glfwGetTime() - statStart >= 2.0) {
+            const ClusterStreamer::Stats& streamStats = clusterStreamer.GetStats();
+            std::cout << "Out of core: " << streamStats.drawnNodes << " clusters drawn, " << streamStats.drawnTriangles << " of "
+                      << clusterStreamer.FullTriangles() << " triangles, " << streamStats.residentNodes << " resident in "
+                      << clusterStreamer.UsedBytes() / 1024 << " KB of " << clusterStreamer.BudgetBytes() / 1024 << " KB, "
+                      << streamStats.loaded << " loaded, " << streamStats.evicted << " evicted, " << streamStats.discarded
+                      << " discarded, CPU " << statCpuMs / statFrames << " ms" << std::endl;
+            clusterStreamer.ResetStats();
+        }
+        if (terrain.IsEnabled() && glfwGetTime() - statStart >= 2.0) {
+            const Terrain::Stats& terrainStats = terrain.GetStats();
+            std::cout << "Terrain: " << terrainStats.residentTiles << " tiles loaded, " << terrainStats.drawnChunks << " chunks drawn, "
+                      << terrainStats.culledChunks << " culled, " << terrainStats.triangles << " triangles" << std::endl;
+        }
+        if (glfwGetTime() - statStart >= 2.0) {
+            instanceCullStats = SceneBvh::CullStats();
+            occlusionCulledInstances = 0;
+            statFrames = statDrawCalls = 0;
+            statCpuMs = statGpuMs = 0.0;
+            statStart = glfwGetTime();
+        }
+        if (benchSubmission && !modelLods.empty()) {
+            if (benchStep >= 0 && ++benchFrames > BENCH_WARMUP) {
+                benchMs += submitMs;
+            }
+            if (benchStep < 0 || benchFrames == BENCH_WARMUP + BENCH_FRAMES) {
+                if (benchStep < 0) {
+                    std::cout << "Submission benchmark: CPU ms per frame for culling + geometry submission" << std::endl;
+                } else {
+                    uint32_t drawn = GpuDriven() ? gpuCulling.ReadVisibleCount() : static_cast<uint32_t>(visibleInstances.size());
+                    std::cout << "  " << modelInstances.size() << " dragons, " << SubmissionName() << ": " << benchMs / BENCH_FRAMES
+                              << " ms (" << drawn << " drawn, " << geometryDrawCalls << " draw calls)" << std::endl;
+                }
+                if (++benchStep == benchSteps) {
+                    glfwSetWindowShouldClose(window, GL_TRUE);
+                } else {
+                    int path = benchStep % benchPaths;
+                    gridSize = benchGrids[benchStep / benchPaths];
+                    BuildModelInstances();
+                    instancing = path != 0;
+                    gpuDriven = path == 2;
+                }
+                benchFrames = 0;
+                benchMs = 0.0;
+            }
+        }
+        if (benchSsao && modelReady) {
+            if (benchSsaoStep < 0 || ssaoFrames == BENCH_FRAMES) {
+                if (benchSsaoStep < 0) {
+                    std::cout << "SSAO benchmark: GPU ms per frame for all SSAO passes up to the blurred AO, "
+                              << "difference of the AO term from the full-resolution hemisphere pass" << std::endl;
+                } else {
+                    // the camera has not moved, so every mode saw the same frame
+                    std::vector<float>& output = benchSsaoStep == 0 ? ssaoReference : ssaoResult;
+                    output.resize(static_cast<size_t>(screenWidth) * screenHeight);
+                    glBindTexture(GL_TEXTURE_2D, ssaoColorBufferBlur);
+                    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+                    glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_FLOAT, output.data());
+                    std::cout << "  " << ssaoMode << " " << (screenWidth + ssaoDivisor - 1) / ssaoDivisor << "x"
+                              << (screenHeight + ssaoDivisor - 1) / ssaoDivisor << ": " << ssaoMs / ssaoFrames << " ms";
+                    if (benchSsaoStep != 0 && ssaoResult.size() == ssaoReference.size()) {
+                        double errorSum = 0.0, errorMax = 0.0;
+                        size_t visible = 0;
+                        for (size_t i = 0; i < ssaoResult.size(); i++) {
+                            double error = std::abs(static_cast<double>(ssaoResult[i]) - ssaoReference[i]);
+                            errorSum += error;
+                            errorMax = std::max(errorMax, error);
+                            visible += error > 0.05 ? 1 : 0;
+                        }
+                        std::cout << ", mean difference " << errorSum / ssaoResult.size() << ", max " << errorMax << ", "
+                                  << 100.0 * visible / ssaoResult.size() << "% of pixels off by more than 0.05";
+                    }
+                    std::cout << std::endl;
+                }
+                if (++benchSsaoStep == static_cast<int>(sizeof(benchSsaoModes) / sizeof(benchSsaoModes[0]))) {
+                    glfwSetWindowShouldClose(window, GL_TRUE);
+                } else {
+                    ssaoTechnique = benchSsaoModes[benchSsaoStep].technique;
+                    ssaoDivisor = benchSsaoModes[benchSsaoStep].divisor;
+                    ssaoDeinterleaved = benchSsaoModes[benchSsaoStep].deinterleaved;
+                    ssaoMeasuredMode.clear(); // restart the measurement even if the mode stays
+                }
+            }
+        }
+        if (firstFrame) {
+            std::cout << "First frame after " << millisecondsSinceStart() << " ms" << std::endl;
+            firstFrame = false;
+        }
+
+        // progressive model upload, bounded per frame
+        if (!modelUploading && !modelReady && modelLoaded.load(std::memory_order_acquire)) {
+            modelLoader.join();
+            modelReady = !modelLoadOk;
+            modelUploading = modelLoadOk;
+            if (modelLoadOk) {
+                BeginModelUpload(modelData);
+            }
+        }
+        if (clusterStreamer.IsOpen()) {
+            clusterStreamer.Update(uploadBudgetMs / 1000.0);
+        }
+        if (terrain.IsEnabled()) {
+            terrain.Update(camera.GetPosition());
+        }
+        if (modelUploading) {
+            auto uploadStart = std::chrono::steady_clock::now();
+            bool done = StepModelUpload(modelData, uploadBudgetMs / 1000.0);
+            worstUploadMs = std::max(worstUploadMs, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - uploadStart).count());
+            uploadFrames++;
+            if (done) {
+                modelUploading = false;
+                modelReady = true;
+                modelData.cache.Close();
+                modelData.vertices = VertexStream();
+                modelData.indices = std::vector<unsigned char>();
+                std::cout << "Model visible after " << millisecondsSinceStart() << " ms (uploaded over " << uploadFrames
+                          << " frames, worst frame " << worstUploadMs << " ms of upload)" << std::endl;
+                std::cout << "Geometry buffer: " << geometry.UsedBytes() / 1024 << " KB used of "
+                          << (geometry.VertexCapacityBytes() + geometry.IndexCapacityBytes()) / 1024 << " KB" << std::endl;
+            }
+        }
     }
 
+    if (modelLoader.joinable()) {
+        modelLoader.join();
+    }
+    clusterStreamer.Close();
+    terrain.Close();
     glfwTerminate();
     return 0;
 }
@@ -467,6 +1555,39 @@ void KeyCallback(GLFWwindow *window, int key, int scancode, int action, int mode
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS){
         glfwSetWindowShouldClose(window, GL_TRUE);
     }
+    if (key == GLFW_KEY_C && action == GLFW_PRESS){
+        clusterCulling = !clusterCulling;
+        std::cout << "Cluster culling " << (clusterCulling ? "on" : "off") << " (last frame: "
+                  << clusterStats.frustumCulled << " frustum + " << clusterStats.backfaceCulled << " cone culled of "
+                  << clusterStats.total << " meshlets)" << std::endl;
+    }
+    if (key == GLFW_KEY_M && action == GLFW_PRESS){
+        animateInstances = !animateInstances;
+    }
+    if (key == GLFW_KEY_O && action == GLFW_PRESS){
+        occlusionCulling = !occlusionCulling;
+        std::cout << "Occlusion culling " << (occlusionCulling ? "on" : "off") << std::endl;
+    }
+    if (key == GLFW_KEY_G && action == GLFW_PRESS){
+        gpuDriven = !gpuDriven;
+        std::cout << "GPU-driven culling " << (gpuDriven ? "on" : "off") << (gpuCullingSupported ? "" : " (needs GL 4.3, not available)") << std::endl;
+    }
+    if (key == GLFW_KEY_R && action == GLFW_PRESS){
+        ssaoDivisor = ssaoDivisor == 4 ? 1 : ssaoDivisor * 2;
+    }
+    if (key == GLFW_KEY_T && action == GLFW_PRESS){
+        ssaoDeinterleaved = !ssaoDeinterleaved;
+    }
+    if (key == GLFW_KEY_B && action == GLFW_PRESS){
+        ssaoMultiBounce = !ssaoMultiBounce;
+    }
+    if (key == GLFW_KEY_H && action == GLFW_PRESS){
+        ssaoTechnique = static_cast<SsaoTechnique>((static_cast<int>(ssaoTechnique) + 1) % static_cast<int>(SsaoTechnique::Count));
+    }
+    if (key == GLFW_KEY_I && action == GLFW_PRESS){
+        instancing = !instancing;
+        std::cout << "Instancing " << (instancing ? "on" : "off") << std::endl;
+    }
     if (key >= 0 && key < 1024){
         if (action == GLFW_PRESS){
             keys[key] = true;
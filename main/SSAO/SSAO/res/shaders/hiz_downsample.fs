@@ -0,0 +1,19 @@
+#version 330 core
+out float FragDepth;
+
+// the G-buffer depth texture or the previous pyramid level; its base level is set to the
+// level being read, so lod 0 below is that level
+uniform sampler2D source;
+
+// Each texel keeps the farthest depth of the 2x2 source texels under it. Destination sizes
+// round up, so on odd sizes the last texel reads the edge texel twice instead of skipping it.
+void main()
+{
+    ivec2 last = textureSize(source, 0) - 1;
+    ivec2 base = ivec2(gl_FragCoord.xy) * 2;
+    float d0 = texelFetch(source, min(base, last), 0).r;
+    float d1 = texelFetch(source, min(base + ivec2(1, 0), last), 0).r;
+    float d2 = texelFetch(source, min(base + ivec2(0, 1), last), 0).r;
+    float d3 = texelFetch(source, min(base + ivec2(1, 1), last), 0).r;
+    FragDepth = max(max(d0, d1), max(d2, d3));
+}
@@ -0,0 +1,107 @@
+#version 430 core
+layout (local_size_x = 64) in;
+
+// one DrawElementsIndirectCommand per LOD; instanceCount is zeroed by the CPU every frame
+struct DrawCommand
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance; // start of this LOD's range in visibleIds
+};
+
+layout (std430, binding = 0) readonly buffer Instances { mat4 models[]; };
+layout (std430, binding = 1) buffer Commands { DrawCommand commands[]; };
+layout (std430, binding = 2) writeonly buffer VisibleIds { uint visibleIds[]; };
+
+uniform int instanceCount;
+uniform vec4 planes[6]; // world space, normalized, facing inwards
+
+// bounding sphere of the mesh in object space
+uniform vec3 boundsCenter;
+uniform float boundsRadius;
+
+// LOD selection as SelectLod() in main.cpp
+uniform mat4 view;
+uniform float pixelsPerUnit; // projection[1][1] * 0.5 * viewport height, at distance 1
+uniform int lodCount;
+uniform float lodErrors[8];
+uniform float lodPixelError;
+
+// Hi-Z pyramid of the previous geometry pass (see HiZ.h) and the matrices it was drawn with
+uniform bool occlusion;
+uniform sampler2D hiZ;
+uniform mat4 hiZViewProjection;
+uniform vec2 hiZViewport;
+uniform int hiZLevels;
+
+// Same rules as HiZPyramid::IsOccluded, but the level is picked per box so the footprint
+// covers at most 2x2 texels (4x4 after growing it by one texel).
+bool Occluded(vec3 lo, vec3 hi)
+{
+    vec2 ndcMin = vec2(1e30), ndcMax = vec2(-1e30);
+    float nearest = 1e30;
+    for (int corner = 0; corner < 8; corner++) {
+        vec3 p = vec3((corner & 1) != 0 ? hi.x : lo.x, (corner & 2) != 0 ? hi.y : lo.y, (corner & 4) != 0 ? hi.z : lo.z);
+        vec4 clip = hiZViewProjection * vec4(p, 1.0);
+        if (clip.w <= 1e-5) {
+            return false;
+        }
+        vec3 ndc = clip.xyz / clip.w;
+        ndcMin = min(ndcMin, ndc.xy);
+        ndcMax = max(ndcMax, ndc.xy);
+        nearest = min(nearest, ndc.z * 0.5 + 0.5);
+    }
+    if (any(lessThan(ndcMin, vec2(-1.0))) || any(greaterThan(ndcMax, vec2(1.0)))) {
+        return false;
+    }
+    // level 0 texels are 2x2 viewport pixels
+    vec2 texMin = (ndcMin + 1.0) * 0.25 * hiZViewport;
+    vec2 texMax = (ndcMax + 1.0) * 0.25 * hiZViewport;
+    vec2 extent = texMax - texMin;
+    int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, hiZLevels - 1);
+    ivec2 last = textureSize(hiZ, level) - 1;
+    float texelsPerLevel0 = 1.0 / exp2(float(level));
+    ivec2 a = clamp(ivec2(floor(texMin * texelsPerLevel0)) - 1, ivec2(0), last);
+    ivec2 b = clamp(ivec2(floor(texMax * texelsPerLevel0)) + 1, ivec2(0), last);
+    for (int y = a.y; y <= b.y; y++) {
+        for (int x = a.x; x <= b.x; x++) {
+            if (texelFetch(hiZ, ivec2(x, y), level).r >= nearest) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void main()
+{
+    uint id = gl_GlobalInvocationID.x;
+    if (id >= uint(instanceCount)) {
+        return;
+    }
+    mat4 model = models[id];
+    float scale = max(length(model[0].xyz), max(length(model[1].xyz), length(model[2].xyz)));
+    vec3 center = vec3(model * vec4(boundsCenter, 1.0));
+    float radius = boundsRadius * scale;
+    for (int p = 0; p < 6; p++) {
+        if (dot(planes[p].xyz, center) + planes[p].w < -radius) {
+            return;
+        }
+    }
+    if (occlusion && Occluded(center - radius, center + radius)) {
+        return;
+    }
+
+    float distance = max(length(vec3(view * vec4(center, 1.0))) - radius, 0.1);
+    float pixels = pixelsPerUnit / distance;
+    int lod = 0;
+    for (int i = 1; i < lodCount; i++) {
+        if (lodErrors[i] * scale * pixels <= lodPixelError) {
+            lod = i;
+        }
+    }
+    uint slot = atomicAdd(commands[lod].instanceCount, 1u);
+    visibleIds[commands[lod].baseInstance + slot] = id;
+}
@@ -6,15 +6,21 @@ in vec2 TexCoords;
 uniform sampler2D gPosition;
 uniform sampler2D gNormal;
 uniform sampler2D texNoise;
+uniform sampler2D depthMips; // view-space z at full resolution and below; see ssao_depth_mips.fs
+uniform int depthMipCount;
 uniform vec3 samples[64];
 uniform mat4 projection;
+uniform float radius;          // world units
+uniform float maxRadiusPixels; // projected radius limit, keeps the footprint bounded near the camera
 
-// tile noise texture over screen based on screen dimensions divided by noise size
-const vec2 noiseScale = vec2(1280.0/4.0, 720.0/4.0);
+// tile noise texture over screen based on the AO target size divided by noise size
+uniform vec2 noiseScale;
 
 const int kernelSize = 64;
-const float radius = 0.5;
 const float bias = 0.025;
+// taps up to 2^LOG_MAX_OFFSET pixels away read full resolution, each further doubling one
+// level down, so the texels a fragment touches stay within a fixed footprint
+const int LOG_MAX_OFFSET = 3;
 
 void main()
 {
@@ -27,6 +33,12 @@ void main()
     vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
     vec3 bitangent = cross(normal, tangent);
     mat3 TBN = mat3(tangent, bitangent, normal);
+
+    // shrink the kernel where it would project larger than maxRadiusPixels
+    vec2 depthSize = vec2(textureSize(depthMips, 0));
+    float pixelRadius = radius * 0.5 * depthSize.y * projection[1][1] / max(-fragPos.z, 0.01);
+    float sampleRadius = radius * min(1.0, maxRadiusPixels / pixelRadius);
+    vec2 centerPixel = TexCoords * depthSize;
     
     // iterate over the sample kernel and calculate occlusion factor
     float occlusion = 0.0;
@@ -34,7 +46,7 @@ void main()
     {
         // get sample position
         vec3 samplePos = TBN * samples[i]; // from tangent to view-space
-        samplePos = fragPos + samplePos * radius; 
+        samplePos = fragPos + samplePos * sampleRadius;
         
         // project sample position (to sample texture) (to get position on screen/texture)
         vec4 offset = vec4(samplePos, 1.0);
@@ -42,11 +54,15 @@ void main()
         offset.xyz /= offset.w; // perspective divide
         offset.xyz = offset.xyz * 0.5 + 0.5; // transform to range 0.0 - 1.0
         
-        // get sample depth
-        float sampleDepth = texture(gPosition, offset.xy).z;
+        // get sample depth from the level matching the tap's distance on screen
+        vec2 tapPixel = offset.xy * depthSize;
+        float ssR = length(tapPixel - centerPixel);
+        int mip = clamp(int(floor(log2(max(ssR, 1.0)))) - LOG_MAX_OFFSET, 0, depthMipCount - 1);
+        ivec2 mipTexel = clamp(ivec2(tapPixel) >> mip, ivec2(0), textureSize(depthMips, mip) - 1);
+        float sampleDepth = texelFetch(depthMips, mipTexel, mip).r;
         
         // range check & accumulate
-        float rangeCheck = smoothstep(0.0, 1.0, radius / abs(fragPos.z - sampleDepth));
+        float rangeCheck = smoothstep(0.0, 1.0, sampleRadius / abs(fragPos.z - sampleDepth));
         occlusion += (sampleDepth >= samplePos.z + bias ? 1.0 : 0.0) * rangeCheck;           
     }
     occlusion = 1.0 - (occlusion / kernelSize);
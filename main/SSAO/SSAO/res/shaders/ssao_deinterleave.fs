@@ -0,0 +1,22 @@
+#version 330 core
+// one output per layer; two passes fill the 16 layers of the 4x4 split
+layout (location = 0) out vec4 layers[8];
+
+uniform sampler2D gPosition;
+uniform sampler2D gNormal;
+uniform int firstLayer; // 0 or 8
+
+// Layer l holds every pixel whose position modulo 4 is (l % 4, l / 4), so each layer is a
+// quarter-resolution copy of the whole image. Only the normal and view-space depth are
+// kept; ssao_deinterleaved.fs rebuilds the position from the depth.
+void main()
+{
+    ivec2 last = textureSize(gPosition, 0) - 1;
+    ivec2 base = ivec2(gl_FragCoord.xy) * 4;
+    for (int i = 0; i < 8; ++i)
+    {
+        int layer = firstLayer + i;
+        ivec2 texel = min(base + ivec2(layer % 4, layer / 4), last);
+        layers[i] = vec4(texelFetch(gNormal, texel, 0).xyz, texelFetch(gPosition, texel, 0).z);
+    }
+}
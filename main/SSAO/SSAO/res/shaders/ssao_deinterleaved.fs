@@ -0,0 +1,53 @@
+#version 330 core
+out float FragColor;
+
+uniform sampler2DArray layers; // rgb normal, a view-space depth; see ssao_deinterleave.fs
+uniform int layer;
+uniform vec3 rotation;    // the one noise vector of this layer
+uniform vec2 imageSize;   // size of the interleaved image
+uniform vec3 samples[64];
+uniform mat4 projection;
+uniform float radius;          // world units
+uniform float maxRadiusPixels; // as in ssao.fs, but in pixels of imageSize
+
+const int kernelSize = 64;
+const float bias = 0.025;
+
+// ssao.fs for one layer of the 4x4 split. Every pixel of the layer shares the rotation the
+// 4x4 noise tile gives its position, so the result matches ssao.fs up to taps snapping to
+// the layer's texels, and neighbouring fragments' taps land on neighbouring texels of a
+// 16 times smaller texture instead of scattering across the full-resolution one.
+void main()
+{
+    ivec2 layerSize = textureSize(layers, 0).xy;
+    vec2 layerOffset = vec2(layer % 4, layer / 4) + 0.5; // image pixel of layer texel 0
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec4 center = texelFetch(layers, ivec3(texel, layer), 0);
+    vec2 pixel = vec2(texel * 4) + layerOffset;
+    vec2 ndc = pixel / imageSize * 2.0 - 1.0;
+    vec3 fragPos = vec3(ndc.x * -center.a / projection[0][0], ndc.y * -center.a / projection[1][1], center.a);
+    vec3 normal = normalize(center.rgb);
+
+    vec3 tangent = normalize(rotation - normal * dot(rotation, normal));
+    vec3 bitangent = cross(normal, tangent);
+    mat3 TBN = mat3(tangent, bitangent, normal);
+
+    float pixelRadius = radius * 0.5 * imageSize.y * projection[1][1] / max(-fragPos.z, 0.01);
+    float sampleRadius = radius * min(1.0, maxRadiusPixels / pixelRadius);
+
+    float occlusion = 0.0;
+    for (int i = 0; i < kernelSize; ++i)
+    {
+        vec3 samplePos = fragPos + TBN * samples[i] * sampleRadius;
+        vec4 offset = projection * vec4(samplePos, 1.0);
+        offset.xy = offset.xy / offset.w * 0.5 + 0.5;
+
+        // nearest texel of this layer, whose pixels sit at 4 * texel + layerOffset
+        ivec2 sampleTexel = ivec2(floor((offset.xy * imageSize - layerOffset) / 4.0 + 0.5));
+        sampleTexel = clamp(sampleTexel, ivec2(0), layerSize - 1);
+        float sampleDepth = texelFetch(layers, ivec3(sampleTexel, layer), 0).a;
+        float rangeCheck = smoothstep(0.0, 1.0, sampleRadius / abs(fragPos.z - sampleDepth));
+        occlusion += (sampleDepth >= samplePos.z + bias ? 1.0 : 0.0) * rangeCheck;
+    }
+    FragColor = 1.0 - (occlusion / kernelSize);
+}
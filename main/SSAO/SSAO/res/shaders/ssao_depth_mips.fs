@@ -0,0 +1,22 @@
+#version 330 core
+out float FragDepth;
+
+// gPosition for level 0, else the previous level; its base level is set to the level being
+// read, so lod 0 below is that level
+uniform sampler2D source;
+uniform int level;
+
+// View-space z, which is linear in distance, halved per level. Like SAO each texel keeps one
+// of the 2x2 texels below it on a rotated grid rather than their average, so every level
+// holds depths of real surfaces and silhouettes do not turn into in-between depths.
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    if (level == 0)
+    {
+        FragDepth = texelFetch(source, texel, 0).z;
+        return;
+    }
+    ivec2 last = textureSize(source, 0) - 1;
+    FragDepth = texelFetch(source, min(texel * 2 + ivec2(texel.y & 1, texel.x & 1), last), 0).r;
+}
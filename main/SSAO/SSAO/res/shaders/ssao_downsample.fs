@@ -0,0 +1,33 @@
+#version 330 core
+layout (location = 0) out vec3 lowPosition;
+layout (location = 1) out vec3 lowNormal;
+
+uniform sampler2D gPosition;
+uniform sampler2D gNormal;
+uniform int divisor; // 2 or 4 full-resolution pixels per side of a low-resolution one
+
+// Picks one full-resolution sample per block rather than averaging, so the low-resolution
+// position and normal stay an actual surface point; the closest one wins, so thin
+// foreground detail survives. Background pixels (cleared to positive z) lose to geometry.
+void main()
+{
+    ivec2 last = textureSize(gPosition, 0) - 1;
+    ivec2 base = ivec2(gl_FragCoord.xy) * divisor;
+    ivec2 best = min(base, last);
+    float bestZ = texelFetch(gPosition, best, 0).z;
+    for (int y = 0; y < divisor; ++y)
+    {
+        for (int x = 0; x < divisor; ++x)
+        {
+            ivec2 texel = min(base + ivec2(x, y), last);
+            float z = texelFetch(gPosition, texel, 0).z;
+            if (z < 0.0 && (bestZ >= 0.0 || z > bestZ))
+            {
+                best = texel;
+                bestZ = z;
+            }
+        }
+    }
+    lowPosition = texelFetch(gPosition, best, 0).xyz;
+    lowNormal = texelFetch(gNormal, best, 0).xyz;
+}
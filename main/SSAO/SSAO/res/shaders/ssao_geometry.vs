@@ -1,7 +1,9 @@
 #version 330 core
 layout (location = 0) in vec3 position;
-layout (location = 1) in vec3 color;
 layout (location = 2) in vec3 normal;
+// per-instance model matrix (one column per location, divisor 1); draws without an
+// instance buffer see the identity set as the generic attribute value
+layout (location = 3) in mat4 instanceModel;
 
 out VS_OUT {
     vec3 FragPos;
@@ -13,12 +15,22 @@ uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
 
+// per-draw material color (replaces the constant per-vertex color)
+uniform vec3 albedo;
+
+// dequantization: compact vertices store positions as unorm16 inside the mesh AABB,
+// float vertices use offset 0 and scale 1
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
 void main()
 {
-    vec4 worldPos = model * vec4(position, 1.0);
+    vec3 objectPos = positionOffset + position * positionScale;
+    mat4 world = model * instanceModel;
+    vec4 worldPos = world * vec4(objectPos, 1.0);
     vec3 viewPos = vec3(view * worldPos);
     vs_out.FragPos = viewPos;
-    vs_out.Normal = mat3(transpose(inverse(view * model))) * normal;
-    vs_out.Albedo = color;
+    vs_out.Normal = mat3(transpose(inverse(view * world))) * normal;
+    vs_out.Albedo = albedo;
     gl_Position = projection * vec4(viewPos, 1.0);
 }
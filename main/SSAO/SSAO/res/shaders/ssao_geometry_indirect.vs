@@ -0,0 +1,33 @@
+#version 430 core
+layout (location = 0) in vec3 position;
+layout (location = 2) in vec3 normal;
+// index into models, compacted by instance_cull.cs; divisor 1, so the baseInstance of each
+// indirect command selects its LOD's range
+layout (location = 7) in uint instanceId;
+
+layout (std430, binding = 0) readonly buffer Instances { mat4 models[]; };
+
+out VS_OUT {
+    vec3 FragPos;
+    vec3 Normal;
+    vec3 Albedo;
+} vs_out;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 albedo;
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+
+// ssao_geometry.vs with the model matrix fetched by instance ID
+void main()
+{
+    vec3 objectPos = positionOffset + position * positionScale;
+    mat4 world = models[instanceId];
+    vec4 worldPos = world * vec4(objectPos, 1.0);
+    vec3 viewPos = vec3(view * worldPos);
+    vs_out.FragPos = viewPos;
+    vs_out.Normal = mat3(transpose(inverse(view * world))) * normal;
+    vs_out.Albedo = albedo;
+    gl_Position = projection * vec4(viewPos, 1.0);
+}
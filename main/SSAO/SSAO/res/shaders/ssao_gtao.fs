@@ -0,0 +1,109 @@
+#version 330 core
+out float FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D gPosition; // the AO input, full or reduced resolution
+uniform sampler2D gNormal;
+uniform sampler2D texNoise;
+uniform sampler2D depthMips; // see ssao_depth_mips.fs
+uniform int depthMipCount;
+uniform mat4 projection;
+uniform float radius;
+uniform float maxRadiusPixels;
+uniform vec2 noiseScale;
+
+const int NUM_SLICES = 4;
+const int NUM_STEPS = 4;   // per side of each slice
+const float PI = 3.14159265;
+const float HALF_PI = 1.57079633;
+const float FALLOFF_RANGE = 0.615; // share of the radius over which samples fade out
+const int LOG_MAX_OFFSET = 3; // as in ssao.fs
+
+vec3 ViewPosition(ivec2 pixel, float z, vec2 depthSize)
+{
+    vec2 ndc = (vec2(pixel) + 0.5) / depthSize * 2.0 - 1.0;
+    return vec3(ndc.x * -z / projection[0][0], ndc.y * -z / projection[1][1], z);
+}
+
+vec3 SampleDepthMips(vec2 pixel, float distancePixels, vec2 depthSize)
+{
+    int mip = clamp(int(floor(log2(max(distancePixels, 1.0)))) - LOG_MAX_OFFSET, 0, depthMipCount - 1);
+    ivec2 mipTexel = clamp(ivec2(pixel) >> mip, ivec2(0), textureSize(depthMips, mip) - 1);
+    return ViewPosition(ivec2(pixel), texelFetch(depthMips, mipTexel, mip).r, depthSize);
+}
+
+// Ground-truth-based AO (Jimenez et al. 2016). Each slice is the plane through the view
+// vector and a screen direction; the highest horizon on both sides is found by marching the
+// depth pyramid, and the cosine-weighted visibility between the two horizons is integrated
+// in closed form against the normal projected into the slice. Four slices of 2 x 4 steps
+// are 32 fetches; the rotation noise and the 4x4 blur make up the remaining directions.
+void main()
+{
+    vec3 fragPos = texture(gPosition, TexCoords).xyz;
+    vec3 normal = normalize(texture(gNormal, TexCoords).rgb);
+    vec3 noise = texture(texNoise, TexCoords * noiseScale).xyz;
+    vec3 viewVector = normalize(-fragPos);
+
+    vec2 depthSize = vec2(textureSize(depthMips, 0));
+    float projectedRadius = radius * 0.5 * depthSize.y * projection[1][1] / max(-fragPos.z, 0.01);
+    float pixelRadius = min(projectedRadius, maxRadiusPixels);
+    if (pixelRadius < 1.0)
+    {
+        FragColor = 1.0;
+        return;
+    }
+    float worldRadius = radius * pixelRadius / projectedRadius;
+    float falloffMul = -1.0 / (FALLOFF_RANGE * worldRadius);
+    float falloffAdd = (1.0 - FALLOFF_RANGE) / FALLOFF_RANGE + 1.0;
+    float sliceJitter = noise.x * 0.5 + 0.5;
+    float stepJitter = noise.y * 0.5 + 0.5;
+    vec2 centerPixel = TexCoords * depthSize;
+
+    float visibility = 0.0;
+    for (int slice = 0; slice < NUM_SLICES; ++slice)
+    {
+        float phi = (float(slice) + sliceJitter) * PI / float(NUM_SLICES);
+        vec2 omega = vec2(cos(phi), sin(phi));
+
+        // the slice plane and the normal projected into it; n is the normal's angle from
+        // the view vector within the slice
+        vec3 direction = vec3(omega, 0.0);
+        vec3 orthoDirection = direction - dot(direction, viewVector) * viewVector;
+        vec3 axis = normalize(cross(direction, viewVector));
+        vec3 projectedNormal = normal - axis * dot(normal, axis);
+        float projectedNormalLength = length(projectedNormal);
+        float cosN = clamp(dot(projectedNormal, viewVector) / max(projectedNormalLength, 1e-4), 0.0, 1.0);
+        float n = sign(dot(orthoDirection, projectedNormal)) * acos(cosN);
+
+        // horizon cosines start at the tangent plane: nothing below it is visible anyway
+        float lowCos0 = cos(n + HALF_PI), lowCos1 = cos(n - HALF_PI);
+        float horizonCos0 = lowCos0, horizonCos1 = lowCos1;
+        for (int s = 0; s < NUM_STEPS; ++s)
+        {
+            float t = (float(s) + stepJitter) / float(NUM_STEPS);
+            float distancePixels = max(t * t * pixelRadius, float(s + 1));
+            vec2 offset = floor(omega * distancePixels + 0.5);
+
+            vec3 toSample0 = SampleDepthMips(centerPixel + offset, distancePixels, depthSize) - fragPos;
+            vec3 toSample1 = SampleDepthMips(centerPixel - offset, distancePixels, depthSize) - fragPos;
+            float length0 = length(toSample0), length1 = length(toSample1);
+            float weight0 = clamp(length0 * falloffMul + falloffAdd, 0.0, 1.0);
+            float weight1 = clamp(length1 * falloffMul + falloffAdd, 0.0, 1.0);
+            float cos0 = mix(lowCos0, dot(toSample0, viewVector) / max(length0, 1e-6), weight0);
+            float cos1 = mix(lowCos1, dot(toSample1, viewVector) / max(length1, 1e-6), weight1);
+            horizonCos0 = max(horizonCos0, cos0);
+            horizonCos1 = max(horizonCos1, cos1);
+        }
+
+        // horizon angles in the slice, clamped to the hemisphere around the normal
+        float h0 = -acos(clamp(horizonCos1, -1.0, 1.0));
+        float h1 = acos(clamp(horizonCos0, -1.0, 1.0));
+        h0 = n + clamp(h0 - n, -HALF_PI, HALF_PI);
+        h1 = n + clamp(h1 - n, -HALF_PI, HALF_PI);
+        float arc0 = (cosN + 2.0 * h0 * sin(n) - cos(2.0 * h0 - n)) * 0.25;
+        float arc1 = (cosN + 2.0 * h1 * sin(n) - cos(2.0 * h1 - n)) * 0.25;
+        visibility += projectedNormalLength * (arc0 + arc1);
+    }
+    FragColor = clamp(visibility / float(NUM_SLICES), 0.0, 1.0);
+}
@@ -0,0 +1,83 @@
+#version 330 core
+out float FragColor;
+
+in vec2 TexCoords;
+
+uniform sampler2D gPosition; // the AO input, full or reduced resolution
+uniform sampler2D gNormal;
+uniform sampler2D texNoise;
+uniform sampler2D depthMips; // see ssao_depth_mips.fs
+uniform int depthMipCount;
+uniform mat4 projection;
+uniform float radius;
+uniform float maxRadiusPixels;
+uniform vec2 noiseScale;
+
+const int NUM_DIRECTIONS = 8;
+const int NUM_STEPS = 4;
+const float PI = 3.14159265;
+const float ANGLE_BIAS = 0.1; // sine of the elevation ignored, against tessellation acne
+const int LOG_MAX_OFFSET = 3; // as in ssao.fs
+
+vec3 ViewPosition(ivec2 pixel, float z, vec2 depthSize)
+{
+    vec2 ndc = (vec2(pixel) + 0.5) / depthSize * 2.0 - 1.0;
+    return vec3(ndc.x * -z / projection[0][0], ndc.y * -z / projection[1][1], z);
+}
+
+// Horizon-based AO: march NUM_DIRECTIONS screen-space directions through the depth pyramid
+// and, per direction, integrate how far the horizon rises above the tangent plane. Each step
+// adds the rise in the horizon's sine over the previous maximum, weighted by a falloff with
+// distance, so 32 depth fetches do the work of the 64-tap hemisphere kernel.
+void main()
+{
+    vec3 fragPos = texture(gPosition, TexCoords).xyz;
+    vec3 normal = normalize(texture(gNormal, TexCoords).rgb);
+    vec3 noise = texture(texNoise, TexCoords * noiseScale).xyz;
+
+    vec2 depthSize = vec2(textureSize(depthMips, 0));
+    float projectedRadius = radius * 0.5 * depthSize.y * projection[1][1] / max(-fragPos.z, 0.01);
+    float pixelRadius = min(projectedRadius, maxRadiusPixels);
+    if (pixelRadius < 1.0)
+    {
+        FragColor = 1.0;
+        return;
+    }
+    // the falloff uses the world radius matching the clamped one on screen
+    float worldRadius = radius * pixelRadius / projectedRadius;
+    float inverseRadius2 = 1.0 / (worldRadius * worldRadius);
+    float stepPixels = pixelRadius / float(NUM_STEPS + 1);
+    float jitter = noise.x * 0.5 + 0.5;
+    vec2 rotation = normalize(noise.xy);
+    vec2 centerPixel = TexCoords * depthSize;
+
+    float occlusion = 0.0;
+    for (int d = 0; d < NUM_DIRECTIONS; ++d)
+    {
+        float angle = 2.0 * PI * float(d) / float(NUM_DIRECTIONS);
+        vec2 direction = vec2(cos(angle), sin(angle));
+        direction = vec2(direction.x * rotation.x - direction.y * rotation.y, direction.x * rotation.y + direction.y * rotation.x);
+
+        float horizon = ANGLE_BIAS;
+        float rayPixels = jitter * stepPixels + 1.0;
+        for (int s = 0; s < NUM_STEPS; ++s)
+        {
+            vec2 offset = floor(rayPixels * direction + 0.5);
+            ivec2 pixel = ivec2(centerPixel + offset);
+            int mip = clamp(int(floor(log2(max(length(offset), 1.0)))) - LOG_MAX_OFFSET, 0, depthMipCount - 1);
+            ivec2 mipTexel = clamp(pixel >> mip, ivec2(0), textureSize(depthMips, mip) - 1);
+            vec3 samplePos = ViewPosition(pixel, texelFetch(depthMips, mipTexel, mip).r, depthSize);
+
+            vec3 toSample = samplePos - fragPos;
+            float distance2 = dot(toSample, toSample);
+            float sinElevation = dot(normal, toSample) * inversesqrt(max(distance2, 1e-8));
+            if (sinElevation > horizon)
+            {
+                occlusion += (sinElevation - horizon) * clamp(1.0 - distance2 * inverseRadius2, 0.0, 1.0);
+                horizon = sinElevation;
+            }
+            rayPixels += stepPixels;
+        }
+    }
+    FragColor = clamp(1.0 - occlusion / float(NUM_DIRECTIONS), 0.0, 1.0);
+}
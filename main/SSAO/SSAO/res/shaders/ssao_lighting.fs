@@ -14,6 +14,17 @@ uniform sampler2D gAlbedo;
 uniform sampler2D ssao;
 uniform Light light;
 uniform vec3 viewPos;
+uniform bool multiBounce; // GTAO: add back light bounced off the occluders
+
+// Jimenez et al. 2016 fit of multi-bounce AO from single-bounce visibility and the albedo
+// of the surroundings, taken to be the pixel's own; brightens AO most on light surfaces.
+vec3 MultiBounce(float visibility, vec3 albedo)
+{
+    vec3 a = 2.0404 * albedo - 0.3324;
+    vec3 b = -4.7951 * albedo + 0.6417;
+    vec3 c = 2.7552 * albedo + 0.6903;
+    return max(vec3(visibility), ((visibility * a + b) * visibility + c) * visibility);
+}
 
 void main()
 {
@@ -22,7 +33,7 @@ void main()
     vec3 Albedo = texture(gAlbedo, TexCoords).rgb;
     float ao = texture(ssao, TexCoords).r;
 
-    vec3 ambient = 0.25 * Albedo * ao;
+    vec3 ambient = 0.25 * Albedo * (multiBounce ? MultiBounce(ao, Albedo) : vec3(ao));
 
     vec3 lightDir = normalize(light.Position - FragPos);
     float diff = max(dot(Normal, lightDir), 0.0);
@@ -1,11 +1,11 @@
 #version 330 core
-layout (location = 0) in vec3 position;
-layout (location = 1) in vec2 texCoords;
 
 out vec2 TexCoords;
 
+// fullscreen triangle from gl_VertexID, no vertex buffer needed
 void main()
 {
-    TexCoords = texCoords;
-    gl_Position = vec4(position.xy, 0.0, 1.0);
+    vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    TexCoords = p;
+    gl_Position = vec4(p * 2.0 - 1.0, 0.0, 1.0);
 }
@@ -0,0 +1,11 @@
+#version 330 core
+out float FragColor;
+
+uniform sampler2DArray aoLayers;
+
+// back from the 4x4 split of ssao_deinterleave.fs to one image
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    FragColor = texelFetch(aoLayers, ivec3(pixel / 4, pixel.x % 4 + 4 * (pixel.y % 4)), 0).r;
+}
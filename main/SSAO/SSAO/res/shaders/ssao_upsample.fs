@@ -0,0 +1,49 @@
+#version 330 core
+out float FragColor;
+
+uniform sampler2D gPosition;   // full resolution guide
+uniform sampler2D gNormal;
+uniform sampler2D lowPosition; // what the AO pass saw
+uniform sampler2D lowNormal;
+uniform sampler2D ssaoInput;   // blurred AO at low resolution
+uniform int divisor;
+
+// Joint bilateral upsample: the four low-resolution AO texels around the pixel are blended
+// with their bilinear weights, scaled down where the low-resolution surface differs from the
+// full-resolution one in depth or orientation, so AO does not bleed across silhouettes.
+void main()
+{
+    vec3 position = texelFetch(gPosition, ivec2(gl_FragCoord.xy), 0).xyz;
+    vec3 normal = normalize(texelFetch(gNormal, ivec2(gl_FragCoord.xy), 0).xyz);
+    ivec2 last = textureSize(ssaoInput, 0) - 1;
+    vec2 low = gl_FragCoord.xy / float(divisor) - 0.5;
+    ivec2 base = ivec2(floor(low));
+    vec2 f = low - vec2(base);
+    // depth tolerance grows with distance, like the depth buffer's precision
+    float depthScale = 1.0 / (0.05 * max(abs(position.z), 0.1));
+
+    float sum = 0.0, weightSum = 0.0;
+    float fallback = 1.0, fallbackDelta = 1e30;
+    for (int i = 0; i < 4; ++i)
+    {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 texel = clamp(base + offset, ivec2(0), last);
+        float ao = texelFetch(ssaoInput, texel, 0).r;
+        vec3 samplePosition = texelFetch(lowPosition, texel, 0).xyz;
+        vec3 sampleNormal = texelFetch(lowNormal, texel, 0).xyz;
+        float delta = abs(samplePosition.z - position.z);
+        vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+        float weight = bilinear.x * bilinear.y
+                     * 1.0 / (1.0 + delta * depthScale)
+                     * pow(max(dot(sampleNormal, normal), 0.0), 8.0);
+        sum += ao * weight;
+        weightSum += weight;
+        if (delta < fallbackDelta)
+        {
+            fallback = ao;
+            fallbackDelta = delta;
+        }
+    }
+    // no neighbour lies on this surface (thin features): take the closest in depth
+    FragColor = weightSum > 1e-4 ? sum / weightSum : fallback;
+}
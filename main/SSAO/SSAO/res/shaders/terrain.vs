@@ -0,0 +1,75 @@
+#version 330 core
+// patch grid position in [0, 1] across the chunk (x, z); y is 1 on the skirt ring
+layout (location = 0) in vec3 patchPosition;
+
+out VS_OUT {
+    vec3 FragPos;
+    vec3 Normal;
+    vec3 Albedo;
+} vs_out;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 albedo;
+uniform vec3 cameraPosition;
+
+uniform sampler2D heights; // R16 of the tile, linear filtering
+uniform vec2 tileOrigin;   // world xz of texel (0, 0)
+uniform float texelSize;   // world units between texels
+uniform int tileQuads;     // texels - 1 per side
+uniform float heightScale;
+uniform float baseHeight;
+
+uniform vec2 chunkOrigin;  // texel of the chunk corner
+uniform float gridQuads;   // quads per side at this LOD
+uniform float skirtDepth;
+uniform vec2 morphRange;   // distance where morphing to the next LOD starts and ends
+
+const float CHUNK_QUADS = 64.0;
+
+// Texel coordinate of a patch position, clamped so chunks past the tile edge collapse
+// onto it instead of overlapping the next tile.
+vec2 Texel(vec2 grid)
+{
+    return min(chunkOrigin + grid * CHUNK_QUADS, vec2(tileQuads));
+}
+
+float Height(vec2 texel)
+{
+    return baseHeight + heightScale * textureLod(heights, (texel + 0.5) / vec2(tileQuads + 1), 0.0).r;
+}
+
+vec3 WorldPosition(vec2 texel)
+{
+    return vec3(tileOrigin.x + texel.x * texelSize, Height(texel), tileOrigin.y + texel.y * texelSize);
+}
+
+// ssao_geometry.vs for terrain: the position comes from the height texture instead of a
+// vertex buffer, geomorphed towards the next coarser LOD near the end of this LOD's range
+void main()
+{
+    vec2 grid = patchPosition.xz;
+    float distanceToCamera = distance(cameraPosition, WorldPosition(Texel(grid)));
+    float morph = clamp((distanceToCamera - morphRange.x) / (morphRange.y - morphRange.x), 0.0, 1.0);
+    // odd vertices slide onto their even neighbour; at morph 1 every vertex sits on the
+    // next LOD's grid and the extra triangles have collapsed
+    vec2 odd = fract(grid * gridQuads * 0.5) * 2.0 / gridQuads;
+    grid -= odd * morph;
+
+    vec2 texel = Texel(grid);
+    vec3 worldPos = WorldPosition(texel);
+    worldPos.y -= patchPosition.y * skirtDepth;
+
+    // central differences one texel apart
+    float left = Height(texel - vec2(1.0, 0.0));
+    float right = Height(texel + vec2(1.0, 0.0));
+    float down = Height(texel - vec2(0.0, 1.0));
+    float up = Height(texel + vec2(0.0, 1.0));
+    vec3 normal = normalize(vec3(left - right, 2.0 * texelSize, down - up));
+
+    vec3 viewPos = vec3(view * vec4(worldPos, 1.0));
+    vs_out.FragPos = viewPos;
+    vs_out.Normal = mat3(view) * normal;
+    vs_out.Albedo = albedo;
+    gl_Position = projection * vec4(viewPos, 1.0);
+}